@@ -0,0 +1,228 @@
+// kernels.cpp
+// Native micro-benchmarks of the sampler kernels and end-to-end sampler
+// throughput, compiled against the package sources by run_bench.R
+// (Rcpp::sourceCpp with src/ on the include path). Times the code paths the
+// native loop runs, without the R interface in between:
+//
+//   composite_line / composite_dot   alpha-over of one primitive into its bbox
+//   sse_bbox[_float16 / _uint8]      SSE of one primitive-sized bbox against
+//                                    the target at each storage precision
+//   re_render_line / re_render_dot   clear a primitive's bbox and redraw the
+//                                    primitives the tile index reports there
+//   render_full_line / _dot          redraw the whole canvas from K primitives
+//   render_bands_line / _dot         the same, in row bands on every core
+//   residual_build                   full rebuild of the birth residual tree
+//   birth_line / birth_dot           one data-driven birth draw
+//   sampler_line / sampler_dot       RJSampler iterations from a blank canvas
+//
+// Each kernel is run in batches until a batch lasts min_time seconds; the
+// median of 5 such batches is reported as ns per operation.
+#include <Rcpp.h>
+#include <algorithm>
+#include <vector>
+#include "painter_engine.h"
+#include "line_policy.h"
+#include "dot_policy.h"
+using namespace Rcpp;
+
+namespace {
+
+volatile double bench_sink = 0.0;  // keeps results observable
+
+struct BenchRows {
+  std::vector<std::string> kernel;
+  std::vector<int> size, count;
+  std::vector<double> ns, ops, area;
+
+  void add(const std::string& k, int s, int n, double ns_op, double a) {
+    kernel.push_back(k);
+    size.push_back(s);
+    count.push_back(n);
+    ns.push_back(ns_op);
+    ops.push_back(ns_op > 0.0 ? 1e9 / ns_op : NA_REAL);
+    area.push_back(a);
+  }
+};
+
+// Median ns per call of f(i), i counting up across calls
+template <class F>
+double time_ns(F f, double min_time) {
+  long long n = 1, i = 0;
+  for (;;) {  // calibrate the batch size
+    const long long t0 = stat_now_ns();
+    for (long long k = 0; k < n; k++) f(i++);
+    const double dt = (stat_now_ns() - t0) * 1e-9;
+    if (dt >= min_time || n >= (1LL << 30)) break;
+    n = dt > 0.0 ? std::max(2 * n, (long long)(n * 1.2 * min_time / dt)) : 10 * n;
+  }
+  std::vector<double> rep(5);
+  for (size_t r = 0; r < rep.size(); r++) {
+    const long long t0 = stat_now_ns();
+    for (long long k = 0; k < n; k++) f(i++);
+    rep[r] = (double)(stat_now_ns() - t0) / n;
+  }
+  std::sort(rep.begin(), rep.end());
+  return rep[rep.size() / 2];
+}
+
+// Smooth colour ramps with some texture, so births and SSE see a residual;
+// planar [S, S, 3]
+std::vector<double> bench_target(int S) {
+  std::vector<double> t((size_t)S * S * 3);
+  for (int y = 1; y <= S; y++)
+    for (int x = 1; x <= S; x++) {
+      t[idx3(y, x, 0, S, S)] = (double)x / S;
+      t[idx3(y, x, 1, S, S)] = (double)y / S;
+      t[idx3(y, x, 2, S, S)] = 0.5 + 0.5 * std::sin(0.05 * x) * std::cos(0.07 * y);
+    }
+  return t;
+}
+
+template <class P>
+std::vector<typename P::Params> bench_prims(int n, int S, NativeRng& rng) {
+  std::vector<typename P::Params> out(n);
+  for (int i = 0; i < n; i++) out[i] = P::sample_prior(S, S, rng);
+  return out;
+}
+
+template <class P>
+double mean_area(const std::vector<typename P::Params>& prims, int S) {
+  double a = 0.0;
+  for (size_t i = 0; i < prims.size(); i++) {
+    const BBox b = P::footprint(prims[i], S, S);
+    if (!bbox_empty(b)) a += (double)(b.xmax - b.xmin + 1) * (b.ymax - b.ymin + 1);
+  }
+  return prims.empty() ? 0.0 : a / prims.size();
+}
+
+// Kernels that only depend on the image size
+template <class P>
+void bench_size(BenchRows& rows, const std::string& name, const std::vector<double>& planar,
+                int S, double min_time, NativeRng& rng) {
+  const TargetImage target(planar.data(), S, S);
+  const std::vector<typename P::Params> prims = bench_prims<P>(1024, S, rng);
+  std::vector<BBox> boxes(prims.size());
+  for (size_t i = 0; i < prims.size(); i++) boxes[i] = P::footprint(prims[i], S, S);
+  const double area = mean_area<P>(prims, S);
+  const size_t n = prims.size();
+
+  Canvas canvas(S, S);
+  rows.add("composite_" + name, S, NA_INTEGER, time_ns([&](long long i) {
+    const BBox& b = boxes[i % n];
+    if (!bbox_empty(b)) composite<P>(canvas, prims[i % n], b);
+  }, min_time), area);
+  if (name == "line") {  // policy independent; per target precision
+    for (int prec = STORE_FLOAT32; prec <= STORE_UINT8; prec++) {
+      const TargetImage t(planar.data(), S, S, prec);
+      rows.add(prec == STORE_FLOAT32 ? "sse_bbox" : std::string("sse_bbox_") + precision_name(prec),
+               S, NA_INTEGER, time_ns([&](long long i) {
+        const BBox& b = boxes[i % n];
+        if (!bbox_empty(b)) bench_sink = bench_sink + sse_bbox(t, canvas, b);
+      }, min_time), area);
+    }
+  }
+
+  ResidualTree residual;
+  Canvas blank(S, S);
+  residual.build(target, blank);
+  if (name == "line") {
+    rows.add("residual_build", S, NA_INTEGER, time_ns([&](long long) {
+      residual.build(target, blank);
+    }, min_time), NA_REAL);
+  }
+  rows.add("birth_" + name, S, NA_INTEGER, time_ns([&](long long) {
+    const typename P::Params p = P::sample_birth(target, residual, rng);
+    bench_sink = bench_sink + p.alpha;
+  }, min_time), NA_REAL);
+}
+
+// Kernels that depend on the number of primitives on the canvas
+template <class P>
+void bench_count(BenchRows& rows, const std::string& name, int S, int K,
+                 double min_time, NativeRng& rng) {
+  const std::vector<typename P::Params> prims = bench_prims<P>(K, S, rng);
+  const double area = mean_area<P>(prims, S);
+  TileIndex index(S, S);
+  for (int i = 0; i < K; i++) index.insert(i, P::footprint(prims[i], S, S));
+  Canvas canvas(S, S);
+  render_full<P>(canvas, prims);
+
+  std::vector<int> hits;
+  rows.add("re_render_" + name, S, K, time_ns([&](long long i) {
+    const BBox b = P::footprint(prims[i % K], S, S);
+    if (bbox_empty(b)) return;
+    canvas.fill(b, 1.0f);
+    index.query(b, hits);
+    std::sort(hits.begin(), hits.end());  // ids are in paint order here
+    for (size_t k = 0; k < hits.size(); k++) composite_clipped<P>(canvas, prims[hits[k]], b);
+  }, min_time), area);
+  rows.add("render_full_" + name, S, K, time_ns([&](long long) {
+    render_full<P>(canvas, prims);
+  }, min_time), area);
+  rows.add("render_bands_" + name, S, K, time_ns([&](long long) {
+    render_full<P>(canvas, prims, 0);
+  }, min_time), area);
+}
+
+// it/s of a sampler run of iters from a blank canvas; reported per iteration
+template <class P>
+void bench_sampler(BenchRows& rows, const std::string& name, const std::vector<double>& planar,
+                   int S, int iters, SamplerConfig cfg) {
+  cfg.iters = iters;
+  RJSampler<P> sampler(planar.data(), S, S, cfg, NativeRng(1));
+  sampler.run([](const Canvas&, int, int, double, double) {});
+  rows.add("sampler_" + name, S, sampler.K(), sampler.run_seconds() * 1e9 / iters,
+           sampler.stats().area_n > 0 ? sampler.stats().area / sampler.stats().area_n : NA_REAL);
+}
+
+}  // namespace
+
+// sizes: square image sizes in px; counts: primitive counts for the
+// K-dependent kernels; iters: sampler iterations per size (0 skips the
+// end-to-end rows). Returns one row per kernel and size (and count):
+// ns_per_op, ops_per_sec and the mean primitive bbox area in px. For the
+// sampler rows count is the final K and an op is one iteration.
+// [[Rcpp::export]]
+DataFrame bench_kernels_cpp(IntegerVector sizes, IntegerVector counts,
+                            double min_time = 0.2, int iters = 20000, int seed = 42) {
+  BenchRows rows;
+  NativeRng rng(seed);
+  SamplerConfig line_cfg{};
+  line_cfg.beta_init = 0.1;
+  line_cfg.beta_final = 2.0;
+  const double line_moves[4] = { 0.25, 0.25, 0.45, 0.05 };
+  std::copy(line_moves, line_moves + 4, line_cfg.prob_moves);
+  line_cfg.K_lambda = 120;
+  line_cfg.datadriven_birth = true;
+  line_cfg.jitter_tries = 1;
+  line_cfg.sse_check_every = 10000;
+  line_cfg.tile_moves = 50;
+  line_cfg.n_threads = 1;
+  line_cfg.jitter = LinePolicy::default_jitter();
+  SamplerConfig dot_cfg = line_cfg;
+  dot_cfg.beta_init = 0.01;
+  dot_cfg.beta_final = 1.0;
+  const double dot_moves[4] = { 0.6, 0.1, 0.3, 0.0 };
+  std::copy(dot_moves, dot_moves + 4, dot_cfg.prob_moves);
+  dot_cfg.K_lambda = 0;
+  dot_cfg.jitter = DotPolicy::default_jitter();
+  for (int s = 0; s < sizes.length(); s++) {
+    const int S = sizes[s];
+    const std::vector<double> target = bench_target(S);
+    bench_size<LinePolicy>(rows, "line", target, S, min_time, rng);
+    bench_size<DotPolicy>(rows, "dot", target, S, min_time, rng);
+    for (int k = 0; k < counts.length(); k++) {
+      bench_count<LinePolicy>(rows, "line", S, counts[k], min_time, rng);
+      bench_count<DotPolicy>(rows, "dot", S, counts[k], min_time, rng);
+    }
+    if (iters > 0) {
+      bench_sampler<LinePolicy>(rows, "line", target, S, iters, line_cfg);
+      bench_sampler<DotPolicy>(rows, "dot", target, S, iters, dot_cfg);
+    }
+    Rcpp::checkUserInterrupt();
+  }
+  return DataFrame::create(
+    Named("kernel") = rows.kernel, Named("size") = rows.size, Named("count") = rows.count,
+    Named("ns_per_op") = rows.ns, Named("ops_per_sec") = rows.ops,
+    Named("mean_bbox_area") = rows.area, Named("stringsAsFactors") = false);
+}
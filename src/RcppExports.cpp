@@ -0,0 +1,709 @@
+// Generated by using Rcpp::compileAttributes() -> do not edit by hand
+// Generator token: 10BE3573-1514-4C36-9D1C-5A225CD40393
+
+#include <Rcpp.h>
+
+using namespace Rcpp;
+
+#ifdef RCPP_USE_GLOBAL_ROSTREAM
+Rcpp::Rostream<true>&  Rcpp::Rcout = Rcpp::Rcpp_cout_get();
+Rcpp::Rostream<false>& Rcpp::Rcerr = Rcpp::Rcpp_cerr_get();
+#endif
+
+// composite_dot_bbox_cpp
+NumericVector composite_dot_bbox_cpp(NumericVector canvas, int H, int W, double x, double y, double radius, double alpha, NumericVector col, int xmin, int xmax, int ymin, int ymax);
+RcppExport SEXP _mcmcPainter_composite_dot_bbox_cpp(SEXP canvasSEXP, SEXP HSEXP, SEXP WSEXP, SEXP xSEXP, SEXP ySEXP, SEXP radiusSEXP, SEXP alphaSEXP, SEXP colSEXP, SEXP xminSEXP, SEXP xmaxSEXP, SEXP yminSEXP, SEXP ymaxSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< NumericVector >::type canvas(canvasSEXP);
+    Rcpp::traits::input_parameter< int >::type H(HSEXP);
+    Rcpp::traits::input_parameter< int >::type W(WSEXP);
+    Rcpp::traits::input_parameter< double >::type x(xSEXP);
+    Rcpp::traits::input_parameter< double >::type y(ySEXP);
+    Rcpp::traits::input_parameter< double >::type radius(radiusSEXP);
+    Rcpp::traits::input_parameter< double >::type alpha(alphaSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type col(colSEXP);
+    Rcpp::traits::input_parameter< int >::type xmin(xminSEXP);
+    Rcpp::traits::input_parameter< int >::type xmax(xmaxSEXP);
+    Rcpp::traits::input_parameter< int >::type ymin(yminSEXP);
+    Rcpp::traits::input_parameter< int >::type ymax(ymaxSEXP);
+    rcpp_result_gen = Rcpp::wrap(composite_dot_bbox_cpp(canvas, H, W, x, y, radius, alpha, col, xmin, xmax, ymin, ymax));
+    return rcpp_result_gen;
+END_RCPP
+}
+// sse_bbox_dots_cpp
+double sse_bbox_dots_cpp(NumericVector target, NumericVector canvas, int H, int W, int xmin, int xmax, int ymin, int ymax);
+RcppExport SEXP _mcmcPainter_sse_bbox_dots_cpp(SEXP targetSEXP, SEXP canvasSEXP, SEXP HSEXP, SEXP WSEXP, SEXP xminSEXP, SEXP xmaxSEXP, SEXP yminSEXP, SEXP ymaxSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< NumericVector >::type target(targetSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type canvas(canvasSEXP);
+    Rcpp::traits::input_parameter< int >::type H(HSEXP);
+    Rcpp::traits::input_parameter< int >::type W(WSEXP);
+    Rcpp::traits::input_parameter< int >::type xmin(xminSEXP);
+    Rcpp::traits::input_parameter< int >::type xmax(xmaxSEXP);
+    Rcpp::traits::input_parameter< int >::type ymin(yminSEXP);
+    Rcpp::traits::input_parameter< int >::type ymax(ymaxSEXP);
+    rcpp_result_gen = Rcpp::wrap(sse_bbox_dots_cpp(target, canvas, H, W, xmin, xmax, ymin, ymax));
+    return rcpp_result_gen;
+END_RCPP
+}
+// dot_bbox_cpp
+List dot_bbox_cpp(double x, double y, double radius, int W, int H);
+RcppExport SEXP _mcmcPainter_dot_bbox_cpp(SEXP xSEXP, SEXP ySEXP, SEXP radiusSEXP, SEXP WSEXP, SEXP HSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< double >::type x(xSEXP);
+    Rcpp::traits::input_parameter< double >::type y(ySEXP);
+    Rcpp::traits::input_parameter< double >::type radius(radiusSEXP);
+    Rcpp::traits::input_parameter< int >::type W(WSEXP);
+    Rcpp::traits::input_parameter< int >::type H(HSEXP);
+    rcpp_result_gen = Rcpp::wrap(dot_bbox_cpp(x, y, radius, W, H));
+    return rcpp_result_gen;
+END_RCPP
+}
+// sample_dot_prior_cpp
+List sample_dot_prior_cpp(int W, int H);
+RcppExport SEXP _mcmcPainter_sample_dot_prior_cpp(SEXP WSEXP, SEXP HSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< int >::type W(WSEXP);
+    Rcpp::traits::input_parameter< int >::type H(HSEXP);
+    rcpp_result_gen = Rcpp::wrap(sample_dot_prior_cpp(W, H));
+    return rcpp_result_gen;
+END_RCPP
+}
+// jitter_dot_cpp
+List jitter_dot_cpp(List dot, int W, int H, double s_xy, double s_r, double s_a, double s_c);
+RcppExport SEXP _mcmcPainter_jitter_dot_cpp(SEXP dotSEXP, SEXP WSEXP, SEXP HSEXP, SEXP s_xySEXP, SEXP s_rSEXP, SEXP s_aSEXP, SEXP s_cSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< List >::type dot(dotSEXP);
+    Rcpp::traits::input_parameter< int >::type W(WSEXP);
+    Rcpp::traits::input_parameter< int >::type H(HSEXP);
+    Rcpp::traits::input_parameter< double >::type s_xy(s_xySEXP);
+    Rcpp::traits::input_parameter< double >::type s_r(s_rSEXP);
+    Rcpp::traits::input_parameter< double >::type s_a(s_aSEXP);
+    Rcpp::traits::input_parameter< double >::type s_c(s_cSEXP);
+    rcpp_result_gen = Rcpp::wrap(jitter_dot_cpp(dot, W, H, s_xy, s_r, s_a, s_c));
+    return rcpp_result_gen;
+END_RCPP
+}
+// sample_dot_birth_datadriven_cpp
+List sample_dot_birth_datadriven_cpp(NumericVector target, NumericVector canvas, int H, int W);
+RcppExport SEXP _mcmcPainter_sample_dot_birth_datadriven_cpp(SEXP targetSEXP, SEXP canvasSEXP, SEXP HSEXP, SEXP WSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< NumericVector >::type target(targetSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type canvas(canvasSEXP);
+    Rcpp::traits::input_parameter< int >::type H(HSEXP);
+    Rcpp::traits::input_parameter< int >::type W(WSEXP);
+    rcpp_result_gen = Rcpp::wrap(sample_dot_birth_datadriven_cpp(target, canvas, H, W));
+    return rcpp_result_gen;
+END_RCPP
+}
+// re_render_bbox_from_dots_cpp
+NumericVector re_render_bbox_from_dots_cpp(NumericVector canvas, List dots, int H, int W, int xmin, int xmax, int ymin, int ymax);
+RcppExport SEXP _mcmcPainter_re_render_bbox_from_dots_cpp(SEXP canvasSEXP, SEXP dotsSEXP, SEXP HSEXP, SEXP WSEXP, SEXP xminSEXP, SEXP xmaxSEXP, SEXP yminSEXP, SEXP ymaxSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< NumericVector >::type canvas(canvasSEXP);
+    Rcpp::traits::input_parameter< List >::type dots(dotsSEXP);
+    Rcpp::traits::input_parameter< int >::type H(HSEXP);
+    Rcpp::traits::input_parameter< int >::type W(WSEXP);
+    Rcpp::traits::input_parameter< int >::type xmin(xminSEXP);
+    Rcpp::traits::input_parameter< int >::type xmax(xmaxSEXP);
+    Rcpp::traits::input_parameter< int >::type ymin(yminSEXP);
+    Rcpp::traits::input_parameter< int >::type ymax(ymaxSEXP);
+    rcpp_result_gen = Rcpp::wrap(re_render_bbox_from_dots_cpp(canvas, dots, H, W, xmin, xmax, ymin, ymax));
+    return rcpp_result_gen;
+END_RCPP
+}
+// render_full_canvas_from_dots_cpp
+NumericVector render_full_canvas_from_dots_cpp(NumericVector canvas, List dots, int H, int W, int n_threads);
+RcppExport SEXP _mcmcPainter_render_full_canvas_from_dots_cpp(SEXP canvasSEXP, SEXP dotsSEXP, SEXP HSEXP, SEXP WSEXP, SEXP n_threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< NumericVector >::type canvas(canvasSEXP);
+    Rcpp::traits::input_parameter< List >::type dots(dotsSEXP);
+    Rcpp::traits::input_parameter< int >::type H(HSEXP);
+    Rcpp::traits::input_parameter< int >::type W(WSEXP);
+    Rcpp::traits::input_parameter< int >::type n_threads(n_threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(render_full_canvas_from_dots_cpp(canvas, dots, H, W, n_threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// rjmcmc_dot_paint_cpp
+List rjmcmc_dot_paint_cpp(NumericVector target, int H, int W, int iters, double beta_init, double beta_final, double birth_prob, int save_every, Function on_snapshot, bool verbose, int n_chains, double beta_ratio, int swap_every, int n_threads, int tile_size, int tile_moves, int jitter_tries, int seed, Nullable<List> init, std::string snapshot_dir, int snapshot_queue, std::string trace_file, std::string checkpoint_file, int checkpoint_every, bool resume, int stats_every, std::string stats_file, std::string precision, double mala_step, int adapt_iters, double adapt_target, std::string loss, double loss_floor, int loss_levels);
+RcppExport SEXP _mcmcPainter_rjmcmc_dot_paint_cpp(SEXP targetSEXP, SEXP HSEXP, SEXP WSEXP, SEXP itersSEXP, SEXP beta_initSEXP, SEXP beta_finalSEXP, SEXP birth_probSEXP, SEXP save_everySEXP, SEXP on_snapshotSEXP, SEXP verboseSEXP, SEXP n_chainsSEXP, SEXP beta_ratioSEXP, SEXP swap_everySEXP, SEXP n_threadsSEXP, SEXP tile_sizeSEXP, SEXP tile_movesSEXP, SEXP jitter_triesSEXP, SEXP seedSEXP, SEXP initSEXP, SEXP snapshot_dirSEXP, SEXP snapshot_queueSEXP, SEXP trace_fileSEXP, SEXP checkpoint_fileSEXP, SEXP checkpoint_everySEXP, SEXP resumeSEXP, SEXP stats_everySEXP, SEXP stats_fileSEXP, SEXP precisionSEXP, SEXP mala_stepSEXP, SEXP adapt_itersSEXP, SEXP adapt_targetSEXP, SEXP lossSEXP, SEXP loss_floorSEXP, SEXP loss_levelsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< NumericVector >::type target(targetSEXP);
+    Rcpp::traits::input_parameter< int >::type H(HSEXP);
+    Rcpp::traits::input_parameter< int >::type W(WSEXP);
+    Rcpp::traits::input_parameter< int >::type iters(itersSEXP);
+    Rcpp::traits::input_parameter< double >::type beta_init(beta_initSEXP);
+    Rcpp::traits::input_parameter< double >::type beta_final(beta_finalSEXP);
+    Rcpp::traits::input_parameter< double >::type birth_prob(birth_probSEXP);
+    Rcpp::traits::input_parameter< int >::type save_every(save_everySEXP);
+    Rcpp::traits::input_parameter< Function >::type on_snapshot(on_snapshotSEXP);
+    Rcpp::traits::input_parameter< bool >::type verbose(verboseSEXP);
+    Rcpp::traits::input_parameter< int >::type n_chains(n_chainsSEXP);
+    Rcpp::traits::input_parameter< double >::type beta_ratio(beta_ratioSEXP);
+    Rcpp::traits::input_parameter< int >::type swap_every(swap_everySEXP);
+    Rcpp::traits::input_parameter< int >::type n_threads(n_threadsSEXP);
+    Rcpp::traits::input_parameter< int >::type tile_size(tile_sizeSEXP);
+    Rcpp::traits::input_parameter< int >::type tile_moves(tile_movesSEXP);
+    Rcpp::traits::input_parameter< int >::type jitter_tries(jitter_triesSEXP);
+    Rcpp::traits::input_parameter< int >::type seed(seedSEXP);
+    Rcpp::traits::input_parameter< Nullable<List> >::type init(initSEXP);
+    Rcpp::traits::input_parameter< std::string >::type snapshot_dir(snapshot_dirSEXP);
+    Rcpp::traits::input_parameter< int >::type snapshot_queue(snapshot_queueSEXP);
+    Rcpp::traits::input_parameter< std::string >::type trace_file(trace_fileSEXP);
+    Rcpp::traits::input_parameter< std::string >::type checkpoint_file(checkpoint_fileSEXP);
+    Rcpp::traits::input_parameter< int >::type checkpoint_every(checkpoint_everySEXP);
+    Rcpp::traits::input_parameter< bool >::type resume(resumeSEXP);
+    Rcpp::traits::input_parameter< int >::type stats_every(stats_everySEXP);
+    Rcpp::traits::input_parameter< std::string >::type stats_file(stats_fileSEXP);
+    Rcpp::traits::input_parameter< std::string >::type precision(precisionSEXP);
+    Rcpp::traits::input_parameter< double >::type mala_step(mala_stepSEXP);
+    Rcpp::traits::input_parameter< int >::type adapt_iters(adapt_itersSEXP);
+    Rcpp::traits::input_parameter< double >::type adapt_target(adapt_targetSEXP);
+    Rcpp::traits::input_parameter< std::string >::type loss(lossSEXP);
+    Rcpp::traits::input_parameter< double >::type loss_floor(loss_floorSEXP);
+    Rcpp::traits::input_parameter< int >::type loss_levels(loss_levelsSEXP);
+    rcpp_result_gen = Rcpp::wrap(rjmcmc_dot_paint_cpp(target, H, W, iters, beta_init, beta_final, birth_prob, save_every, on_snapshot, verbose, n_chains, beta_ratio, swap_every, n_threads, tile_size, tile_moves, jitter_tries, seed, init, snapshot_dir, snapshot_queue, trace_file, checkpoint_file, checkpoint_every, resume, stats_every, stats_file, precision, mala_step, adapt_iters, adapt_target, loss, loss_floor, loss_levels));
+    return rcpp_result_gen;
+END_RCPP
+}
+// dot_store_cpp
+SEXP dot_store_cpp(List dots);
+RcppExport SEXP _mcmcPainter_dot_store_cpp(SEXP dotsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< List >::type dots(dotsSEXP);
+    rcpp_result_gen = Rcpp::wrap(dot_store_cpp(dots));
+    return rcpp_result_gen;
+END_RCPP
+}
+// dot_store_to_list_cpp
+List dot_store_to_list_cpp(SEXP store);
+RcppExport SEXP _mcmcPainter_dot_store_to_list_cpp(SEXP storeSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type store(storeSEXP);
+    rcpp_result_gen = Rcpp::wrap(dot_store_to_list_cpp(store));
+    return rcpp_result_gen;
+END_RCPP
+}
+// dot_store_size_cpp
+int dot_store_size_cpp(SEXP store);
+RcppExport SEXP _mcmcPainter_dot_store_size_cpp(SEXP storeSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type store(storeSEXP);
+    rcpp_result_gen = Rcpp::wrap(dot_store_size_cpp(store));
+    return rcpp_result_gen;
+END_RCPP
+}
+// dot_store_push_cpp
+int dot_store_push_cpp(SEXP store, List dot);
+RcppExport SEXP _mcmcPainter_dot_store_push_cpp(SEXP storeSEXP, SEXP dotSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type store(storeSEXP);
+    Rcpp::traits::input_parameter< List >::type dot(dotSEXP);
+    rcpp_result_gen = Rcpp::wrap(dot_store_push_cpp(store, dot));
+    return rcpp_result_gen;
+END_RCPP
+}
+// dot_store_set_cpp
+void dot_store_set_cpp(SEXP store, int i, List dot);
+RcppExport SEXP _mcmcPainter_dot_store_set_cpp(SEXP storeSEXP, SEXP iSEXP, SEXP dotSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type store(storeSEXP);
+    Rcpp::traits::input_parameter< int >::type i(iSEXP);
+    Rcpp::traits::input_parameter< List >::type dot(dotSEXP);
+    dot_store_set_cpp(store, i, dot);
+    return R_NilValue;
+END_RCPP
+}
+// dot_store_remove_cpp
+void dot_store_remove_cpp(SEXP store, int i);
+RcppExport SEXP _mcmcPainter_dot_store_remove_cpp(SEXP storeSEXP, SEXP iSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type store(storeSEXP);
+    Rcpp::traits::input_parameter< int >::type i(iSEXP);
+    dot_store_remove_cpp(store, i);
+    return R_NilValue;
+END_RCPP
+}
+// render_dot_store_cpp
+NumericVector render_dot_store_cpp(SEXP store, int H, int W, int n_threads);
+RcppExport SEXP _mcmcPainter_render_dot_store_cpp(SEXP storeSEXP, SEXP HSEXP, SEXP WSEXP, SEXP n_threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type store(storeSEXP);
+    Rcpp::traits::input_parameter< int >::type H(HSEXP);
+    Rcpp::traits::input_parameter< int >::type W(WSEXP);
+    Rcpp::traits::input_parameter< int >::type n_threads(n_threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(render_dot_store_cpp(store, H, W, n_threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// replay_dot_trace_cpp
+int replay_dot_trace_cpp(std::string path, IntegerVector iters, int H, int W, Function on_frame, int n_threads);
+RcppExport SEXP _mcmcPainter_replay_dot_trace_cpp(SEXP pathSEXP, SEXP itersSEXP, SEXP HSEXP, SEXP WSEXP, SEXP on_frameSEXP, SEXP n_threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::string >::type path(pathSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type iters(itersSEXP);
+    Rcpp::traits::input_parameter< int >::type H(HSEXP);
+    Rcpp::traits::input_parameter< int >::type W(WSEXP);
+    Rcpp::traits::input_parameter< Function >::type on_frame(on_frameSEXP);
+    Rcpp::traits::input_parameter< int >::type n_threads(n_threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(replay_dot_trace_cpp(path, iters, H, W, on_frame, n_threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// render_dots_png_cpp
+List render_dots_png_cpp(List dots, int H, int W, int out_h, int out_w, std::string path, int n_threads, int strip_rows);
+RcppExport SEXP _mcmcPainter_render_dots_png_cpp(SEXP dotsSEXP, SEXP HSEXP, SEXP WSEXP, SEXP out_hSEXP, SEXP out_wSEXP, SEXP pathSEXP, SEXP n_threadsSEXP, SEXP strip_rowsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< List >::type dots(dotsSEXP);
+    Rcpp::traits::input_parameter< int >::type H(HSEXP);
+    Rcpp::traits::input_parameter< int >::type W(WSEXP);
+    Rcpp::traits::input_parameter< int >::type out_h(out_hSEXP);
+    Rcpp::traits::input_parameter< int >::type out_w(out_wSEXP);
+    Rcpp::traits::input_parameter< std::string >::type path(pathSEXP);
+    Rcpp::traits::input_parameter< int >::type n_threads(n_threadsSEXP);
+    Rcpp::traits::input_parameter< int >::type strip_rows(strip_rowsSEXP);
+    rcpp_result_gen = Rcpp::wrap(render_dots_png_cpp(dots, H, W, out_h, out_w, path, n_threads, strip_rows));
+    return rcpp_result_gen;
+END_RCPP
+}
+// composite_line_bbox_cpp
+NumericVector composite_line_bbox_cpp(NumericVector canvas, int H, int W, double x1, double y1, double x2, double y2, double w, double alpha, NumericVector col, int xmin, int xmax, int ymin, int ymax);
+RcppExport SEXP _mcmcPainter_composite_line_bbox_cpp(SEXP canvasSEXP, SEXP HSEXP, SEXP WSEXP, SEXP x1SEXP, SEXP y1SEXP, SEXP x2SEXP, SEXP y2SEXP, SEXP wSEXP, SEXP alphaSEXP, SEXP colSEXP, SEXP xminSEXP, SEXP xmaxSEXP, SEXP yminSEXP, SEXP ymaxSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< NumericVector >::type canvas(canvasSEXP);
+    Rcpp::traits::input_parameter< int >::type H(HSEXP);
+    Rcpp::traits::input_parameter< int >::type W(WSEXP);
+    Rcpp::traits::input_parameter< double >::type x1(x1SEXP);
+    Rcpp::traits::input_parameter< double >::type y1(y1SEXP);
+    Rcpp::traits::input_parameter< double >::type x2(x2SEXP);
+    Rcpp::traits::input_parameter< double >::type y2(y2SEXP);
+    Rcpp::traits::input_parameter< double >::type w(wSEXP);
+    Rcpp::traits::input_parameter< double >::type alpha(alphaSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type col(colSEXP);
+    Rcpp::traits::input_parameter< int >::type xmin(xminSEXP);
+    Rcpp::traits::input_parameter< int >::type xmax(xmaxSEXP);
+    Rcpp::traits::input_parameter< int >::type ymin(yminSEXP);
+    Rcpp::traits::input_parameter< int >::type ymax(ymaxSEXP);
+    rcpp_result_gen = Rcpp::wrap(composite_line_bbox_cpp(canvas, H, W, x1, y1, x2, y2, w, alpha, col, xmin, xmax, ymin, ymax));
+    return rcpp_result_gen;
+END_RCPP
+}
+// sse_bbox_cpp
+double sse_bbox_cpp(NumericVector target, NumericVector canvas, int H, int W, int xmin, int xmax, int ymin, int ymax);
+RcppExport SEXP _mcmcPainter_sse_bbox_cpp(SEXP targetSEXP, SEXP canvasSEXP, SEXP HSEXP, SEXP WSEXP, SEXP xminSEXP, SEXP xmaxSEXP, SEXP yminSEXP, SEXP ymaxSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< NumericVector >::type target(targetSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type canvas(canvasSEXP);
+    Rcpp::traits::input_parameter< int >::type H(HSEXP);
+    Rcpp::traits::input_parameter< int >::type W(WSEXP);
+    Rcpp::traits::input_parameter< int >::type xmin(xminSEXP);
+    Rcpp::traits::input_parameter< int >::type xmax(xmaxSEXP);
+    Rcpp::traits::input_parameter< int >::type ymin(yminSEXP);
+    Rcpp::traits::input_parameter< int >::type ymax(ymaxSEXP);
+    rcpp_result_gen = Rcpp::wrap(sse_bbox_cpp(target, canvas, H, W, xmin, xmax, ymin, ymax));
+    return rcpp_result_gen;
+END_RCPP
+}
+// line_bbox_cpp
+List line_bbox_cpp(double x1, double y1, double x2, double y2, double w, int W, int H, int pad);
+RcppExport SEXP _mcmcPainter_line_bbox_cpp(SEXP x1SEXP, SEXP y1SEXP, SEXP x2SEXP, SEXP y2SEXP, SEXP wSEXP, SEXP WSEXP, SEXP HSEXP, SEXP padSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< double >::type x1(x1SEXP);
+    Rcpp::traits::input_parameter< double >::type y1(y1SEXP);
+    Rcpp::traits::input_parameter< double >::type x2(x2SEXP);
+    Rcpp::traits::input_parameter< double >::type y2(y2SEXP);
+    Rcpp::traits::input_parameter< double >::type w(wSEXP);
+    Rcpp::traits::input_parameter< int >::type W(WSEXP);
+    Rcpp::traits::input_parameter< int >::type H(HSEXP);
+    Rcpp::traits::input_parameter< int >::type pad(padSEXP);
+    rcpp_result_gen = Rcpp::wrap(line_bbox_cpp(x1, y1, x2, y2, w, W, H, pad));
+    return rcpp_result_gen;
+END_RCPP
+}
+// sample_line_prior_cpp
+List sample_line_prior_cpp(int W, int H);
+RcppExport SEXP _mcmcPainter_sample_line_prior_cpp(SEXP WSEXP, SEXP HSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< int >::type W(WSEXP);
+    Rcpp::traits::input_parameter< int >::type H(HSEXP);
+    rcpp_result_gen = Rcpp::wrap(sample_line_prior_cpp(W, H));
+    return rcpp_result_gen;
+END_RCPP
+}
+// jitter_line_cpp
+List jitter_line_cpp(List line, int W, int H, double s_xy, double s_w, double s_a, double s_c);
+RcppExport SEXP _mcmcPainter_jitter_line_cpp(SEXP lineSEXP, SEXP WSEXP, SEXP HSEXP, SEXP s_xySEXP, SEXP s_wSEXP, SEXP s_aSEXP, SEXP s_cSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< List >::type line(lineSEXP);
+    Rcpp::traits::input_parameter< int >::type W(WSEXP);
+    Rcpp::traits::input_parameter< int >::type H(HSEXP);
+    Rcpp::traits::input_parameter< double >::type s_xy(s_xySEXP);
+    Rcpp::traits::input_parameter< double >::type s_w(s_wSEXP);
+    Rcpp::traits::input_parameter< double >::type s_a(s_aSEXP);
+    Rcpp::traits::input_parameter< double >::type s_c(s_cSEXP);
+    rcpp_result_gen = Rcpp::wrap(jitter_line_cpp(line, W, H, s_xy, s_w, s_a, s_c));
+    return rcpp_result_gen;
+END_RCPP
+}
+// sample_line_birth_datadriven_cpp
+List sample_line_birth_datadriven_cpp(NumericVector target, NumericVector canvas, int H, int W);
+RcppExport SEXP _mcmcPainter_sample_line_birth_datadriven_cpp(SEXP targetSEXP, SEXP canvasSEXP, SEXP HSEXP, SEXP WSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< NumericVector >::type target(targetSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type canvas(canvasSEXP);
+    Rcpp::traits::input_parameter< int >::type H(HSEXP);
+    Rcpp::traits::input_parameter< int >::type W(WSEXP);
+    rcpp_result_gen = Rcpp::wrap(sample_line_birth_datadriven_cpp(target, canvas, H, W));
+    return rcpp_result_gen;
+END_RCPP
+}
+// re_render_bbox_from_lines_cpp
+NumericVector re_render_bbox_from_lines_cpp(NumericVector base_canvas, List lines, int xmin, int xmax, int ymin, int ymax, int H, int W);
+RcppExport SEXP _mcmcPainter_re_render_bbox_from_lines_cpp(SEXP base_canvasSEXP, SEXP linesSEXP, SEXP xminSEXP, SEXP xmaxSEXP, SEXP yminSEXP, SEXP ymaxSEXP, SEXP HSEXP, SEXP WSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< NumericVector >::type base_canvas(base_canvasSEXP);
+    Rcpp::traits::input_parameter< List >::type lines(linesSEXP);
+    Rcpp::traits::input_parameter< int >::type xmin(xminSEXP);
+    Rcpp::traits::input_parameter< int >::type xmax(xmaxSEXP);
+    Rcpp::traits::input_parameter< int >::type ymin(yminSEXP);
+    Rcpp::traits::input_parameter< int >::type ymax(ymaxSEXP);
+    Rcpp::traits::input_parameter< int >::type H(HSEXP);
+    Rcpp::traits::input_parameter< int >::type W(WSEXP);
+    rcpp_result_gen = Rcpp::wrap(re_render_bbox_from_lines_cpp(base_canvas, lines, xmin, xmax, ymin, ymax, H, W));
+    return rcpp_result_gen;
+END_RCPP
+}
+// render_full_canvas_cpp
+NumericVector render_full_canvas_cpp(List lines, int H, int W, int n_threads);
+RcppExport SEXP _mcmcPainter_render_full_canvas_cpp(SEXP linesSEXP, SEXP HSEXP, SEXP WSEXP, SEXP n_threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< List >::type lines(linesSEXP);
+    Rcpp::traits::input_parameter< int >::type H(HSEXP);
+    Rcpp::traits::input_parameter< int >::type W(WSEXP);
+    Rcpp::traits::input_parameter< int >::type n_threads(n_threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(render_full_canvas_cpp(lines, H, W, n_threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// rjmcmc_line_paint_cpp
+List rjmcmc_line_paint_cpp(NumericVector target, int H, int W, int iters, double beta_init, double beta_final, NumericVector prob_moves, double K_lambda, int save_every, Function on_snapshot, bool verbose, int n_chains, double beta_ratio, int swap_every, int n_threads, int tile_size, int tile_moves, int jitter_tries, int seed, Nullable<List> init, std::string snapshot_dir, int snapshot_queue, std::string trace_file, std::string checkpoint_file, int checkpoint_every, bool resume, int stats_every, std::string stats_file, std::string precision, double mala_step, int adapt_iters, double adapt_target, std::string loss, double loss_floor, int loss_levels);
+RcppExport SEXP _mcmcPainter_rjmcmc_line_paint_cpp(SEXP targetSEXP, SEXP HSEXP, SEXP WSEXP, SEXP itersSEXP, SEXP beta_initSEXP, SEXP beta_finalSEXP, SEXP prob_movesSEXP, SEXP K_lambdaSEXP, SEXP save_everySEXP, SEXP on_snapshotSEXP, SEXP verboseSEXP, SEXP n_chainsSEXP, SEXP beta_ratioSEXP, SEXP swap_everySEXP, SEXP n_threadsSEXP, SEXP tile_sizeSEXP, SEXP tile_movesSEXP, SEXP jitter_triesSEXP, SEXP seedSEXP, SEXP initSEXP, SEXP snapshot_dirSEXP, SEXP snapshot_queueSEXP, SEXP trace_fileSEXP, SEXP checkpoint_fileSEXP, SEXP checkpoint_everySEXP, SEXP resumeSEXP, SEXP stats_everySEXP, SEXP stats_fileSEXP, SEXP precisionSEXP, SEXP mala_stepSEXP, SEXP adapt_itersSEXP, SEXP adapt_targetSEXP, SEXP lossSEXP, SEXP loss_floorSEXP, SEXP loss_levelsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< NumericVector >::type target(targetSEXP);
+    Rcpp::traits::input_parameter< int >::type H(HSEXP);
+    Rcpp::traits::input_parameter< int >::type W(WSEXP);
+    Rcpp::traits::input_parameter< int >::type iters(itersSEXP);
+    Rcpp::traits::input_parameter< double >::type beta_init(beta_initSEXP);
+    Rcpp::traits::input_parameter< double >::type beta_final(beta_finalSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type prob_moves(prob_movesSEXP);
+    Rcpp::traits::input_parameter< double >::type K_lambda(K_lambdaSEXP);
+    Rcpp::traits::input_parameter< int >::type save_every(save_everySEXP);
+    Rcpp::traits::input_parameter< Function >::type on_snapshot(on_snapshotSEXP);
+    Rcpp::traits::input_parameter< bool >::type verbose(verboseSEXP);
+    Rcpp::traits::input_parameter< int >::type n_chains(n_chainsSEXP);
+    Rcpp::traits::input_parameter< double >::type beta_ratio(beta_ratioSEXP);
+    Rcpp::traits::input_parameter< int >::type swap_every(swap_everySEXP);
+    Rcpp::traits::input_parameter< int >::type n_threads(n_threadsSEXP);
+    Rcpp::traits::input_parameter< int >::type tile_size(tile_sizeSEXP);
+    Rcpp::traits::input_parameter< int >::type tile_moves(tile_movesSEXP);
+    Rcpp::traits::input_parameter< int >::type jitter_tries(jitter_triesSEXP);
+    Rcpp::traits::input_parameter< int >::type seed(seedSEXP);
+    Rcpp::traits::input_parameter< Nullable<List> >::type init(initSEXP);
+    Rcpp::traits::input_parameter< std::string >::type snapshot_dir(snapshot_dirSEXP);
+    Rcpp::traits::input_parameter< int >::type snapshot_queue(snapshot_queueSEXP);
+    Rcpp::traits::input_parameter< std::string >::type trace_file(trace_fileSEXP);
+    Rcpp::traits::input_parameter< std::string >::type checkpoint_file(checkpoint_fileSEXP);
+    Rcpp::traits::input_parameter< int >::type checkpoint_every(checkpoint_everySEXP);
+    Rcpp::traits::input_parameter< bool >::type resume(resumeSEXP);
+    Rcpp::traits::input_parameter< int >::type stats_every(stats_everySEXP);
+    Rcpp::traits::input_parameter< std::string >::type stats_file(stats_fileSEXP);
+    Rcpp::traits::input_parameter< std::string >::type precision(precisionSEXP);
+    Rcpp::traits::input_parameter< double >::type mala_step(mala_stepSEXP);
+    Rcpp::traits::input_parameter< int >::type adapt_iters(adapt_itersSEXP);
+    Rcpp::traits::input_parameter< double >::type adapt_target(adapt_targetSEXP);
+    Rcpp::traits::input_parameter< std::string >::type loss(lossSEXP);
+    Rcpp::traits::input_parameter< double >::type loss_floor(loss_floorSEXP);
+    Rcpp::traits::input_parameter< int >::type loss_levels(loss_levelsSEXP);
+    rcpp_result_gen = Rcpp::wrap(rjmcmc_line_paint_cpp(target, H, W, iters, beta_init, beta_final, prob_moves, K_lambda, save_every, on_snapshot, verbose, n_chains, beta_ratio, swap_every, n_threads, tile_size, tile_moves, jitter_tries, seed, init, snapshot_dir, snapshot_queue, trace_file, checkpoint_file, checkpoint_every, resume, stats_every, stats_file, precision, mala_step, adapt_iters, adapt_target, loss, loss_floor, loss_levels));
+    return rcpp_result_gen;
+END_RCPP
+}
+// line_store_cpp
+SEXP line_store_cpp(List lines);
+RcppExport SEXP _mcmcPainter_line_store_cpp(SEXP linesSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< List >::type lines(linesSEXP);
+    rcpp_result_gen = Rcpp::wrap(line_store_cpp(lines));
+    return rcpp_result_gen;
+END_RCPP
+}
+// line_store_to_list_cpp
+List line_store_to_list_cpp(SEXP store);
+RcppExport SEXP _mcmcPainter_line_store_to_list_cpp(SEXP storeSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type store(storeSEXP);
+    rcpp_result_gen = Rcpp::wrap(line_store_to_list_cpp(store));
+    return rcpp_result_gen;
+END_RCPP
+}
+// line_store_size_cpp
+int line_store_size_cpp(SEXP store);
+RcppExport SEXP _mcmcPainter_line_store_size_cpp(SEXP storeSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type store(storeSEXP);
+    rcpp_result_gen = Rcpp::wrap(line_store_size_cpp(store));
+    return rcpp_result_gen;
+END_RCPP
+}
+// line_store_push_cpp
+int line_store_push_cpp(SEXP store, List line);
+RcppExport SEXP _mcmcPainter_line_store_push_cpp(SEXP storeSEXP, SEXP lineSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type store(storeSEXP);
+    Rcpp::traits::input_parameter< List >::type line(lineSEXP);
+    rcpp_result_gen = Rcpp::wrap(line_store_push_cpp(store, line));
+    return rcpp_result_gen;
+END_RCPP
+}
+// line_store_set_cpp
+void line_store_set_cpp(SEXP store, int i, List line);
+RcppExport SEXP _mcmcPainter_line_store_set_cpp(SEXP storeSEXP, SEXP iSEXP, SEXP lineSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type store(storeSEXP);
+    Rcpp::traits::input_parameter< int >::type i(iSEXP);
+    Rcpp::traits::input_parameter< List >::type line(lineSEXP);
+    line_store_set_cpp(store, i, line);
+    return R_NilValue;
+END_RCPP
+}
+// line_store_remove_cpp
+void line_store_remove_cpp(SEXP store, int i);
+RcppExport SEXP _mcmcPainter_line_store_remove_cpp(SEXP storeSEXP, SEXP iSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type store(storeSEXP);
+    Rcpp::traits::input_parameter< int >::type i(iSEXP);
+    line_store_remove_cpp(store, i);
+    return R_NilValue;
+END_RCPP
+}
+// render_line_store_cpp
+NumericVector render_line_store_cpp(SEXP store, int H, int W, int n_threads);
+RcppExport SEXP _mcmcPainter_render_line_store_cpp(SEXP storeSEXP, SEXP HSEXP, SEXP WSEXP, SEXP n_threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type store(storeSEXP);
+    Rcpp::traits::input_parameter< int >::type H(HSEXP);
+    Rcpp::traits::input_parameter< int >::type W(WSEXP);
+    Rcpp::traits::input_parameter< int >::type n_threads(n_threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(render_line_store_cpp(store, H, W, n_threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// replay_line_trace_cpp
+int replay_line_trace_cpp(std::string path, IntegerVector iters, int H, int W, Function on_frame, int n_threads);
+RcppExport SEXP _mcmcPainter_replay_line_trace_cpp(SEXP pathSEXP, SEXP itersSEXP, SEXP HSEXP, SEXP WSEXP, SEXP on_frameSEXP, SEXP n_threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::string >::type path(pathSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type iters(itersSEXP);
+    Rcpp::traits::input_parameter< int >::type H(HSEXP);
+    Rcpp::traits::input_parameter< int >::type W(WSEXP);
+    Rcpp::traits::input_parameter< Function >::type on_frame(on_frameSEXP);
+    Rcpp::traits::input_parameter< int >::type n_threads(n_threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(replay_line_trace_cpp(path, iters, H, W, on_frame, n_threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// trace_info_cpp
+List trace_info_cpp(std::string path);
+RcppExport SEXP _mcmcPainter_trace_info_cpp(SEXP pathSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::string >::type path(pathSEXP);
+    rcpp_result_gen = Rcpp::wrap(trace_info_cpp(path));
+    return rcpp_result_gen;
+END_RCPP
+}
+// read_png_cpp
+List read_png_cpp(std::string path);
+RcppExport SEXP _mcmcPainter_read_png_cpp(SEXP pathSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::string >::type path(pathSEXP);
+    rcpp_result_gen = Rcpp::wrap(read_png_cpp(path));
+    return rcpp_result_gen;
+END_RCPP
+}
+// image_from_bitmap_cpp
+List image_from_bitmap_cpp(RawVector bitmap, int W, int H, int depth);
+RcppExport SEXP _mcmcPainter_image_from_bitmap_cpp(SEXP bitmapSEXP, SEXP WSEXP, SEXP HSEXP, SEXP depthSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< RawVector >::type bitmap(bitmapSEXP);
+    Rcpp::traits::input_parameter< int >::type W(WSEXP);
+    Rcpp::traits::input_parameter< int >::type H(HSEXP);
+    Rcpp::traits::input_parameter< int >::type depth(depthSEXP);
+    rcpp_result_gen = Rcpp::wrap(image_from_bitmap_cpp(bitmap, W, H, depth));
+    return rcpp_result_gen;
+END_RCPP
+}
+// image_bitmap_cpp
+RawVector image_bitmap_cpp(SEXP image);
+RcppExport SEXP _mcmcPainter_image_bitmap_cpp(SEXP imageSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type image(imageSEXP);
+    rcpp_result_gen = Rcpp::wrap(image_bitmap_cpp(image));
+    return rcpp_result_gen;
+END_RCPP
+}
+// resize_image_cpp
+NumericVector resize_image_cpp(SEXP image, int out_w, int out_h);
+RcppExport SEXP _mcmcPainter_resize_image_cpp(SEXP imageSEXP, SEXP out_wSEXP, SEXP out_hSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type image(imageSEXP);
+    Rcpp::traits::input_parameter< int >::type out_w(out_wSEXP);
+    Rcpp::traits::input_parameter< int >::type out_h(out_hSEXP);
+    rcpp_result_gen = Rcpp::wrap(resize_image_cpp(image, out_w, out_h));
+    return rcpp_result_gen;
+END_RCPP
+}
+// render_lines_png_cpp
+List render_lines_png_cpp(List lines, int H, int W, int out_h, int out_w, std::string path, int n_threads, int strip_rows);
+RcppExport SEXP _mcmcPainter_render_lines_png_cpp(SEXP linesSEXP, SEXP HSEXP, SEXP WSEXP, SEXP out_hSEXP, SEXP out_wSEXP, SEXP pathSEXP, SEXP n_threadsSEXP, SEXP strip_rowsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< List >::type lines(linesSEXP);
+    Rcpp::traits::input_parameter< int >::type H(HSEXP);
+    Rcpp::traits::input_parameter< int >::type W(WSEXP);
+    Rcpp::traits::input_parameter< int >::type out_h(out_hSEXP);
+    Rcpp::traits::input_parameter< int >::type out_w(out_wSEXP);
+    Rcpp::traits::input_parameter< std::string >::type path(pathSEXP);
+    Rcpp::traits::input_parameter< int >::type n_threads(n_threadsSEXP);
+    Rcpp::traits::input_parameter< int >::type strip_rows(strip_rowsSEXP);
+    rcpp_result_gen = Rcpp::wrap(render_lines_png_cpp(lines, H, W, out_h, out_w, path, n_threads, strip_rows));
+    return rcpp_result_gen;
+END_RCPP
+}
+
+static const R_CallMethodDef CallEntries[] = {
+    {"_mcmcPainter_composite_dot_bbox_cpp", (DL_FUNC) &_mcmcPainter_composite_dot_bbox_cpp, 12},
+    {"_mcmcPainter_sse_bbox_dots_cpp", (DL_FUNC) &_mcmcPainter_sse_bbox_dots_cpp, 8},
+    {"_mcmcPainter_dot_bbox_cpp", (DL_FUNC) &_mcmcPainter_dot_bbox_cpp, 5},
+    {"_mcmcPainter_sample_dot_prior_cpp", (DL_FUNC) &_mcmcPainter_sample_dot_prior_cpp, 2},
+    {"_mcmcPainter_jitter_dot_cpp", (DL_FUNC) &_mcmcPainter_jitter_dot_cpp, 7},
+    {"_mcmcPainter_sample_dot_birth_datadriven_cpp", (DL_FUNC) &_mcmcPainter_sample_dot_birth_datadriven_cpp, 4},
+    {"_mcmcPainter_re_render_bbox_from_dots_cpp", (DL_FUNC) &_mcmcPainter_re_render_bbox_from_dots_cpp, 8},
+    {"_mcmcPainter_render_full_canvas_from_dots_cpp", (DL_FUNC) &_mcmcPainter_render_full_canvas_from_dots_cpp, 5},
+    {"_mcmcPainter_rjmcmc_dot_paint_cpp", (DL_FUNC) &_mcmcPainter_rjmcmc_dot_paint_cpp, 34},
+    {"_mcmcPainter_dot_store_cpp", (DL_FUNC) &_mcmcPainter_dot_store_cpp, 1},
+    {"_mcmcPainter_dot_store_to_list_cpp", (DL_FUNC) &_mcmcPainter_dot_store_to_list_cpp, 1},
+    {"_mcmcPainter_dot_store_size_cpp", (DL_FUNC) &_mcmcPainter_dot_store_size_cpp, 1},
+    {"_mcmcPainter_dot_store_push_cpp", (DL_FUNC) &_mcmcPainter_dot_store_push_cpp, 2},
+    {"_mcmcPainter_dot_store_set_cpp", (DL_FUNC) &_mcmcPainter_dot_store_set_cpp, 3},
+    {"_mcmcPainter_dot_store_remove_cpp", (DL_FUNC) &_mcmcPainter_dot_store_remove_cpp, 2},
+    {"_mcmcPainter_render_dot_store_cpp", (DL_FUNC) &_mcmcPainter_render_dot_store_cpp, 4},
+    {"_mcmcPainter_replay_dot_trace_cpp", (DL_FUNC) &_mcmcPainter_replay_dot_trace_cpp, 6},
+    {"_mcmcPainter_render_dots_png_cpp", (DL_FUNC) &_mcmcPainter_render_dots_png_cpp, 8},
+    {"_mcmcPainter_composite_line_bbox_cpp", (DL_FUNC) &_mcmcPainter_composite_line_bbox_cpp, 14},
+    {"_mcmcPainter_sse_bbox_cpp", (DL_FUNC) &_mcmcPainter_sse_bbox_cpp, 8},
+    {"_mcmcPainter_line_bbox_cpp", (DL_FUNC) &_mcmcPainter_line_bbox_cpp, 8},
+    {"_mcmcPainter_sample_line_prior_cpp", (DL_FUNC) &_mcmcPainter_sample_line_prior_cpp, 2},
+    {"_mcmcPainter_jitter_line_cpp", (DL_FUNC) &_mcmcPainter_jitter_line_cpp, 7},
+    {"_mcmcPainter_sample_line_birth_datadriven_cpp", (DL_FUNC) &_mcmcPainter_sample_line_birth_datadriven_cpp, 4},
+    {"_mcmcPainter_re_render_bbox_from_lines_cpp", (DL_FUNC) &_mcmcPainter_re_render_bbox_from_lines_cpp, 8},
+    {"_mcmcPainter_render_full_canvas_cpp", (DL_FUNC) &_mcmcPainter_render_full_canvas_cpp, 4},
+    {"_mcmcPainter_rjmcmc_line_paint_cpp", (DL_FUNC) &_mcmcPainter_rjmcmc_line_paint_cpp, 35},
+    {"_mcmcPainter_line_store_cpp", (DL_FUNC) &_mcmcPainter_line_store_cpp, 1},
+    {"_mcmcPainter_line_store_to_list_cpp", (DL_FUNC) &_mcmcPainter_line_store_to_list_cpp, 1},
+    {"_mcmcPainter_line_store_size_cpp", (DL_FUNC) &_mcmcPainter_line_store_size_cpp, 1},
+    {"_mcmcPainter_line_store_push_cpp", (DL_FUNC) &_mcmcPainter_line_store_push_cpp, 2},
+    {"_mcmcPainter_line_store_set_cpp", (DL_FUNC) &_mcmcPainter_line_store_set_cpp, 3},
+    {"_mcmcPainter_line_store_remove_cpp", (DL_FUNC) &_mcmcPainter_line_store_remove_cpp, 2},
+    {"_mcmcPainter_render_line_store_cpp", (DL_FUNC) &_mcmcPainter_render_line_store_cpp, 4},
+    {"_mcmcPainter_replay_line_trace_cpp", (DL_FUNC) &_mcmcPainter_replay_line_trace_cpp, 6},
+    {"_mcmcPainter_trace_info_cpp", (DL_FUNC) &_mcmcPainter_trace_info_cpp, 1},
+    {"_mcmcPainter_read_png_cpp", (DL_FUNC) &_mcmcPainter_read_png_cpp, 1},
+    {"_mcmcPainter_image_from_bitmap_cpp", (DL_FUNC) &_mcmcPainter_image_from_bitmap_cpp, 4},
+    {"_mcmcPainter_image_bitmap_cpp", (DL_FUNC) &_mcmcPainter_image_bitmap_cpp, 1},
+    {"_mcmcPainter_resize_image_cpp", (DL_FUNC) &_mcmcPainter_resize_image_cpp, 3},
+    {"_mcmcPainter_render_lines_png_cpp", (DL_FUNC) &_mcmcPainter_render_lines_png_cpp, 8},
+    {NULL, NULL, 0}
+};
+
+RcppExport void R_init_mcmcPainter(DllInfo *dll) {
+    R_registerRoutines(dll, NULL, CallEntries, NULL, NULL);
+    R_useDynamicSymbols(dll, FALSE);
+}
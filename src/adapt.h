@@ -0,0 +1,184 @@
+// adapt.h
+// Burn-in tuning of the move mix and the jitter scales. During the first
+// adapt_iters iterations the sampler feeds every regular move to a
+// MoveAdapter, which keeps per move type the proposals, acceptances, work
+// and net SSE improvement of the current window. Work is the pixel area of
+// the scored proposal bboxes plus ADAPT_MOVE_COST per move: a deterministic
+// stand-in for wall time, so a tuned run still depends on its seed only. At
+// the end of each window of ADAPT_WINDOW iterations:
+//
+//   jitter  the jitter sd factor is scaled by exp(g (rate - target)), capped
+//           at x2 per window and to [1/20, 20] overall, with a gain g that
+//           falls as 1 / sqrt(window), so the acceptance rate settles at
+//           adapt_target;
+//   mix     each move group gets a share of the total probability that
+//           moves halfway towards its share of the SSE improvement (of the
+//           moves that improved) per unit of work, kept within
+//           [ADAPT_FLOOR, 1 / ADAPT_FLOOR] of its starting share. Birth and
+//           death form one group and keep their ratio, which the
+//           dimension-jump acceptance assumes; moves with probability 0
+//           stay off.
+//
+// After adapt_iters both are frozen. The factor is tuned at the temperature
+// of the last window, beta_ref, and the posterior narrows as beta grows, so
+// the sds in use at beta are jitter0 * factor * sqrt(beta_ref / beta): a
+// frozen absolute sd would be far too wide by the end of the schedule.
+#ifndef MCMCPAINTER_ADAPT_H
+#define MCMCPAINTER_ADAPT_H
+
+#include "painter_common.h"
+#include "stats.h"
+#include <cmath>
+
+enum { ADAPT_WINDOW = 500, ADAPT_MOVE_COST = 64 };
+static const double ADAPT_FLOOR = 0.5;
+
+// Acceptance rate a random-walk and a Langevin jitter are tuned towards
+// when adapt_target <= 0
+inline double adapt_default_target(bool mala) { return mala ? 0.574 : 0.234; }
+
+class MoveAdapter {
+public:
+  MoveAdapter() : windows_(0), scale_(1.0), last_rate_(0.0), beta_ref_(0.0) {
+    for (int m = 0; m < 4; m++) p0_[m] = 0.0;
+    clear_window();
+  }
+
+  // Starting move probabilities (before any tuning)
+  void start(const double* prob_moves) {
+    for (int m = 0; m < 4; m++) p0_[m] = prob_moves[m];
+    windows_ = 0;
+    scale_ = 1.0;
+    last_rate_ = 0.0;
+    beta_ref_ = 0.0;
+    clear_window();
+  }
+
+  // One regular move of type m: accepted or not, the bbox area it scored
+  // and the SSE before minus after. Only improvements count as gain: the
+  // SSE a hot chain gives back is exploration, not a cost of the move type
+  void record(int m, bool accepted, double area, double gain) {
+    w_.proposed[m]++;
+    if (accepted) w_.accepted[m]++;
+    work_[m] += area + ADAPT_MOVE_COST;
+    if (gain > 0.0) gain_[m] += gain;
+  }
+
+  // Close the window at temperature beta: retune the jitter factor towards
+  // the acceptance target and prob_moves in place
+  void update(double* prob_moves, double beta, double target) {
+    windows_++;
+    const long long nj = w_.proposed[MOVE_JITTER];
+    if (nj > 0) {
+      last_rate_ = (double)w_.accepted[MOVE_JITTER] / nj;
+      const double g = 1.0 / std::sqrt((double)windows_);
+      const double f = std::max(0.5, std::min(2.0, std::exp(g * (last_rate_ - target))));
+      scale_ = std::max(0.05, std::min(20.0, scale_ * f));
+      beta_ref_ = beta;
+    }
+
+    // groups: birth + death, jitter, swap
+    const int group[4] = { 0, 0, 1, 2 };
+    double p_start[3] = { 0, 0, 0 }, p_now[3] = { 0, 0, 0 }, rate[3] = { 0, 0, 0 };
+    double work[3] = { 0, 0, 0 }, gain[3] = { 0, 0, 0 };
+    long long n[3] = { 0, 0, 0 };
+    for (int m = 0; m < 4; m++) {
+      p_start[group[m]] += p0_[m];
+      p_now[group[m]] += prob_moves[m];
+      work[group[m]] += work_[m];
+      gain[group[m]] += gain_[m];
+      n[group[m]] += w_.proposed[m];
+    }
+    double total = 0.0, rsum = 0.0, start_total = 0.0;
+    for (int k = 0; k < 3; k++) {
+      total += p_now[k];
+      start_total += p_start[k];
+      if (p_start[k] > 0.0 && n[k] > 0) rate[k] = std::max(0.0, gain[k] / work[k]);
+      rsum += rate[k];
+    }
+    if (rsum > 0.0 && total > 0.0) {
+      double p_new[3], norm = 0.0;
+      for (int k = 0; k < 3; k++) {
+        if (p_start[k] <= 0.0) { p_new[k] = 0.0; continue; }
+        const double share = 0.5 * (p_now[k] / total) + 0.5 * (rate[k] / rsum);
+        const double p0 = p_start[k] / start_total;
+        p_new[k] = std::max(ADAPT_FLOOR * p0, std::min(p0 / ADAPT_FLOOR, share));
+        norm += p_new[k];
+      }
+      for (int m = 0; m < 4; m++) {
+        const int k = group[m];
+        prob_moves[m] = p_start[k] > 0.0 ? total * p_new[k] / norm * (p0_[m] / p_start[k]) : 0.0;
+      }
+    }
+    clear_window();
+  }
+
+  // Jitter sds at temperature beta (jitter0 the configured ones); untuned
+  // until the first window closes
+  void apply(JitterScales& jitter, const JitterScales& jitter0, double beta) const {
+    const double f = beta_ref_ > 0.0 ? scale_ * std::sqrt(beta_ref_ / beta) : 1.0;
+    jitter.s_xy = jitter0.s_xy * f;
+    jitter.s_size = jitter0.s_size * f;
+    jitter.s_a = jitter0.s_a * f;
+    jitter.s_c = jitter0.s_c * f;
+  }
+
+  int windows() const { return windows_; }
+  double scale() const { return scale_; }              // jitter sd factor
+  double last_rate() const { return last_rate_; }      // jitter acceptance, last window
+  double beta_ref() const { return beta_ref_; }        // beta the factor was tuned at
+
+  template <class Ar>
+  void checkpoint(Ar& ar) {
+    ar.pod(p0_);
+    ar.pod(windows_);
+    ar.pod(scale_);
+    ar.pod(last_rate_);
+    ar.pod(beta_ref_);
+    ar.pod(w_);
+    ar.pod(work_);
+    ar.pod(gain_);
+  }
+
+private:
+  void clear_window() {
+    w_.clear();
+    for (int m = 0; m < 4; m++) {
+      work_[m] = 0.0;
+      gain_[m] = 0.0;
+    }
+  }
+
+  double p0_[4];
+  int windows_;
+  double scale_, last_rate_, beta_ref_;
+  MoveCounts w_;      // this window
+  double work_[4];    // pixels
+  double gain_[4];
+};
+
+// R form: the move mix and jitter scales in use at the end of the run, the
+// jitter sd factor and the beta it was tuned at, the number of tuning
+// windows and the jitter acceptance of the last one
+inline Rcpp::List adapt_to_list(const double* prob_moves, const JitterScales& j,
+                                const MoveAdapter& a) {
+  Rcpp::NumericVector pm(4);
+  Rcpp::CharacterVector names(4);
+  for (int m = 0; m < 4; m++) {
+    pm[m] = prob_moves[m];
+    names[m] = move_name(m);
+  }
+  pm.attr("names") = names;
+  return Rcpp::List::create(
+    Rcpp::Named("prob_moves") = pm,
+    Rcpp::Named("jitter") = Rcpp::NumericVector::create(
+      Rcpp::Named("s_xy") = j.s_xy, Rcpp::Named("s_size") = j.s_size,
+      Rcpp::Named("s_a") = j.s_a, Rcpp::Named("s_c") = j.s_c),
+    Rcpp::Named("jitter_scale") = a.scale(),
+    Rcpp::Named("beta_ref") = a.beta_ref(),
+    Rcpp::Named("windows") = a.windows(),
+    Rcpp::Named("jitter_accept") = a.last_rate()
+  );
+}
+
+#endif
@@ -0,0 +1,177 @@
+// canvas.h
+// Native working canvas: row-major, interleaved RGBA float, rows padded to
+// a multiple of 8 floats and 32-byte aligned. Compositing a pixel touches one
+// 16-byte slot and a row walk is contiguous, unlike the planar [H,W,3] R
+// layout, which is only produced at snapshot/export time (to_planar).
+//
+// Coordinates are 1-based like the rest of the package. A canvas can also
+// be a tile: a sub-rectangle with its own origin, addressed in the same
+// global pixel coordinates (see reset_tile). The alpha channel is kept at 1
+// (opaque) and carried along only for alignment.
+#ifndef MCMCPAINTER_CANVAS_H
+#define MCMCPAINTER_CANVAS_H
+
+#include "painter_common.h"
+#include "simd.h"
+#include <cstdint>
+#include <cstring>
+
+class Canvas {
+public:
+  enum { CH = 4 };
+
+  Canvas() : H_(0), W_(0), x0_(1), y0_(1), stride_(0), data_(NULL) {}
+
+  Canvas(int H, int W, float v = 1.0f) : x0_(1), y0_(1), data_(NULL) {
+    alloc(H, W);
+    BBox all = { 1, W, 1, H };
+    fill(all, v);
+  }
+
+  Canvas(const Canvas& o) : x0_(o.x0_), y0_(o.y0_), data_(NULL) {
+    alloc(o.H_, o.W_);
+    if (o.data_) std::memcpy(data_, o.data_, bytes());
+  }
+
+  Canvas& operator=(const Canvas& o) {
+    if (this != &o) {
+      if (o.H_ != H_ || o.W_ != W_) alloc(o.H_, o.W_);
+      x0_ = o.x0_;
+      y0_ = o.y0_;
+      if (o.data_) std::memcpy(data_, o.data_, bytes());
+    }
+    return *this;
+  }
+
+  // O(1); the aligned pointers stay valid across a vector swap
+  void swap(Canvas& o) {
+    buf_.swap(o.buf_);
+    std::swap(H_, o.H_);
+    std::swap(W_, o.W_);
+    std::swap(x0_, o.x0_);
+    std::swap(y0_, o.y0_);
+    std::swap(stride_, o.stride_);
+    std::swap(data_, o.data_);
+  }
+
+  int H() const { return H_; }
+  int W() const { return W_; }
+  size_t stride() const { return stride_; }  // floats per row
+
+  // Pixels covered, in global coordinates
+  BBox bounds() const {
+    BBox b = { x0_, x0_ + W_ - 1, y0_, y0_ + H_ - 1 };
+    return b;
+  }
+
+  // Turn this canvas into an (uninitialised) tile covering b, reusing the
+  // allocation when it is large enough
+  void reset_tile(const BBox& b) {
+    x0_ = b.xmin;
+    y0_ = b.ymin;
+    const int W = b.xmax - b.xmin + 1, H = b.ymax - b.ymin + 1;
+    const size_t stride = ((size_t)CH * W + 7) / 8 * 8;
+    if ((size_t)H * stride + 8 <= buf_.size()) {
+      H_ = H;
+      W_ = W;
+      stride_ = stride;
+    } else {
+      alloc(H, W);
+    }
+  }
+
+  float* row(int y) { return data_ + (size_t)(y - y0_) * stride_; }
+  const float* row(int y) const { return data_ + (size_t)(y - y0_) * stride_; }
+  float* px(int y, int x) { return row(y) + CH * (size_t)(x - x0_); }
+  const float* px(int y, int x) const { return row(y) + CH * (size_t)(x - x0_); }
+
+  // Set RGB in b to v (alpha to 1)
+  void fill(const BBox& b, float v) {
+    for (int y = b.ymin; y <= b.ymax; y++) {
+      float* p = px(y, b.xmin);
+      for (int x = b.xmin; x <= b.xmax; x++, p += CH) {
+        p[0] = v; p[1] = v; p[2] = v; p[3] = 1.0f;
+      }
+    }
+  }
+
+  void copy_from(const Canvas& src, const BBox& b) {
+    const size_t n = CH * (size_t)(b.xmax - b.xmin + 1) * sizeof(float);
+    for (int y = b.ymin; y <= b.ymax; y++) std::memcpy(px(y, b.xmin), src.px(y, b.xmin), n);
+  }
+
+  // From / to the R planar layout [H, W, 3] (see idx3); full canvases only
+  void from_planar(const double* a) {
+    for (int y = 1; y <= H_; y++) {
+      float* p = row(y);
+      for (int x = 1; x <= W_; x++, p += CH) {
+        for (int c = 0; c < 3; c++) p[c] = (float)a[idx3(y, x, c, H_, W_)];
+        p[3] = 1.0f;
+      }
+    }
+  }
+
+  void to_planar(double* a) const {
+    for (int x = 1; x <= W_; x++)
+      for (int y = 1; y <= H_; y++) {
+        const float* p = px(y, x);
+        for (int c = 0; c < 3; c++) a[idx3(y, x, c, H_, W_)] = p[c];
+      }
+  }
+
+private:
+  size_t bytes() const { return (size_t)H_ * stride_ * sizeof(float); }
+
+  void alloc(int H, int W) {
+    H_ = H;
+    W_ = W;
+    stride_ = ((size_t)CH * W + 7) / 8 * 8;
+    buf_.assign((size_t)H * stride_ + 8, 0.0f);
+    const uintptr_t p = (uintptr_t)buf_.data();
+    data_ = buf_.data() + ((32 - p % 32) % 32) / sizeof(float);
+  }
+
+  int H_, W_;
+  int x0_, y0_;  // global coordinates of the first pixel
+  size_t stride_;
+  std::vector<float> buf_;  // over-allocated by 32 bytes for alignment
+  float* data_;
+};
+
+inline double sse_bbox(const Canvas& target, const Canvas& canvas, const BBox& b) {
+  double acc = 0.0;
+  const int n = b.xmax - b.xmin + 1;
+  if (n <= 0) return 0.0;
+  for (int y = b.ymin; y <= b.ymax; y++)
+    acc += sse_rgba_span(target.px(y, b.xmin), canvas.px(y, b.xmin), n);
+  return acc;
+}
+
+// sse(target, after) - sse(target, before) over b in one pass
+inline double sse_delta_bbox(const Canvas& target, const Canvas& after,
+                             const Canvas& before, const BBox& b) {
+  double acc = 0.0;
+  const int n = b.xmax - b.xmin + 1;
+  if (n <= 0) return 0.0;
+  for (int y = b.ymin; y <= b.ymax; y++)
+    acc += sse_delta_rgba_span(target.px(y, b.xmin), after.px(y, b.xmin),
+                               before.px(y, b.xmin), n);
+  return acc;
+}
+
+// Convert the native canvas into an R array with dim = c(H, W, 3)
+inline Rcpp::NumericVector canvas_to_array(const Canvas& canvas) {
+  Rcpp::NumericVector out(canvas.H() * canvas.W() * 3);
+  canvas.to_planar(out.begin());
+  out.attr("dim") = Rcpp::Dimension(canvas.H(), canvas.W(), 3);
+  return out;
+}
+
+// Native copy of a planar R array [H, W, 3]
+inline Canvas canvas_from_planar(const double* a, int H, int W) {
+  Canvas c(H, W);
+  c.from_planar(a);
+  return c;
+}
+
+#endif
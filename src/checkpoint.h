@@ -0,0 +1,337 @@
+// checkpoint.h
+// Sampler checkpoints: the complete chain state (SoA primitives, paint-order
+// keys, RNG, iteration, running SSE, best state) in one flat binary file, so
+// a long run can resume after the session dies. The canvas, tile index and
+// residual tree are not stored; they are rebuilt from the primitives on load.
+//
+// Layout, native byte order:
+//   CheckpointHeader (fixed size) | payload of payload_bytes
+// The payload is written by the state's checkpoint(ar) members in one order
+// and read back by the same members; arrays start on 8-byte boundaries, so
+// a mapped file holds them aligned. Saving maps a new file of the final
+// size, copies the arrays in and renames it over the old checkpoint, so a
+// crash mid-save leaves the previous checkpoint intact. Loading maps the
+// file read-only and copies straight out of the mapping. Without mmap
+// (_WIN32) the same bytes go through a buffer and stdio.
+#ifndef MCMCPAINTER_CHECKPOINT_H
+#define MCMCPAINTER_CHECKPOINT_H
+
+#include "painter_common.h"
+#include "loss.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+struct CheckpointHeader {
+  char magic[4];
+  uint32_t version, kind;  // kind as in trace.h (TRACE_LINES / TRACE_DOTS)
+  int32_t H, W, n_chains;
+  uint32_t nfields, bom;
+  int32_t iter, iters;     // iteration reached, of iters
+  double beta_init, beta_final;
+  double beta;             // schedule value at iter, for reference
+  uint64_t target_hash;    // FNV-1a of the target, precision and loss of the run
+  uint64_t config_hash;    // FNV-1a of the sampler settings the chain depends on
+  uint64_t trace_records;  // records in the run's trace at iter (trace_mark), 0 if none
+  uint64_t payload_bytes;
+};
+
+static const uint32_t CHECKPOINT_VERSION = 4;  // 2: tuned move mix and jitter, 3: trace length,
+                                               // 4: config hash
+static const uint32_t CHECKPOINT_BOM = 0x01020304;
+
+// FNV-1a over n more doubles, continuing the running hash h
+inline uint64_t checkpoint_hash(uint64_t h, const double* v, size_t n) {
+  const unsigned char* p = (const unsigned char*)v;
+  for (size_t i = 0; i < n * sizeof(double); i++) h = (h ^ p[i]) * 0x100000001b3ULL;
+  return h;
+}
+
+// FNV-1a over the target's bytes, so a checkpoint is not resumed on another image
+inline uint64_t checkpoint_hash(const double* v, size_t n) {
+  return checkpoint_hash(0xcbf29ce484222325ULL, v, n);
+}
+
+// The same hash continued over a target storage other than float32
+// (StoragePrecision, target_image.h) and a loss other than the SSE
+// (loss.h): the running total is taken against the stored target and is
+// of that loss, so the checkpoint only resumes under both
+inline uint64_t checkpoint_hash(uint64_t h, int precision, const LossConfig& loss) {
+  if (precision == 0 && loss.kind == LOSS_SSE) return h;
+  const double v[4] = { (double)precision, (double)loss.kind, loss.floor, (double)loss.levels };
+  return checkpoint_hash(h, v, 4);
+}
+
+// Payload writer; with out == NULL it only counts the bytes
+class CheckpointOut {
+public:
+  explicit CheckpointOut(unsigned char* out = NULL) : out_(out), n_(0) {}
+
+  void raw(const void* data, size_t n) {
+    if (out_ != NULL && n > 0) std::memcpy(out_ + n_, data, n);
+    n_ += n;
+  }
+  template <class T> void pod(const T& v) { raw(&v, sizeof(T)); }
+  template <class T> void vec(const std::vector<T>& v) {
+    const uint64_t n = v.size();
+    pod(n);
+    align();
+    raw(v.data(), n * sizeof(T));
+    align();
+  }
+  size_t size() const { return n_; }
+
+private:
+  void align() {
+    static const unsigned char zero[8] = { 0 };
+    raw(zero, (8 - n_ % 8) % 8);
+  }
+
+  unsigned char* out_;
+  size_t n_;
+};
+
+// Payload reader; Rcpp::stop on a short or corrupt payload
+class CheckpointIn {
+public:
+  CheckpointIn(const unsigned char* in, size_t size) : in_(in), size_(size), n_(0) {}
+
+  void raw(void* data, size_t n) {
+    if (n > size_ - n_) Rcpp::stop("checkpoint is truncated");
+    if (n > 0) std::memcpy(data, in_ + n_, n);
+    n_ += n;
+  }
+  template <class T> void pod(T& v) { raw(&v, sizeof(T)); }
+  template <class T> void vec(std::vector<T>& v) {
+    uint64_t n;
+    pod(n);
+    align();
+    if (n > (size_ - n_) / sizeof(T)) Rcpp::stop("checkpoint is truncated");
+    v.resize(n);
+    raw(v.data(), n * sizeof(T));
+    align();
+  }
+
+private:
+  void align() { n_ = std::min(size_, n_ + (8 - n_ % 8) % 8); }
+
+  const unsigned char* in_;
+  size_t size_, n_;
+};
+
+// One save or load of a checkpoint file: a writable mapping of a new file
+// of n bytes, or a read-only mapping of an existing one
+class CheckpointFile {
+public:
+  CheckpointFile() : data_(NULL), size_(0) {
+#ifndef _WIN32
+    fd_ = -1;
+#endif
+  }
+  ~CheckpointFile() { unmap(); }
+
+  // Map path (created or truncated) with n writable bytes
+  bool create(const std::string& path, size_t n) {
+    size_ = n;
+#ifndef _WIN32
+    fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd_ < 0 || ::ftruncate(fd_, (off_t)n) != 0) return false;
+    void* p = ::mmap(NULL, n, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (p == MAP_FAILED) return false;
+    data_ = (unsigned char*)p;
+#else
+    buf_.assign(n, 0);
+    data_ = buf_.data();
+#endif
+    path_ = path;
+    return true;
+  }
+
+  // Write the pages back and close; false on any error
+  bool commit() {
+#ifndef _WIN32
+    bool ok = data_ != NULL && ::msync(data_, size_, MS_SYNC) == 0;
+    ok = unmap() && ok;
+    return ok;
+#else
+    FILE* f = std::fopen(path_.c_str(), "wb");
+    if (f == NULL) return false;
+    const bool ok = std::fwrite(buf_.data(), 1, size_, f) == size_;
+    unmap();
+    return std::fclose(f) == 0 && ok;
+#endif
+  }
+
+  // Map path read-only; false if it cannot be opened
+  bool open(const std::string& path) {
+#ifndef _WIN32
+    fd_ = ::open(path.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd_ < 0 || ::fstat(fd_, &st) != 0) return false;
+    size_ = (size_t)st.st_size;
+    if (size_ == 0) return true;
+    void* p = ::mmap(NULL, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+    if (p == MAP_FAILED) return false;
+    data_ = (unsigned char*)p;
+#else
+    FILE* f = std::fopen(path.c_str(), "rb");
+    if (f == NULL) return false;
+    std::fseek(f, 0, SEEK_END);
+    buf_.resize((size_t)std::ftell(f));
+    std::fseek(f, 0, SEEK_SET);
+    const bool ok = buf_.empty() || std::fread(buf_.data(), 1, buf_.size(), f) == buf_.size();
+    std::fclose(f);
+    if (!ok) return false;
+    data_ = buf_.data();
+    size_ = buf_.size();
+#endif
+    return true;
+  }
+
+  unsigned char* data() const { return data_; }
+  size_t size() const { return size_; }
+
+private:
+  bool unmap() {
+    bool ok = true;
+#ifndef _WIN32
+    if (data_ != NULL) ok = ::munmap(data_, size_) == 0;
+    if (fd_ >= 0) ok = ::close(fd_) == 0 && ok;
+    fd_ = -1;
+#else
+    std::vector<unsigned char>().swap(buf_);
+#endif
+    data_ = NULL;
+    return ok;
+  }
+
+  unsigned char* data_;
+  size_t size_;
+  std::string path_;
+#ifndef _WIN32
+  int fd_;
+#else
+  std::vector<unsigned char> buf_;
+#endif
+};
+
+// Periodic checkpoints of one run to path. State is an RJSampler or a
+// ParallelTempering, both of which provide
+//   template <class Ar> void checkpoint(Ar& ar);  // CheckpointOut or CheckpointIn
+//   void restore();                                // rebuild derived state after a load
+// Main thread only.
+class Checkpointer {
+public:
+  Checkpointer(const std::string& path, uint32_t kind, int H, int W, int n_chains,
+               uint32_t nfields, int iters, double beta_init, double beta_final,
+               uint64_t target_hash, uint64_t config_hash)
+    : path_(path), warned_(false), trace_records_(0) {
+    std::memset(&h_, 0, sizeof(h_));
+    std::memcpy(h_.magic, "MCPC", 4);
+    h_.version = CHECKPOINT_VERSION;
+    h_.kind = kind;
+    h_.H = H;
+    h_.W = W;
+    h_.n_chains = n_chains;
+    h_.nfields = nfields;
+    h_.bom = CHECKPOINT_BOM;
+    h_.iters = iters;
+    h_.beta_init = beta_init;
+    h_.beta_final = beta_final;
+    h_.target_hash = target_hash;
+    h_.config_hash = config_hash;
+  }
+
+  bool enabled() const { return !path_.empty(); }
+
+  // Write state at iteration iter, the run's trace then holding
+  // trace_records records; a failed save only warns (once), the run goes on
+  // and the previous checkpoint stays in place
+  template <class State>
+  bool save(State& state, int iter, double beta, uint64_t trace_records = 0) {
+    if (!enabled()) return false;
+    CheckpointOut count;
+    state.checkpoint(count);
+
+    CheckpointHeader h = h_;
+    h.iter = iter;
+    h.beta = beta;
+    h.trace_records = trace_records;
+    h.payload_bytes = count.size();
+
+    const std::string tmp = path_ + ".tmp";
+    bool ok;
+    {
+      CheckpointFile f;
+      ok = f.create(tmp, sizeof(h) + count.size());
+      if (ok) {
+        std::memcpy(f.data(), &h, sizeof(h));
+        CheckpointOut out(f.data() + sizeof(h));
+        state.checkpoint(out);
+        ok = f.commit();
+      }
+    }
+#ifdef _WIN32
+    if (ok) std::remove(path_.c_str());  // rename does not replace there
+#endif
+    ok = ok && std::rename(tmp.c_str(), path_.c_str()) == 0;
+    if (!ok) {
+      std::remove(tmp.c_str());
+      if (!warned_) Rcpp::warning("could not write checkpoint %s", path_.c_str());
+      warned_ = true;
+    }
+    return ok;
+  }
+
+  // Load state from the checkpoint; Rcpp::stop if it belongs to another
+  // run. Returns the iteration it was taken at.
+  template <class State>
+  int load(State& state) {
+    CheckpointFile f;
+    if (!f.open(path_)) Rcpp::stop("cannot open checkpoint: " + path_);
+    CheckpointHeader h;
+    if (f.size() < sizeof(h)) Rcpp::stop("not a sampler checkpoint: " + path_);
+    std::memcpy(&h, f.data(), sizeof(h));
+    if (std::memcmp(h.magic, "MCPC", 4) != 0) Rcpp::stop("not a sampler checkpoint: " + path_);
+    if (h.bom != CHECKPOINT_BOM) Rcpp::stop("checkpoint written with a different byte order: " + path_);
+    if (h.version != CHECKPOINT_VERSION) Rcpp::stop("unsupported checkpoint version: " + path_);
+    if (h.kind != h_.kind || h.nfields != h_.nfields)
+      Rcpp::stop("checkpoint holds a different primitive type: " + path_);
+    if (h.H != h_.H || h.W != h_.W) Rcpp::stop("checkpoint was taken at a different image size");
+    if (h.n_chains != h_.n_chains) Rcpp::stop("checkpoint was taken with a different n_chains");
+    if (h.target_hash != h_.target_hash) Rcpp::stop("checkpoint was taken on a different target image, precision or loss");
+    if (h.config_hash != h_.config_hash)
+      Rcpp::stop("checkpoint was taken with different sampler settings (seed, moves, jitter, "
+                 "tiles, MALA, adaptation or tempering)");
+    if (h.payload_bytes > f.size() - sizeof(h)) Rcpp::stop("checkpoint is truncated: " + path_);
+    if (h.iters != h_.iters || h.beta_init != h_.beta_init || h.beta_final != h_.beta_final)
+      Rcpp::warning("checkpoint was taken with another iteration count or beta schedule; "
+                    "resuming on the new one");
+
+    CheckpointIn in(f.data() + sizeof(h), (size_t)h.payload_bytes);
+    state.checkpoint(in);
+    state.restore();
+    trace_records_ = h.trace_records;
+    return h.iter;
+  }
+
+  // Trace length stored by the loaded checkpoint (see resume_trace)
+  uint64_t trace_records() const { return trace_records_; }
+
+private:
+  std::string path_;
+  CheckpointHeader h_;
+  bool warned_;
+  uint64_t trace_records_;
+};
+
+#endif
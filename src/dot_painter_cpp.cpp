@@ -3,21 +3,54 @@
 #include <Rcpp.h>
 #include <random>
 #include <cmath>
+#include "painter_engine.h"
+#include "painter_driver.h"
+#include "trace.h"
+#include "checkpoint.h"
+#include "hires_render.h"
+#include "dot_policy.h"
 using namespace Rcpp;
 
-// ---- helpers ----
-inline double clamp01(double v) {
-  if (v < 0.0) return 0.0;
-  if (v > 1.0) return 1.0;
-  return v;
+inline DotParams dot_from_list(List dot) {
+  DotParams d;
+  d.x = as<double>(dot["x"]);
+  d.y = as<double>(dot["y"]);
+  d.radius = as<double>(dot["radius"]);
+  d.alpha = as<double>(dot["alpha"]);
+  NumericVector col = as<NumericVector>(dot["col"]);
+  for (int c = 0; c < 3; c++) d.col[c] = col[c];
+  return d;
+}
+
+inline List dot_to_list(const DotParams& d) {
+  NumericVector col(3);
+  for (int c = 0; c < 3; c++) col[c] = d.col[c];
+  return List::create(
+    Named("x") = d.x, Named("y") = d.y,
+    Named("radius") = d.radius, Named("alpha") = d.alpha,
+    Named("col") = col
+  );
+}
+
+inline std::vector<DotParams> dots_from_list(List dots) {
+  std::vector<DotParams> out;
+  out.reserve(dots.length());
+  for (int i = 0; i < dots.length(); i++) out.push_back(dot_from_list(dots[i]));
+  return out;
+}
+
+inline List dots_to_list(const std::vector<DotParams>& dots) {
+  List out(dots.size());
+  for (size_t i = 0; i < dots.size(); i++) out[i] = dot_to_list(dots[i]);
+  return out;
 }
 
-// Linear index for R array [H, W, 3] (column-major)
-inline int idx3(int y, int x, int c, int H, int W) {
-  // y, x are 1-based coming from R/loops; convert to 0-based
-  int y0 = y - 1;
-  int x0 = x - 1;
-  return y0 + x0 * H + c * H * W;
+typedef PrimitiveStore<DotPolicy> DotStore;
+
+// Clamp a user-supplied bbox to the canvas
+inline BBox clamp_bbox(int xmin, int xmax, int ymin, int ymax, int W, int H) {
+  BBox b = { std::max(1, xmin), std::min(W, xmax), std::max(1, ymin), std::min(H, ymax) };
+  return b;
 }
 
 // ---- 1) Composite one dot into a bbox (alpha-over) ----
@@ -35,62 +68,10 @@ NumericVector composite_dot_bbox_cpp(NumericVector canvas,
                                      NumericVector col,
                                      int xmin, int xmax,
                                      int ymin, int ymax) {
+  if (canvas.length() < H * W * 3) stop("canvas must have length H*W*3");
   // Work directly on 'canvas' (R copies if NAMED>1)
-  const double r = radius;
-  const double r2 = r * r;
-  const double cr = col[0], cg = col[1], cb = col[2];
-
-  for(int y0 = ymin; y0 <= ymax; ++y0) {
-    const double py = (double)y0 - 0.5;
-    const int y_idx = y0 - 1;
-    
-    for(int x0 = xmin; x0 <= xmax; ++x0) {
-      const double px = (double)x0 - 0.5;
-      const int x_idx = x0 - 1;
-
-      // Bounds checking to prevent segmentation faults
-      if (y_idx < 0 || y_idx >= H || x_idx < 0 || x_idx >= W) continue;
-
-      // Calculate distance from dot center
-      const double dx = px - x;
-      const double dy = py - y;
-      const double d2 = dx*dx + dy*dy;
-
-      // Check if pixel is within dot radius
-      if (d2 > r2) continue;
-
-      // Calculate coverage based on distance (soft edges)
-      double coverage = 1.0;
-      if (d2 > (r - 1.0) * (r - 1.0)) {
-        // Soft edge for anti-aliasing
-        coverage = 1.0 - std::sqrt(d2) / r;
-        if (coverage < 0.0) coverage = 0.0;
-      }
-
-      if (coverage <= 0.0 || alpha <= 0.0) continue;
-
-      const double a = clamp01(coverage * alpha);
-
-      const int i0 = idx3(y_idx, x_idx, 0, H, W);
-      const int i1 = idx3(y_idx, x_idx, 1, H, W);
-      const int i2 = idx3(y_idx, x_idx, 2, H, W);
-
-      // Additional bounds checking for array indices
-      if (i0 < 0 || i0 >= canvas.length() || 
-          i1 < 0 || i1 >= canvas.length() || 
-          i2 < 0 || i2 >= canvas.length()) continue;
-
-      const double inR = canvas[i0];
-      const double inG = canvas[i1];
-      const double inB = canvas[i2];
-
-      // Alpha compositing: out = in + a * (col - in)
-      canvas[i0] = inR + a * (cr - inR);
-      canvas[i1] = inG + a * (cg - inG);
-      canvas[i2] = inB + a * (cb - inB);
-    }
-  }
-  
+  DotParams d = { x, y, radius, alpha, { col[0], col[1], col[2] } };
+  composite<DotPolicy>(canvas.begin(), H, W, d, clamp_bbox(xmin, xmax, ymin, ymax, W, H));
   return canvas;
 }
 
@@ -99,168 +80,56 @@ NumericVector composite_dot_bbox_cpp(NumericVector canvas,
 double sse_bbox_dots_cpp(NumericVector target, NumericVector canvas,
                           int H, int W,
                           int xmin, int xmax, int ymin, int ymax) {
-  double sse = 0.0;
-  
-  for(int y = ymin; y <= ymax; ++y) {
-    const int y_idx = y - 1;
-    for(int x = xmin; x <= xmax; ++x) {
-      const int x_idx = x - 1;
-      
-      // Bounds checking
-      if (y_idx < 0 || y_idx >= H || x_idx < 0 || x_idx >= W) continue;
-      
-      for(int c = 0; c < 3; ++c) {
-        const int idx = idx3(y_idx, x_idx, c, H, W);
-        if (idx < 0 || idx >= target.length() || idx >= canvas.length()) continue;
-        
-        const double diff = target[idx] - canvas[idx];
-        sse += diff * diff;
-      }
-    }
+  if (target.length() < H * W * 3 || canvas.length() < H * W * 3) {
+    stop("target and canvas must have length H*W*3");
   }
-  
-  return sse;
+  return sse_bbox_raw(target.begin(), canvas.begin(), H, W,
+                      clamp_bbox(xmin, xmax, ymin, ymax, W, H));
 }
 
 // ---- 3) Compute bounding box for a dot ----
 // [[Rcpp::export]]
 List dot_bbox_cpp(double x, double y, double radius, int W, int H) {
-  int xmin = std::max(1, (int)std::floor(x - radius));
-  int xmax = std::min(W, (int)std::ceil(x + radius));
-  int ymin = std::max(1, (int)std::floor(y - radius));
-  int ymax = std::min(H, (int)std::ceil(y + radius));
-  
+  DotParams d = { x, y, radius, 0.0, { 0.0, 0.0, 0.0 } };
+  BBox b = DotPolicy::footprint(d, W, H);
+
   return List::create(
-    Named("xmin") = xmin,
-    Named("xmax") = xmax,
-    Named("ymin") = ymin,
-    Named("ymax") = ymax
+    Named("xmin") = b.xmin,
+    Named("xmax") = b.xmax,
+    Named("ymin") = b.ymin,
+    Named("ymax") = b.ymax
   );
 }
 
 // ---- 4) Sample dot from prior ----
 // [[Rcpp::export]]
 List sample_dot_prior_cpp(int W, int H) {
-  // Use R's random number generator
-  double x = R::runif(1.0, W);
-  double y = R::runif(1.0, H);
-  double radius = std::abs(R::rnorm(0.0, 2.0)) + 1.0;  // 1-6 pixels typical
-  double alpha = R::rbeta(2.0, 2.0);  // Beta distribution for alpha
-  NumericVector col(3);
-  col[0] = R::runif(0.0, 1.0);  // R
-  col[1] = R::runif(0.0, 1.0);  // G
-  col[2] = R::runif(0.0, 1.0);  // B
-  
-  return List::create(
-    Named("x") = x, Named("y") = y,
-    Named("radius") = radius, Named("alpha") = alpha,
-    Named("col") = col
-  );
+  RRng r;
+  NativeRng rng(draw_seed(r));  // seeded from R's stream, see rng.h
+  return dot_to_list(DotPolicy::sample_prior(W, H, rng));
 }
 
 // ---- 5) Jitter dot proposal ----
 // [[Rcpp::export]]
-List jitter_dot_cpp(List dot, int W, int H, 
-                    double s_xy = 3.0, double s_r = 1.0, 
+List jitter_dot_cpp(List dot, int W, int H,
+                    double s_xy = 3.0, double s_r = 1.0,
                     double s_a = 0.1, double s_c = 0.08) {
-  List d2 = clone(dot);
-  
-  d2["x"] = std::max(1.0, std::min((double)W, as<double>(dot["x"]) + R::rnorm(0.0, s_xy)));
-  d2["y"] = std::max(1.0, std::min((double)H, as<double>(dot["y"]) + R::rnorm(0.0, s_xy)));
-  d2["radius"] = std::max(1.0, as<double>(dot["radius"]) + R::rnorm(0.0, s_r));
-  d2["alpha"] = std::min(0.999, std::max(0.001, as<double>(dot["alpha"]) + R::rnorm(0.0, s_a)));
-  
-  NumericVector col = as<NumericVector>(dot["col"]);
-  NumericVector new_col(3);
-  for (int i = 0; i < 3; i++) {
-    new_col[i] = std::min(1.0, std::max(0.0, col[i] + R::rnorm(0.0, s_c)));
-  }
-  d2["col"] = new_col;
-  
-  return d2;
+  JitterScales s = { s_xy, s_r, s_a, s_c };
+  RRng r;
+  NativeRng rng(draw_seed(r));  // seeded from R's stream, see rng.h
+  return dot_to_list(DotPolicy::jitter(dot_from_list(dot), W, H, s, rng));
 }
 
 // ---- 6) Data-driven dot birth proposal ----
 // [[Rcpp::export]]
-List sample_dot_birth_datadriven_cpp(NumericVector target, NumericVector canvas, 
+List sample_dot_birth_datadriven_cpp(NumericVector target, NumericVector canvas,
                                      int H, int W) {
-  // Calculate residual magnitude per pixel
-  NumericVector E = target - canvas;
-  NumericVector mag_sq(H * W);
-  
-  for (int i = 0; i < H * W; i++) {
-    double sum = 0.0;
-    for (int c = 0; c < 3; c++) {
-      double diff = E[i + c * H * W];
-      sum += diff * diff;
-    }
-    mag_sq[i] = std::sqrt(sum);
-  }
-  
-  // Find max magnitude for normalization
-  double max_mag = 0.0;
-  for (int i = 0; i < H * W; i++) {
-    if (mag_sq[i] > max_mag) max_mag = mag_sq[i];
-  }
-  
-  // Normalize and sample seed pixel
-  double x0, y0;
-  if (max_mag < 1e-6) {
-    // Fallback to uniform if no residual
-    x0 = R::runif(1.0, W);
-    y0 = R::runif(1.0, H);
-  } else {
-    // Sample proportional to residual magnitude
-    double total_weight = 0.0;
-    for (int i = 0; i < H * W; i++) {
-      mag_sq[i] /= max_mag;
-      total_weight += mag_sq[i];
-    }
-    
-    double r = R::runif(0.0, total_weight);
-    double cumsum = 0.0;
-    int idx = 0;
-    for (int i = 0; i < H * W; i++) {
-      cumsum += mag_sq[i];
-      if (cumsum >= r) {
-        idx = i;
-        break;
-      }
-    }
-    
-    y0 = (idx % H) + 1;
-    x0 = (idx / H) + 1;
-  }
-  
-  // Sample dot parameters around the seed point
-  double radius = std::abs(R::rnorm(0.0, 1.5)) + 1.0;
-  double alpha = R::rbeta(2.0, 2.0);
-  
-  // Sample color from target image around seed point
-  NumericVector col(3);
-  int x_idx = (int)x0 - 1;
-  int y_idx = (int)y0 - 1;
-  
-  if (x_idx >= 0 && x_idx < W && y_idx >= 0 && y_idx < H) {
-    for (int c = 0; c < 3; c++) {
-      int target_idx = idx3(y_idx, x_idx, c, H, W);
-      if (target_idx >= 0 && target_idx < target.length()) {
-        col[c] = target[target_idx];
-      } else {
-        col[c] = R::runif(0.0, 1.0);
-      }
-    }
-  } else {
-    col[0] = R::runif(0.0, 1.0);
-    col[1] = R::rnorm(0.0, 1.0);
-    col[2] = R::runif(0.0, 1.0);
-  }
-  
-  return List::create(
-    Named("x") = x0, Named("y") = y0,
-    Named("radius") = radius, Named("alpha") = alpha,
-    Named("col") = col
-  );
+  TargetImage t(target.begin(), H, W);
+  ResidualTree residual;
+  residual.build(t, canvas_from_planar(canvas.begin(), H, W));
+  RRng r;
+  NativeRng rng(draw_seed(r));  // seeded from R's stream, see rng.h
+  return dot_to_list(DotPolicy::sample_birth(t, residual, rng));
 }
 
 // ---- 7) Re-render bbox from dots ----
@@ -268,171 +137,230 @@ List sample_dot_birth_datadriven_cpp(NumericVector target, NumericVector canvas,
 NumericVector re_render_bbox_from_dots_cpp(NumericVector canvas, List dots,
                                            int H, int W,
                                            int xmin, int xmax, int ymin, int ymax) {
-  // Start with white canvas in bbox
-  for(int y = ymin; y <= ymax; ++y) {
-    const int y_idx = y - 1;
-    for(int x = xmin; x <= xmax; ++x) {
-      const int x_idx = x - 1;
-      
-      if (y_idx < 0 || y_idx >= H || x_idx < 0 || x_idx >= W) continue;
-      
-      const int i0 = idx3(y_idx, x_idx, 0, H, W);
-      const int i1 = idx3(y_idx, x_idx, 1, H, W);
-      const int i2 = idx3(y_idx, x_idx, 2, H, W);
-      
-      if (i0 < 0 || i0 >= canvas.length() || 
-          i1 < 0 || i1 >= canvas.length() || 
-          i2 < 0 || i2 >= canvas.length()) continue;
-      
-      canvas[i0] = 1.0;  // White background
-      canvas[i1] = 1.0;
-      canvas[i2] = 1.0;
-    }
-  }
-  
-  // Render all dots that intersect the bbox
-  for (int i = 0; i < dots.length(); i++) {
-    List dot = dots[i];
-    double x = as<double>(dot["x"]);
-    double y = as<double>(dot["y"]);
-    double radius = as<double>(dot["radius"]);
-    
-    // Check if dot intersects bbox
-    if (x + radius < xmin || x - radius > xmax || 
-        y + radius < ymin || y - radius > ymax) continue;
-    
-    // Render this dot
-    double alpha = as<double>(dot["alpha"]);
-    NumericVector col = as<NumericVector>(dot["col"]);
-    
-    // Calculate dot's bbox
-    int dot_xmin = std::max(xmin, (int)std::floor(x - radius));
-    int dot_xmax = std::min(xmax, (int)std::ceil(x + radius));
-    int dot_ymin = std::max(ymin, (int)std::floor(y - radius));
-    int dot_ymax = std::min(ymax, (int)std::ceil(y + radius));
-    
-    // Render dot in overlap region
-    for(int y0 = dot_ymin; y0 <= dot_ymax; ++y0) {
-      const double py = (double)y0 - 0.5;
-      const int y_idx = y0 - 1;
-      
-      for(int x0 = dot_xmin; x0 <= dot_xmax; ++x0) {
-        const double px = (double)x0 - 0.5;
-        const int x_idx = x0 - 1;
-
-        if (y_idx < 0 || y_idx >= H || x_idx < 0 || x_idx >= W) continue;
-
-        const double dx = px - x;
-        const double dy = py - y;
-        const double d2 = dx*dx + dy*dy;
-        const double r2 = radius * radius;
-
-        if (d2 > r2) continue;
-
-        double coverage = 1.0;
-        if (d2 > (radius - 1.0) * (radius - 1.0)) {
-          coverage = 1.0 - std::sqrt(d2) / radius;
-          if (coverage < 0.0) coverage = 0.0;
-        }
-
-        if (coverage <= 0.0 || alpha <= 0.0) continue;
-
-        const double a = clamp01(coverage * alpha);
-
-        const int i0 = idx3(y_idx, x_idx, 0, H, W);
-        const int i1 = idx3(y_idx, x_idx, 1, H, W);
-        const int i2 = idx3(y_idx, x_idx, 2, H, W);
-
-        if (i0 < 0 || i0 >= canvas.length() || 
-            i1 < 0 || i1 >= canvas.length() || 
-            i2 < 0 || i2 >= canvas.length()) continue;
-
-        const double inR = canvas[i0];
-        const double inG = canvas[i1];
-        const double inB = canvas[i2];
-
-        // Alpha compositing: out = in + a * (col - in)
-        canvas[i0] = inR + a * (col[0] - inR);
-        canvas[i1] = inG + a * (col[1] - inG);
-        canvas[i2] = inB + a * (col[2] - inB);
-      }
-    }
-  }
-  
+  if (canvas.length() < H * W * 3) stop("canvas must have length H*W*3");
+  re_render_bbox<DotPolicy>(canvas.begin(), dots_from_list(dots),
+                            clamp_bbox(xmin, xmax, ymin, ymax, W, H), H, W);
   return canvas;
 }
 
 // ---- 8) Render full canvas from dots ----
+// Threaded as render_full_canvas_cpp()
 // [[Rcpp::export]]
 NumericVector render_full_canvas_from_dots_cpp(NumericVector canvas, List dots,
-                                               int H, int W) {
-  // Start with white canvas
-  for(int i = 0; i < canvas.length(); i++) {
-    canvas[i] = 1.0;
-  }
-  
-  // Render all dots
-  for (int i = 0; i < dots.length(); i++) {
-    List dot = dots[i];
-    double x = as<double>(dot["x"]);
-    double y = as<double>(dot["y"]);
-    double radius = as<double>(dot["radius"]);
-    double alpha = as<double>(dot["alpha"]);
-    NumericVector col = as<NumericVector>(dot["col"]);
-    
-    // Calculate dot's bbox
-    int xmin = std::max(1, (int)std::floor(x - radius));
-    int xmax = std::min(W, (int)std::ceil(x + radius));
-    int ymin = std::max(1, (int)std::floor(y - radius));
-    int ymax = std::min(H, (int)std::ceil(y + radius));
-    
-    // Render dot
-    for(int y0 = ymin; y0 <= ymax; ++y0) {
-      const double py = (double)y0 - 0.5;
-      const int y_idx = y0 - 1;
-      
-      for(int x0 = xmin; x0 <= xmax; ++x0) {
-        const double px = (double)x0 - 0.5;
-        const int x_idx = x0 - 1;
+                                               int H, int W, int n_threads = 0) {
+  if (canvas.length() < H * W * 3) stop("canvas must have length H*W*3");
+  render_full<DotPolicy>(canvas.begin(), dots_from_list(dots), H, W, n_threads);
+  return canvas;
+}
 
-        if (y_idx < 0 || y_idx >= H || x_idx < 0 || x_idx >= W) continue;
+// Driver result: final state of the cold chain, best state of the best chain
+template <class Sampler>
+List dot_result(const Sampler& cold, const Sampler& best, List tempering, List stats) {
+  return List::create(
+    Named("canvas") = canvas_to_array(cold.canvas()),
+    Named("dots") = dots_to_list(cold.prims()),
+    Named("store") = XPtr<DotStore>(new DotStore(cold.store()), true),
+    Named("best") = List::create(
+      Named("dots") = dots_to_list(best.best_prims()),
+      Named("store") = XPtr<DotStore>(new DotStore(best.best_store()), true),
+      Named("canvas") = canvas_to_array(best.best_canvas()),
+      Named("sse") = best.best_sse(),
+      Named("iter") = best.best_iter()
+    ),
+    Named("tempering") = tempering,
+    Named("stats") = stats,
+    Named("precision") = precision_to_list(cold.target()),
+    Named("loss") = loss_to_list(cold.target().loss()),
+    Named("adapt") = adapt_to_list(cold.prob_moves(), cold.jitter(), cold.adapter())
+  );
+}
+
+// ---- 9) Native RJ-MCMC driver loop ----
+// Runs the dot sampler of rjmcmc_dot_paint() on the generic engine
+// (painter_engine.h): every iteration is a birth or death followed by a
+// jitter of one existing dot. R is only touched for snapshots.
+//
+// target:      [H,W,3] flattened numeric vector
+// on_snapshot: function(canvas, iter, K, beta, sse) called at iter 0 and every
+//              save_every iterations (never called when save_every <= 0)
+// n_chains:    > 1 runs parallel tempering (tempering.h): chain c at
+//              beta * beta_ratio^c, neighbour swaps every swap_every
+//              iterations, chains on n_threads workers (0 = all cores).
+//              The result is the coldest chain's state, best is the lowest
+//              SSE over all chains, and tempering holds the swap counts.
+// tile_size:   > 0 adds a tile-parallel sweep every tile_moves iterations:
+//              tile_moves proposals in each tile_size x tile_size tile at
+//              once, on n_threads workers (see RJSampler::tile_sweep)
+// jitter_tries: > 1 makes each jitter a multiple-try Metropolis move over
+//              that many candidates, scored in one pass against shared layers
+//              (see RJSampler::move_jitter_mtm); tile sweeps still single-try
+// mala_step:   > 0 makes single-try jitters gradient guided (MALA), as in
+//              rjmcmc_line_paint_cpp()
+// adapt_iters: > 0 tunes the jitter scales (and the move mix, where it has
+//              more than births and deaths) during burn-in, as in
+//              rjmcmc_line_paint_cpp(); adapt_target as there
+// snapshot_dir: non-empty writes the snapshots natively as
+//              snapshot_dir/iter_XXXXXX.png on a background thread, at most
+//              snapshot_queue pending (png_writer.h); on_snapshot then gets
+//              NULL for the canvas. All writes finish before returning.
+// trace_file:  non-empty appends every accepted change of the (cold) chain
+//              to this binary trace (trace.h), for replay_dot_trace_cpp()
+// checkpoint_file: non-empty saves the full sampler state there every
+//              checkpoint_every iterations and at the end (checkpoint.h);
+//              resume = true continues from it instead of starting afresh
+//              (init is then ignored), with the same result as an
+//              uninterrupted run. A checkpoint of other sampler settings
+//              (driver_config_hash in painter_driver.h) is refused. A
+//              resumed trace_file is cut back to the checkpoint and
+//              continued, so it still covers the whole run (resume_trace in
+//              trace.h)
+// stats_every: history period of the run statistics returned as stats
+//              (stats.h): move counts and acceptance, section timers, mean
+//              bbox area, throughput, and K / SSE every stats_every
+//              iterations; stats_file streams each history row as CSV, or
+//              JSON lines for a .json / .jsonl name
+// precision:   storage of the target, "float32", "float16" or "uint8"
+//              (target_image.h); SSEs are still accumulated in float /
+//              double, and a full-canvas SSE is within precision$sse_bound
+//              of the SSE against the exact target
+// loss:        "sse", "weighted", "lab" or "multiscale" (loss.h), minimised
+//              in place of the SSE: loss_floor is the weight of edge-free
+//              pixels under "weighted", loss_levels the number of cell
+//              levels (2, 4, ... 2^loss_levels px) under "multiscale", where
+//              tile_size must be a multiple of 2^loss_levels. Every sse
+//              reported is then that loss; loss describes it
+// seed:        native RNG seed; chains and tiles get their own streams, so
+//              a run depends on seed only, not on R's RNG or n_threads
+// init:        optional starting dots (paint order) instead of a blank
+//              canvas, e.g. from a coarser pyramid level
+//
+// [[Rcpp::export]]
+List rjmcmc_dot_paint_cpp(NumericVector target, int H, int W,
+                          int iters,
+                          double beta_init, double beta_final,
+                          double birth_prob,
+                          int save_every,
+                          Function on_snapshot,
+                          bool verbose = true,
+                          int n_chains = 1, double beta_ratio = 0.7,
+                          int swap_every = 100, int n_threads = 0,
+                          int tile_size = 0, int tile_moves = 50,
+                          int jitter_tries = 1, int seed = 42,
+                          Nullable<List> init = R_NilValue,
+                          std::string snapshot_dir = "", int snapshot_queue = 4,
+                          std::string trace_file = "",
+                          std::string checkpoint_file = "", int checkpoint_every = 0,
+                          bool resume = false,
+                          int stats_every = 1000, std::string stats_file = "",
+                          std::string precision = "float32", double mala_step = 0.0,
+                          int adapt_iters = 0, double adapt_target = 0.0,
+                          std::string loss = "sse", double loss_floor = 0.25,
+                          int loss_levels = 3) {
+  if (target.length() != H * W * 3) stop("target must have length H*W*3");
+
+  const DriverOptions o = {
+    iters, beta_init, beta_final, save_every, verbose, n_chains, beta_ratio, swap_every,
+    n_threads, tile_size, tile_moves, jitter_tries, seed, snapshot_dir, snapshot_queue,
+    trace_file, checkpoint_file, checkpoint_every, resume, stats_every, stats_file, precision,
+    mala_step, adapt_iters, adapt_target, loss, loss_floor, loss_levels
+  };
+  SamplerConfig cfg = driver_config(o);
+  cfg.prob_moves[MOVE_BIRTH] = birth_prob;
+  cfg.prob_moves[MOVE_DEATH] = 1.0 - birth_prob;
+  cfg.prob_moves[MOVE_JITTER] = 0.0;
+  cfg.prob_moves[MOVE_SWAP] = 0.0;
+  cfg.K_lambda = 0.0;
+  cfg.datadriven_birth = false;
+  cfg.jitter_every_iter = true;
+  cfg.jitter = DotPolicy::default_jitter();
+  return run_painter<DotPolicy>(target, H, W, cfg, o, on_snapshot, init, TRACE_DOTS,
+                                dots_from_list, dot_result<RJSampler<DotPolicy> >);
+}
 
-        const double dx = px - x;
-        const double dy = py - y;
-        const double d2 = dx*dx + dy*dy;
-        const double r2 = radius * radius;
+// ---- 10) Native SoA dot store (external pointer) ----
+// Same interface as the line store in mcmc_painter_cpp.cpp: 1-based slots,
+// swap-remove, and the R list form only on dot_store_to_list_cpp().
+
+inline unsigned long long dot_store_next_order(const DotStore& s) {
+  unsigned long long o = 0;
+  for (int i = 0; i < s.size(); i++) o = std::max(o, s.order(i) + 1);
+  return o;
+}
 
-        if (d2 > r2) continue;
+inline int dot_store_slot(const DotStore& s, int i) {
+  if (i < 1 || i > s.size()) stop("dot store index out of range");
+  return i - 1;
+}
 
-        double coverage = 1.0;
-        if (d2 > (radius - 1.0) * (radius - 1.0)) {
-          coverage = 1.0 - std::sqrt(d2) / radius;
-          if (coverage < 0.0) coverage = 0.0;
-        }
+// [[Rcpp::export]]
+SEXP dot_store_cpp(List dots) {
+  XPtr<DotStore> store(new DotStore(), true);
+  std::vector<DotParams> v = dots_from_list(dots);
+  store->reserve((int)v.size());
+  for (size_t i = 0; i < v.size(); i++) store->push(v[i], i);
+  return store;
+}
 
-        if (coverage <= 0.0 || alpha <= 0.0) continue;
+// [[Rcpp::export]]
+List dot_store_to_list_cpp(SEXP store) {
+  XPtr<DotStore> s(store);
+  return dots_to_list(s->to_vector());
+}
 
-        const double a = clamp01(coverage * alpha);
+// [[Rcpp::export]]
+int dot_store_size_cpp(SEXP store) {
+  XPtr<DotStore> s(store);
+  return s->size();
+}
 
-        const int i0 = idx3(y_idx, x_idx, 0, H, W);
-        const int i1 = idx3(y_idx, x_idx, 1, H, W);
-        const int i2 = idx3(y_idx, x_idx, 2, H, W);
+// [[Rcpp::export]]
+int dot_store_push_cpp(SEXP store, List dot) {
+  XPtr<DotStore> s(store);
+  return s->push(dot_from_list(dot), dot_store_next_order(*s)) + 1;
+}
 
-        if (i0 < 0 || i0 >= canvas.length() || 
-            i1 < 0 || i1 >= canvas.length() || 
-            i2 < 0 || i2 >= canvas.length()) continue;
+// [[Rcpp::export]]
+void dot_store_set_cpp(SEXP store, int i, List dot) {
+  XPtr<DotStore> s(store);
+  s->set(dot_store_slot(*s, i), dot_from_list(dot));
+}
 
-        const double inR = canvas[i0];
-        const double inG = canvas[i1];
-        const double inB = canvas[i2];
+// [[Rcpp::export]]
+void dot_store_remove_cpp(SEXP store, int i) {
+  XPtr<DotStore> s(store);
+  s->swap_remove(dot_store_slot(*s, i));
+}
 
-        // Alpha compositing: out = in + a * (col - in)
-        canvas[i0] = inR + a * (col[0] - inR);
-        canvas[i1] = inG + a * (col[1] - inG);
-        canvas[i2] = inB + a * (col[2] - inB);
-      }
-    }
-  }
-  
+// [[Rcpp::export]]
+NumericVector render_dot_store_cpp(SEXP store, int H, int W, int n_threads = 0) {
+  XPtr<DotStore> s(store);
+  NumericVector canvas(H * W * 3);
+  render_full<DotPolicy>(canvas.begin(), s->to_vector(), H, W, n_threads);
   return canvas;
 }
+
+// ---- 11) Replay a dot trace ----
+// Same as replay_line_trace_cpp() in mcmc_painter_cpp.cpp, for a trace of
+// rjmcmc_dot_paint_cpp().
+// [[Rcpp::export]]
+int replay_dot_trace_cpp(std::string path, IntegerVector iters, int H, int W,
+                        Function on_frame, int n_threads = 0) {
+  return render_trace<DotPolicy>(path, TRACE_DOTS, as<std::vector<int> >(iters), H, W,
+                          [&](const Canvas& canvas, int iter, int K) {
+    on_frame(canvas_to_array(canvas), iter, K);
+  }, n_threads);
+}
+
+// ---- 12) High-resolution export ----
+// Same as render_lines_png_cpp() in mcmc_painter_cpp.cpp, for dots.
+// [[Rcpp::export]]
+List render_dots_png_cpp(List dots, int H, int W, int out_h, int out_w,
+                         std::string path, int n_threads = 0, int strip_rows = 0) {
+  if (out_h < 1 || out_w < 1) stop("output size must be positive");
+  HiresInfo info;
+  std::string err;
+  if (!render_png<DotPolicy>(dots_from_list(dots), H, W, out_h, out_w, path,
+                             n_threads, strip_rows, info, err))
+    stop(err);
+  return hires_to_list(info, out_h, out_w, path);
+}
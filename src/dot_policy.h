@@ -0,0 +1,185 @@
+// dot_policy.h
+// Dot primitive policy for the RJ-MCMC engine (see painter_engine.h).
+#ifndef MCMCPAINTER_DOT_POLICY_H
+#define MCMCPAINTER_DOT_POLICY_H
+
+#include "canvas.h"
+#include "raster.h"
+#include "residual_tree.h"
+#include "rng.h"
+
+// Native dot parameters; mirrors the R list(x, y, radius, alpha, col)
+struct DotParams {
+  double x, y, radius, alpha;
+  double col[3];
+};
+
+struct DotPolicy {
+  typedef DotParams Params;
+
+  // Scalar fields for the SoA store: x, y, radius, alpha
+  enum { NFIELDS = 4 };
+
+  static void get_fields(const DotParams& d, double* f) {
+    f[0] = d.x; f[1] = d.y; f[2] = d.radius; f[3] = d.alpha;
+  }
+
+  static void set_fields(DotParams& d, const double* f) {
+    d.x = f[0]; d.y = f[1]; d.radius = f[2]; d.alpha = f[3];
+  }
+
+  static BBox footprint(const DotParams& d, int W, int H) {
+    BBox b;
+    b.xmin = std::max(1, (int)std::floor(d.x - d.radius));
+    b.xmax = std::min(W, (int)std::ceil(d.x + d.radius));
+    b.ymin = std::max(1, (int)std::floor(d.y - d.radius));
+    b.ymax = std::min(H, (int)std::ceil(d.y + d.radius));
+    return b;
+  }
+
+  // Nonzero coverage within r of the centre, full within r - 1
+  static CapsuleSpans spans(const DotParams& d) {
+    return CapsuleSpans(d.x, d.y, d.x, d.y, d.radius, d.radius - 1.0);
+  }
+
+  // Disc with a one-pixel soft edge: coverage * alpha for pixels
+  // x0 .. x0+n-1 of row y, written to a[] in whole VF_WIDTH blocks. Blocks
+  // inside the fully covered run solid0 .. solid1 skip the distance.
+  static void coverage_row(const DotParams& d, int y, int x0, int n,
+                           int solid0, int solid1, float* a) {
+    const float r = (float)d.radius;
+    const float r2 = r * r;
+    const float rin = r - 1.0f;
+
+    const vf vr2 = vf_set1(r2), vin2 = vf_set1(rin * rin), vinv_r = vf_set1(1.0f / r);
+    const vf valpha = vf_set1((float)d.alpha);
+    const vf zero = vf_set1(0.0f), one = vf_set1(1.0f);
+    const vf dy = vf_set1((float)y - 0.5f - (float)d.y);
+    const vf dy2 = vf_mul(dy, dy);
+    const vf vsolid = vf_clamp01(valpha);
+
+    for (int i = 0; i < n; i += VF_WIDTH) {
+      if (x0 + i >= solid0 && x0 + i + VF_WIDTH - 1 <= solid1) {
+        vf_storeu(a + i, vsolid);
+        continue;
+      }
+      const vf px = vf_add(vf_set1((float)(x0 + i) - 0.5f), vf_iota());
+      const vf dx = vf_sub(px, vf_set1((float)d.x));
+      const vf d2 = vf_add(vf_mul(dx, dx), dy2);
+
+      // full coverage inside r-1, linear soft edge out to r, none beyond
+      vf cov = vf_max(vf_sub(one, vf_mul(vf_sqrt(d2), vinv_r)), zero);
+      cov = vf_select(vf_le(d2, vin2), one, cov);
+      cov = vf_select(vf_le(d2, vr2), cov, zero);
+      vf_storeu(a + i, vf_clamp01(vf_mul(cov, valpha)));
+    }
+  }
+
+  // Scalar coverage_row() coverage (without alpha) of pixel (y, x) and its
+  // derivatives by x, y and radius in dcov[0..2]; zero on the flat parts
+  static double coverage_grad(const DotParams& d, int y, int x, double* dcov) {
+    for (int f = 0; f < NFIELDS - 1; f++) dcov[f] = 0.0;
+    const double dx = x - 0.5 - d.x, dy = y - 0.5 - d.y;
+    const double d2 = dx*dx + dy*dy, r = d.radius, rin = r - 1.0;
+    if (d2 > r * r) return 0.0;
+    if (d2 <= rin * rin) return 1.0;
+    const double dist = std::sqrt(d2);
+    const double cov = 1.0 - dist / r;
+    if (cov <= 0.0) return 0.0;
+    if (dist > 0.0) {
+      dcov[0] = dx / (dist * r);
+      dcov[1] = dy / (dist * r);
+    }
+    dcov[2] = dist / (r * r);
+    return cov;
+  }
+
+  template <class Rng>
+  static DotParams sample_prior(int W, int H, Rng& rng) {
+    DotParams d;
+    d.x = rng.runif(1.0, W);
+    d.y = rng.runif(1.0, H);
+    d.radius = std::abs(rng.rnorm(0.0, 2.0)) + 1.0;  // 1-6 pixels typical
+    d.alpha = rng.rbeta(2.0, 2.0);  // Beta distribution for alpha
+    for (int c = 0; c < 3; c++) d.col[c] = rng.runif(0.0, 1.0);
+    return d;
+  }
+
+  template <class Rng>
+  static DotParams sample_birth(const TargetImage& target, const ResidualTree& residual,
+                                Rng& rng) {
+    const int H = target.H(), W = target.W();
+    DotParams d;
+    residual.sample(rng, d.x, d.y);
+
+    // Sample dot parameters around the seed point
+    d.radius = std::abs(rng.rnorm(0.0, 1.5)) + 1.0;
+    d.alpha = rng.rbeta(2.0, 2.0);
+
+    // Sample color from target image at the seed pixel
+    const int px = std::min(W, std::max(1, (int)d.x));
+    const int py = std::min(H, std::max(1, (int)d.y));
+    float rgb[3];
+    target.pixel(py, px, rgb);
+    for (int c = 0; c < 3; c++) d.col[c] = rgb[c];
+    return d;
+  }
+
+  template <class Rng>
+  static DotParams jitter(const DotParams& dot, int W, int H, const JitterScales& s,
+                          Rng& rng) {
+    DotParams d2 = dot;
+    d2.x = std::max(1.0, std::min((double)W, dot.x + rng.rnorm(0.0, s.s_xy)));
+    d2.y = std::max(1.0, std::min((double)H, dot.y + rng.rnorm(0.0, s.s_xy)));
+    d2.radius = std::max(1.0, dot.radius + rng.rnorm(0.0, s.s_size));
+    d2.alpha = std::min(0.999, std::max(0.001, dot.alpha + rng.rnorm(0.0, s.s_a)));
+    for (int i = 0; i < 3; i++) {
+      d2.col[i] = std::min(1.0, std::max(0.0, dot.col[i] + rng.rnorm(0.0, s.s_c)));
+    }
+    return d2;
+  }
+
+  // d on a canvas resized by sx, sy to W x H (radius by the mean factor)
+  static DotParams rescale(const DotParams& d, double sx, double sy, int W, int H) {
+    DotParams r = d;
+    r.x = rescale_coord(d.x, sx, W);
+    r.y = rescale_coord(d.y, sy, H);
+    r.radius = d.radius * 0.5 * (sx + sy);
+    return r;
+  }
+
+  static JitterScales default_jitter() {
+    JitterScales s = { 3.0, 1.0, 0.1, 0.08 };
+    return s;
+  }
+
+  // Jitter sd of each field
+  static void jitter_sd(const JitterScales& s, double* sd) {
+    sd[0] = sd[1] = s.s_xy;
+    sd[2] = s.s_size;
+    sd[3] = s.s_a;
+  }
+
+  // Same prior as log_prior_dot() in R/dot_painter.R
+  static double log_prior(const DotParams& d, int W, int H) {
+    if (d.x < 1 || d.x > W || d.y < 1 || d.y > H ||
+        d.radius <= 0 || d.alpha <= 0 || d.alpha >= 1) return R_NegInf;
+    for (int c = 0; c < 3; c++) {
+      if (d.col[c] < 0 || d.col[c] > 1) return R_NegInf;
+    }
+    // radius ~ half-normal(sigma=4), alpha ~ Beta(1.5,1.5)
+    const double sigma_r = 4.0;
+    double lp = -(d.radius * d.radius) / (2.0 * sigma_r * sigma_r);
+    lp += 0.5 * std::log(d.alpha) + 0.5 * std::log(1.0 - d.alpha);
+    return lp;
+  }
+
+  // d log_prior / d field inside the support
+  static void log_prior_grad(const DotParams& d, double* g) {
+    g[0] = g[1] = 0.0;
+    g[2] = -d.radius / 16.0;
+    g[3] = 0.5 / d.alpha - 0.5 / (1.0 - d.alpha);
+  }
+};
+
+#endif
@@ -0,0 +1,109 @@
+// hires_render.h
+// Print-resolution export. The primitives of a painting made on an H x W
+// canvas are rescaled to out_h x out_w and drawn one horizontal strip at a
+// time: the strip's primitives are picked from precomputed footprints, the
+// strip is split into RENDER_BAND row bands across n_threads workers, and
+// its rows are streamed into a PngStream on a second thread while the next
+// strip renders. Memory is two strips (about HIRES_STRIP_BYTES each), the
+// rescaled primitives and their footprints, whatever the output size; every
+// pixel sees its primitives in paint order, as in render_full().
+#ifndef MCMCPAINTER_HIRES_RENDER_H
+#define MCMCPAINTER_HIRES_RENDER_H
+
+#include "painter_engine.h"
+#include "png_writer.h"
+#include <cstdio>
+#include <string>
+#include <thread>
+
+enum { HIRES_STRIP_BYTES = 16 << 20 };
+
+struct HiresInfo {
+  int strip_rows, strips;
+  double strip_bytes;  // both strip buffers
+  double file_bytes;
+};
+
+// Rows per strip: strip_rows rounded down to whole render bands, or
+// (<= 0) as many as fit HIRES_STRIP_BYTES; never more than the image
+inline int hires_strip_rows(int out_h, int out_w, int strip_rows) {
+  if (strip_rows <= 0)
+    strip_rows = (int)std::min((size_t)out_h,
+                               (size_t)HIRES_STRIP_BYTES / ((size_t)out_w * Canvas::CH * sizeof(float)));
+  strip_rows = std::max((int)RENDER_BAND, strip_rows / RENDER_BAND * RENDER_BAND);
+  return std::min(strip_rows, render_bands(out_h) * (int)RENDER_BAND);
+}
+
+// Render prims (on H x W) at out_h x out_w into the PNG at path; false with
+// err set if the file cannot be written (a partial file is removed)
+template <class P>
+inline bool render_png(std::vector<typename P::Params> prims, int H, int W,
+                       int out_h, int out_w, const std::string& path, int n_threads,
+                       int strip_rows, HiresInfo& info, std::string& err) {
+  const double sx = (double)out_w / W, sy = (double)out_h / H;
+  std::vector<BBox> fp(prims.size());
+  for (size_t i = 0; i < prims.size(); i++) {
+    prims[i] = P::rescale(prims[i], sx, sy, out_w, out_h);
+    fp[i] = P::footprint(prims[i], out_w, out_h);
+  }
+  const int rows = hires_strip_rows(out_h, out_w, strip_rows);
+  info.strip_rows = rows;
+  info.strips = (out_h + rows - 1) / rows;
+
+  PngStream png;
+  if (!png.open(path, out_w, out_h)) {
+    err = "cannot open " + path + " for writing";
+    return false;
+  }
+  const bool overlap = worker_count(n_threads, 2) > 1;  // encode while the next strip renders
+  Canvas strip[2];
+  std::vector<int> hits;
+  std::thread encoder;
+  bool ok = true;
+  for (int s = 0; s < info.strips; s++) {
+    const BBox b = { 1, out_w, 1 + s * rows, std::min(out_h, (s + 1) * rows) };
+    Canvas& c = strip[s & 1];
+    c.reset_tile(b);
+    hits.clear();
+    for (size_t i = 0; i < fp.size(); i++)
+      if (!bbox_empty(bbox_intersect(fp[i], b))) hits.push_back((int)i);
+    parallel_for(render_bands(b.ymax - b.ymin + 1), n_threads, [&](int k) {
+      const BBox band = { 1, out_w, b.ymin + k * RENDER_BAND,
+                          std::min(b.ymax, b.ymin + (k + 1) * RENDER_BAND - 1) };
+      c.fill(band, 1.0f);  // white background
+      for (size_t j = 0; j < hits.size(); j++) {
+        const BBox r = bbox_intersect(fp[hits[j]], band);
+        if (!bbox_empty(r)) composite<P>(c, prims[hits[j]], r);
+      }
+    });
+    if (encoder.joinable()) encoder.join();  // strip s - 1 is in the file
+    if (!ok) break;
+    if (overlap) encoder = std::thread([&png, &c, &ok] { ok = png.write_rows(c); });
+    else ok = png.write_rows(c);
+  }
+  if (encoder.joinable()) encoder.join();
+  ok = png.finish() && ok;
+  info.strip_bytes = 2.0 * strip[0].stride() * rows * sizeof(float);
+  info.file_bytes = png.bytes();
+  if (!ok) {
+    std::remove(path.c_str());
+    err = "could not write " + path;
+  }
+  return ok;
+}
+
+// R form of a finished export
+inline Rcpp::List hires_to_list(const HiresInfo& info, int out_h, int out_w,
+                                const std::string& path) {
+  return Rcpp::List::create(
+    Rcpp::Named("path") = path,
+    Rcpp::Named("width") = out_w,
+    Rcpp::Named("height") = out_h,
+    Rcpp::Named("strip_rows") = info.strip_rows,
+    Rcpp::Named("strips") = info.strips,
+    Rcpp::Named("strip_bytes") = info.strip_bytes,
+    Rcpp::Named("file_bytes") = info.file_bytes
+  );
+}
+
+#endif
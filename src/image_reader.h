@@ -0,0 +1,270 @@
+// image_reader.h
+// Native target ingest. decode_png() reads a PNG straight into a
+// SourceImage (row-major interleaved RGB at 8 or 16 bits, alpha dropped as
+// load_image_rgb() always did); other formats arrive as the raw RGB bitmap
+// magick decodes to. resize_box() then area-averages the source onto the
+// output grid and writes the R planar [H, W, 3] layout (see idx3) in one
+// pass, so a target is decoded once and each size (e.g. every pyramid
+// level) costs one resample and no intermediate R arrays.
+#ifndef MCMCPAINTER_IMAGE_READER_H
+#define MCMCPAINTER_IMAGE_READER_H
+
+#include "painter_common.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <zlib.h>
+
+struct SourceImage {
+  int H = 0, W = 0;
+  int depth = 8;               // bits per sample: 8 or 16
+  std::vector<uint8_t> u8;     // depth 8, 3 * W * H samples
+  std::vector<uint16_t> u16;   // depth 16
+
+  size_t bytes() const { return u8.size() + u16.size() * sizeof(uint16_t); }
+};
+
+inline uint32_t png_get_u32(const unsigned char* p) {
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+inline int png_paeth(int a, int b, int c) {
+  const int p = a + b - c;
+  const int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+  return (pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c);
+}
+
+// Undo the row filters of one (sub)image of h rows of `row` bytes, bpp bytes
+// per complete pixel; false on an unknown filter type
+inline bool png_unfilter(unsigned char* data, size_t row, int h, int bpp) {
+  unsigned char* prev = NULL;
+  for (int y = 0; y < h; y++) {
+    unsigned char* f = data + y * (row + 1);
+    unsigned char* r = f + 1;
+    switch (f[0]) {
+    case 0: break;
+    case 1: for (size_t i = bpp; i < row; i++) r[i] += r[i - bpp]; break;
+    case 2: if (prev) for (size_t i = 0; i < row; i++) r[i] += prev[i]; break;
+    case 3:
+      for (size_t i = 0; i < row; i++) {
+        const int a = i >= (size_t)bpp ? r[i - bpp] : 0, b = prev ? prev[i] : 0;
+        r[i] += (unsigned char)((a + b) >> 1);
+      }
+      break;
+    case 4:
+      for (size_t i = 0; i < row; i++) {
+        const int a = i >= (size_t)bpp ? r[i - bpp] : 0, b = prev ? prev[i] : 0;
+        const int c = (prev && i >= (size_t)bpp) ? prev[i - bpp] : 0;
+        r[i] += (unsigned char)png_paeth(a, b, c);
+      }
+      break;
+    default: return false;
+    }
+    prev = r;
+  }
+  return true;
+}
+
+// Decode a PNG of any standard colour type, bit depth and interlace into
+// out; false with a message in err otherwise
+inline bool decode_png(const std::string& path, SourceImage& out, std::string& err) {
+  FILE* fp = std::fopen(path.c_str(), "rb");
+  if (!fp) { err = "cannot open " + path; return false; }
+  std::vector<unsigned char> file;
+  unsigned char buf[1 << 16];
+  size_t n;
+  while ((n = std::fread(buf, 1, sizeof(buf), fp)) > 0) file.insert(file.end(), buf, buf + n);
+  std::fclose(fp);
+
+  static const unsigned char sig[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+  if (file.size() < 8 || std::memcmp(&file[0], sig, 8) != 0) { err = "not a PNG file"; return false; }
+
+  uint32_t W = 0, H = 0;
+  int depth = 0, ctype = -1, interlace = 0;
+  std::vector<unsigned char> palette, idat;
+  for (size_t p = 8; p + 12 <= file.size();) {
+    const uint32_t len = png_get_u32(&file[p]);
+    if (len > file.size() - p - 12) { err = "truncated PNG chunk"; return false; }
+    const unsigned char* type = &file[p + 4];
+    const unsigned char* d = &file[p + 8];
+    if (!std::memcmp(type, "IHDR", 4) && len >= 13) {
+      W = png_get_u32(d);
+      H = png_get_u32(d + 4);
+      depth = d[8];
+      ctype = d[9];
+      interlace = d[12];
+    } else if (!std::memcmp(type, "PLTE", 4)) {
+      palette.assign(d, d + len);
+    } else if (!std::memcmp(type, "IDAT", 4)) {
+      idat.insert(idat.end(), d, d + len);
+    } else if (!std::memcmp(type, "IEND", 4)) {
+      break;
+    }
+    p += 12 + len;
+  }
+
+  static const int channels[7] = { 1, 0, 3, 1, 2, 0, 4 };
+  if (ctype < 0 || ctype > 6 || channels[ctype] == 0 || W == 0 || H == 0 ||
+      W > (1u << 16) || H > (1u << 16)) {
+    err = "unsupported PNG header";
+    return false;
+  }
+  const int nch = channels[ctype];
+  const bool ok_depth = depth == 8 || (depth == 16 && ctype != 3) ||
+                        ((depth == 1 || depth == 2 || depth == 4) && (ctype == 0 || ctype == 3));
+  if (!ok_depth || interlace > 1) { err = "unsupported PNG bit depth or interlace"; return false; }
+  if (ctype == 3 && palette.size() < 3) { err = "PNG palette missing"; return false; }
+  const int bits = nch * depth;                 // per pixel
+  const int bpp = std::max(1, bits / 8);        // filter distance
+
+  // Adam7 passes (one full pass when not interlaced)
+  static const int a7[7][4] = {  // x0, y0, dx, dy
+    { 0, 0, 8, 8 }, { 4, 0, 8, 8 }, { 0, 4, 4, 8 }, { 2, 0, 4, 4 },
+    { 0, 2, 2, 4 }, { 1, 0, 2, 2 }, { 0, 1, 1, 2 } };
+  const int npass = interlace ? 7 : 1;
+  int pw[7], ph[7];
+  size_t prow[7], raw_size = 0;
+  for (int k = 0; k < npass; k++) {
+    const int x0 = interlace ? a7[k][0] : 0, y0 = interlace ? a7[k][1] : 0;
+    const int dx = interlace ? a7[k][2] : 1, dy = interlace ? a7[k][3] : 1;
+    pw[k] = W > (uint32_t)x0 ? (int)((W - x0 + dx - 1) / dx) : 0;
+    ph[k] = H > (uint32_t)y0 ? (int)((H - y0 + dy - 1) / dy) : 0;
+    prow[k] = ((size_t)pw[k] * bits + 7) / 8;
+    if (pw[k] > 0) raw_size += (prow[k] + 1) * ph[k];
+  }
+
+  std::vector<unsigned char> raw(raw_size);
+  z_stream zs;
+  std::memset(&zs, 0, sizeof(zs));
+  if (inflateInit(&zs) != Z_OK) { err = "zlib init failed"; return false; }
+  zs.next_in = idat.empty() ? NULL : &idat[0];
+  zs.avail_in = (uInt)idat.size();
+  zs.next_out = &raw[0];
+  zs.avail_out = (uInt)raw.size();
+  const int zr = inflate(&zs, Z_FINISH);
+  const bool full = zs.avail_out == 0;
+  inflateEnd(&zs);
+  if (!full || (zr != Z_STREAM_END && zr != Z_OK && zr != Z_BUF_ERROR)) {
+    err = "corrupt PNG image data";
+    return false;
+  }
+
+  out.H = (int)H;
+  out.W = (int)W;
+  out.depth = depth == 16 ? 16 : 8;
+  out.u8.clear();
+  out.u16.clear();
+  if (out.depth == 16) out.u16.assign((size_t)W * H * 3, 0);
+  else out.u8.assign((size_t)W * H * 3, 0);
+
+  const int maxv = (1 << depth) - 1;
+  size_t off = 0;
+  for (int k = 0; k < npass; k++) {
+    if (pw[k] == 0) continue;
+    unsigned char* data = &raw[off];
+    off += (prow[k] + 1) * ph[k];
+    if (!png_unfilter(data, prow[k], ph[k], bpp)) { err = "corrupt PNG row filter"; return false; }
+    const int x0 = interlace ? a7[k][0] : 0, y0 = interlace ? a7[k][1] : 0;
+    const int dx = interlace ? a7[k][2] : 1, dy = interlace ? a7[k][3] : 1;
+    for (int j = 0; j < ph[k]; j++) {
+      const unsigned char* r = data + j * (prow[k] + 1) + 1;
+      const size_t y = (size_t)(y0 + j * dy);
+      for (int i = 0; i < pw[k]; i++) {
+        const size_t o = (y * W + x0 + (size_t)i * dx) * 3;
+        if (depth == 16) {
+          const unsigned char* s = r + (size_t)i * nch * 2;
+          const int g = nch <= 2;  // gray (+ alpha)
+          for (int c = 0; c < 3; c++) {
+            const unsigned char* q = s + 2 * (g ? 0 : c);
+            out.u16[o + c] = (uint16_t)((q[0] << 8) | q[1]);
+          }
+        } else if (depth == 8) {
+          const unsigned char* s = r + (size_t)i * nch;
+          if (ctype == 3) {
+            const size_t e = 3 * (size_t)s[0];
+            for (int c = 0; c < 3; c++) out.u8[o + c] = e + 2 < palette.size() ? palette[e + c] : 0;
+          } else {
+            const int g = nch <= 2;
+            for (int c = 0; c < 3; c++) out.u8[o + c] = s[g ? 0 : c];
+          }
+        } else {  // 1, 2 or 4 bit gray or palette index
+          const size_t bit = (size_t)i * depth;
+          const int v = (r[bit >> 3] >> (8 - depth - (int)(bit & 7))) & maxv;
+          if (ctype == 3) {
+            const size_t e = 3 * (size_t)v;
+            for (int c = 0; c < 3; c++) out.u8[o + c] = e + 2 < palette.size() ? palette[e + c] : 0;
+          } else {
+            const uint8_t g8 = (uint8_t)(v * 255 / maxv);
+            out.u8[o] = out.u8[o + 1] = out.u8[o + 2] = g8;
+          }
+        }
+      }
+    }
+  }
+  return true;
+}
+
+// Source pixels of each output pixel along one axis: output i covers the
+// source interval [i n / m, (i + 1) n / m), each source pixel weighted by
+// its overlap. first[i] .. first[i] + count[i] - 1 index weight[] at base[i].
+struct BoxTaps {
+  std::vector<int> first, count, base;
+  std::vector<double> weight;
+
+  BoxTaps(int n, int m) : first(m), count(m), base(m) {
+    const double scale = (double)n / m;
+    for (int i = 0; i < m; i++) {
+      const double a = i * scale, b = (i + 1) * scale;
+      const int s0 = (int)a, s1 = std::min(n - 1, (int)std::ceil(b) - 1);
+      first[i] = s0;
+      count[i] = s1 - s0 + 1;
+      base[i] = (int)weight.size();
+      for (int s = s0; s <= s1; s++)
+        weight.push_back((std::min(b, s + 1.0) - std::max(a, (double)s)) / scale);
+    }
+  }
+};
+
+// Area-average resample of interleaved RGB samples src (H x W, values
+// 0 .. maxv) into the planar [oH, oW, 3] layout of out, scaled to [0, 1]
+template <class T>
+inline void resize_box(const T* src, int H, int W, double maxv, double* out, int oH, int oW) {
+  const BoxTaps tx(W, oW), ty(H, oH);
+  std::vector<double> rows((size_t)H * oW * 3);  // horizontal pass, row-major RGB
+  for (int y = 0; y < H; y++) {
+    const T* s = src + (size_t)y * W * 3;
+    double* r = &rows[(size_t)y * oW * 3];
+    for (int x = 0; x < oW; x++) {
+      double acc[3] = { 0.0, 0.0, 0.0 };
+      const double* w = &tx.weight[tx.base[x]];
+      for (int k = 0; k < tx.count[x]; k++) {
+        const T* p = s + (size_t)(tx.first[x] + k) * 3;
+        acc[0] += w[k] * p[0]; acc[1] += w[k] * p[1]; acc[2] += w[k] * p[2];
+      }
+      for (int c = 0; c < 3; c++) r[(size_t)x * 3 + c] = acc[c];
+    }
+  }
+  const double inv = 1.0 / maxv;
+  std::vector<double> acc((size_t)oW * 3);
+  for (int y = 0; y < oH; y++) {
+    std::fill(acc.begin(), acc.end(), 0.0);
+    const double* w = &ty.weight[ty.base[y]];
+    for (int k = 0; k < ty.count[y]; k++) {
+      const double* r = &rows[(size_t)(ty.first[y] + k) * oW * 3];
+      for (size_t i = 0; i < acc.size(); i++) acc[i] += w[k] * r[i];
+    }
+    for (int x = 0; x < oW; x++)
+      for (int c = 0; c < 3; c++)
+        out[idx3(y + 1, x + 1, c, oH, oW)] = clamp01(acc[(size_t)x * 3 + c] * inv);
+  }
+}
+
+inline void resize_box(const SourceImage& img, double* out, int oH, int oW) {
+  if (img.depth == 16) resize_box(&img.u16[0], img.H, img.W, 65535.0, out, oH, oW);
+  else resize_box(&img.u8[0], img.H, img.W, 255.0, out, oH, oW);
+}
+
+#endif
@@ -0,0 +1,242 @@
+// line_policy.h
+// Line primitive policy for the RJ-MCMC engine (see painter_engine.h).
+#ifndef MCMCPAINTER_LINE_POLICY_H
+#define MCMCPAINTER_LINE_POLICY_H
+
+#include "canvas.h"
+#include "raster.h"
+#include "residual_tree.h"
+#include "rng.h"
+
+// Native line parameters; mirrors the R list(x1, y1, x2, y2, w, alpha, col)
+struct LineParams {
+  double x1, y1, x2, y2, w, alpha;
+  double col[3];
+};
+
+struct LinePolicy {
+  typedef LineParams Params;
+
+  // Scalar fields for the SoA store: x1, y1, x2, y2, w, alpha
+  enum { NFIELDS = 6 };
+
+  static void get_fields(const LineParams& l, double* f) {
+    f[0] = l.x1; f[1] = l.y1; f[2] = l.x2; f[3] = l.y2; f[4] = l.w; f[5] = l.alpha;
+  }
+
+  static void set_fields(LineParams& l, const double* f) {
+    l.x1 = f[0]; l.y1 = f[1]; l.x2 = f[2]; l.y2 = f[3]; l.w = f[4]; l.alpha = f[5];
+  }
+
+  static BBox bbox(const LineParams& l, int W, int H, int pad) {
+    double r = l.w / 2.0 + pad;
+    BBox b;
+    b.xmin = std::max(1, (int)std::floor(std::min(l.x1, l.x2) - r));
+    b.xmax = std::min(W, (int)std::ceil(std::max(l.x1, l.x2) + r));
+    b.ymin = std::max(1, (int)std::floor(std::min(l.y1, l.y2) - r));
+    b.ymax = std::min(H, (int)std::ceil(std::max(l.y1, l.y2) + r));
+    return b;
+  }
+
+  static BBox footprint(const LineParams& l, int W, int H) {
+    return bbox(l, W, H, 2);
+  }
+
+  // Nonzero coverage within w/2 + 1/2 of the segment, full within w/2 - 1/2
+  static CapsuleSpans spans(const LineParams& l) {
+    return CapsuleSpans(l.x1, l.y1, l.x2, l.y2, 0.5 * l.w + 0.5, 0.5 * l.w - 0.5);
+  }
+
+  // Anti-aliased capsule: coverage * alpha for pixels x0 .. x0+n-1 of row y,
+  // written to a[] in whole VF_WIDTH blocks (a needs n rounded up to VF_WIDTH).
+  // Blocks inside the fully covered run solid0 .. solid1 skip the distance.
+  static void coverage_row(const LineParams& l, int y, int x0, int n,
+                           int solid0, int solid1, float* a) {
+    const float x1 = (float)l.x1, y1 = (float)l.y1;
+    const float vx = (float)(l.x2 - l.x1), vy = (float)(l.y2 - l.y1);
+    const float inv_v2 = 1.0f / (vx*vx + vy*vy + 1e-12f);
+
+    const float r   = 0.5f*(float)l.w;
+    const float aa  = 0.5f;
+    const float inr = r - aa;
+    const float outr= r + aa;
+
+    // cov = 1 over [0, inr], linear ramp to 0 at outr; a soft ramp 0..1
+    // over [0, outr] for lines thinner than the AA band
+    const float k  = (inr > 0.0f) ? 1.0f / (outr - inr) : 1.0f / outr;
+    const float c0 = (inr > 0.0f) ? 1.0f + inr * k : 1.0f;
+
+    const vf vvx = vf_set1(vx), vvy = vf_set1(vy), vinv = vf_set1(inv_v2);
+    const vf vc0 = vf_set1(c0), vk = vf_set1(k), valpha = vf_set1((float)l.alpha);
+    const vf dy0 = vf_set1((float)y - 0.5f - y1);
+    const vf ddy = vf_mul(dy0, vvy);
+    const vf zero = vf_set1(0.0f), one = vf_set1(1.0f);
+    const vf vsolid = vf_clamp01(valpha);
+
+    for (int i = 0; i < n; i += VF_WIDTH) {
+      if (x0 + i >= solid0 && x0 + i + VF_WIDTH - 1 <= solid1) {
+        vf_storeu(a + i, vsolid);
+        continue;
+      }
+      const vf px  = vf_add(vf_set1((float)(x0 + i) - 0.5f), vf_iota());
+      const vf dx0 = vf_sub(px, vf_set1(x1));
+      vf t = vf_mul(vf_add(vf_mul(dx0, vvx), ddy), vinv);
+      t = vf_min(vf_max(t, zero), one);
+
+      const vf dx = vf_sub(dx0, vf_mul(t, vvx));
+      const vf dy = vf_sub(dy0, vf_mul(t, vvy));
+      const vf dist = vf_sqrt(vf_add(vf_mul(dx, dx), vf_mul(dy, dy)));
+
+      const vf cov = vf_clamp01(vf_sub(vc0, vf_mul(vk, dist)));
+      vf_storeu(a + i, vf_clamp01(vf_mul(cov, valpha)));
+    }
+  }
+
+  // Scalar coverage_row() coverage (without alpha) of pixel (y, x) and its
+  // derivatives by x1, y1, x2, y2 and w in dcov[0..4]; zero where clamped
+  static double coverage_grad(const LineParams& l, int y, int x, double* dcov) {
+    for (int f = 0; f < NFIELDS - 1; f++) dcov[f] = 0.0;
+    const double vx = l.x2 - l.x1, vy = l.y2 - l.y1;
+    const double dx0 = x - 0.5 - l.x1, dy0 = y - 0.5 - l.y1;
+    const double t = std::min(1.0, std::max(0.0, (dx0 * vx + dy0 * vy) / (vx*vx + vy*vy + 1e-12)));
+    const double dx = dx0 - t * vx, dy = dy0 - t * vy;
+    const double dist = std::sqrt(dx*dx + dy*dy);
+
+    const double r = 0.5 * l.w, inr = r - 0.5, outr = r + 0.5;
+    double cov, dcov_dist, dcov_w;
+    if (inr > 0.0) {
+      cov = outr - dist; dcov_dist = -1.0; dcov_w = 0.5;
+    } else {
+      cov = 1.0 - dist / outr; dcov_dist = -1.0 / outr; dcov_w = 0.5 * dist / (outr * outr);
+    }
+    if (cov <= 0.0) return 0.0;
+    if (cov >= 1.0) return 1.0;
+    if (dist > 0.0) {
+      // the closest point moves with both ends, by 1 - t and t
+      const double ux = dcov_dist * dx / dist, uy = dcov_dist * dy / dist;
+      dcov[0] = -(1.0 - t) * ux; dcov[1] = -(1.0 - t) * uy;
+      dcov[2] = -t * ux;         dcov[3] = -t * uy;
+    }
+    dcov[4] = dcov_w;
+    return cov;
+  }
+
+  template <class Rng>
+  static LineParams sample_prior(int W, int H, Rng& rng) {
+    LineParams l;
+    l.x1 = rng.runif(1.0, W);
+    l.y1 = rng.runif(1.0, H);
+    double ang = rng.runif(0.0, 2.0 * M_PI);
+    double len = std::abs(rng.rnorm(0.0, 30.0)) + 5.0;
+    l.x2 = std::max(1.0, std::min((double)W, l.x1 + len * std::cos(ang)));
+    l.y2 = std::max(1.0, std::min((double)H, l.y1 + len * std::sin(ang)));
+    l.w = std::abs(rng.rnorm(0.0, 3.0)) + 1.0;
+    l.alpha = rng.rbeta(2.0, 2.0);
+    for (int c = 0; c < 3; c++) l.col[c] = rng.runif(0.0, 1.0);
+    return l;
+  }
+
+  template <class Rng>
+  static LineParams sample_birth(const TargetImage& target, const ResidualTree& residual,
+                                 Rng& rng) {
+    const int H = target.H(), W = target.W();
+    double x0, y0;
+    residual.sample(rng, x0, y0);
+
+    // Generate line parameters
+    LineParams l;
+    double ang = rng.runif(0.0, 2.0 * M_PI);
+    double len = std::abs(rng.rnorm(0.0, 35.0)) + 8.0;
+    l.x1 = std::max(1.0, std::min((double)W, x0 - len/2.0 * std::cos(ang)));
+    l.y1 = std::max(1.0, std::min((double)H, y0 - len/2.0 * std::sin(ang)));
+    l.x2 = std::max(1.0, std::min((double)W, x0 + len/2.0 * std::cos(ang)));
+    l.y2 = std::max(1.0, std::min((double)H, y0 + len/2.0 * std::sin(ang)));
+    l.w = std::abs(rng.rnorm(0.0, 3.0)) + 1.0;
+    l.alpha = rng.rbeta(3.0, 3.0);
+
+    // Sample color from target along the line
+    int nprobe = 20;
+    int count = 0;
+    l.col[0] = l.col[1] = l.col[2] = 0.0;
+
+    for (int i = 0; i < nprobe; i++) {
+      double t = (double)i / (nprobe - 1);
+      int px = std::min(W, std::max(1, (int)std::round(l.x1 + t * (l.x2 - l.x1))));
+      int py = std::min(H, std::max(1, (int)std::round(l.y1 + t * (l.y2 - l.y1))));
+
+      float rgb[3];
+      target.pixel(py, px, rgb);
+      for (int c = 0; c < 3; c++) {
+        l.col[c] += rgb[c];
+      }
+      count++;
+    }
+
+    for (int c = 0; c < 3; c++) {
+      l.col[c] /= count;
+    }
+
+    return l;
+  }
+
+  template <class Rng>
+  static LineParams jitter(const LineParams& line, int W, int H, const JitterScales& s,
+                           Rng& rng) {
+    LineParams l2 = line;
+    l2.x1 = std::max(1.0, std::min((double)W, line.x1 + rng.rnorm(0.0, s.s_xy)));
+    l2.y1 = std::max(1.0, std::min((double)H, line.y1 + rng.rnorm(0.0, s.s_xy)));
+    l2.x2 = std::max(1.0, std::min((double)W, line.x2 + rng.rnorm(0.0, s.s_xy)));
+    l2.y2 = std::max(1.0, std::min((double)H, line.y2 + rng.rnorm(0.0, s.s_xy)));
+    l2.w = std::max(0.2, line.w + rng.rnorm(0.0, s.s_size));
+    l2.alpha = std::min(0.999, std::max(0.001, line.alpha + rng.rnorm(0.0, s.s_a)));
+    for (int i = 0; i < 3; i++) {
+      l2.col[i] = std::min(1.0, std::max(0.0, line.col[i] + rng.rnorm(0.0, s.s_c)));
+    }
+    return l2;
+  }
+
+  // l on a canvas resized by sx, sy to W x H (width by the mean factor)
+  static LineParams rescale(const LineParams& l, double sx, double sy, int W, int H) {
+    LineParams r = l;
+    r.x1 = rescale_coord(l.x1, sx, W); r.y1 = rescale_coord(l.y1, sy, H);
+    r.x2 = rescale_coord(l.x2, sx, W); r.y2 = rescale_coord(l.y2, sy, H);
+    r.w = l.w * 0.5 * (sx + sy);
+    return r;
+  }
+
+  static JitterScales default_jitter() {
+    JitterScales s = { 3.0, 0.6, 0.1, 0.08 };
+    return s;
+  }
+
+  // Jitter sd of each field
+  static void jitter_sd(const JitterScales& s, double* sd) {
+    sd[0] = sd[1] = sd[2] = sd[3] = s.s_xy;
+    sd[4] = s.s_size;
+    sd[5] = s.s_a;
+  }
+
+  // Same prior as log_prior_line() in R/utilities.R
+  static double log_prior(const LineParams& l, int W, int H) {
+    if (l.x1 < 1 || l.x1 > W || l.x2 < 1 || l.x2 > W ||
+        l.y1 < 1 || l.y1 > H || l.y2 < 1 || l.y2 > H ||
+        l.w <= 0 || l.alpha <= 0 || l.alpha >= 1) return R_NegInf;
+    for (int c = 0; c < 3; c++) {
+      if (l.col[c] < 0 || l.col[c] > 1) return R_NegInf;
+    }
+    // width ~ half-normal(sigma=3), alpha ~ Beta(2,2)
+    const double sigma_w = 3.0;
+    double lp = -(l.w * l.w) / (2.0 * sigma_w * sigma_w);
+    lp += std::log(l.alpha) + std::log(1.0 - l.alpha);
+    return lp;
+  }
+
+  // d log_prior / d field inside the support
+  static void log_prior_grad(const LineParams& l, double* g) {
+    g[0] = g[1] = g[2] = g[3] = 0.0;
+    g[4] = -l.w / 9.0;
+    g[5] = 1.0 / l.alpha - 1.0 / (1.0 - l.alpha);
+  }
+};
+
+#endif
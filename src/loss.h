@@ -0,0 +1,433 @@
+// loss.h
+// Losses the sampler can minimise in place of the plain RGB SSE. Each one
+// is a sum over pixels (and, for multiscale, over cells), so a move over
+// bbox b still changes it by a delta taken over b alone and the sampler
+// keeps a running total exactly as for the SSE:
+//
+//   sse         sum over RGB of (t - c)^2
+//   weighted    w(y, x) * sum over RGB of (t - c)^2, with w from an edge map
+//               of the target (LossTarget): loss_floor on flat areas, more
+//               along edges, mean 1, so flat backgrounds cost less
+//   lab         squared CIELAB distance scaled by LAB_SCALE, so black to
+//               white costs 3 as in RGB; the conversion is table driven
+//   multiscale  the SSE plus, at cells of 2^s px for s = 1 .. loss_levels,
+//               the cell area times the squared error of the cell means.
+//               The cell terms of a change over b are taken over b grown to
+//               whole cells of the coarsest level (LossTarget::region), so
+//               the canvas a kernel reads must cover that region
+//
+// A loss policy L scores n interleaved RGBA canvas pixels of row y from x,
+// t being the stored target there (decoded as in target_image.h):
+//
+//   static double span(const LossTarget& lt, int y, int x, int n,
+//                      const float* t, const float* c);
+//   static double delta(const LossTarget& lt, int y, int x, int n,
+//                       const float* t, const float* after, const float* before);
+//   enum { CELLS = 0 / 1 };   cell terms on top (CellDelta)
+//
+// The kernels are instantiated per policy and picked once per bbox, so the
+// SSE keeps its fused SIMD paths and the others cost only their own math.
+#ifndef MCMCPAINTER_LOSS_H
+#define MCMCPAINTER_LOSS_H
+
+#include "canvas.h"
+#include <cmath>
+#include <string>
+#include <vector>
+
+enum LossKind { LOSS_SSE = 0, LOSS_WEIGHTED, LOSS_LAB, LOSS_MULTISCALE };
+
+enum {
+  LOSS_MAX_LEVELS = 5,   // coarsest multiscale cell 32 px, one render band
+  LOSS_BLUR = 2,         // box radius spreading the edge map around edges
+  LAB_TABLE = 4096       // steps of the Lab conversion tables on [0, 1]
+};
+static const double LOSS_WEIGHT_MAX = 8.0;  // cap on w before renormalising
+static const float LAB_SCALE = 0.017320508f;  // sqrt(3) / 100
+
+struct LossConfig {
+  int kind;
+  double floor;   // weighted: weight of edge-free pixels, in [0, 1]
+  int levels;     // multiscale: number of cell levels
+  LossConfig() : kind(LOSS_SSE), floor(0.25), levels(3) {}
+};
+
+inline const char* loss_name(int k) {
+  static const char* names[4] = { "sse", "weighted", "lab", "multiscale" };
+  return names[k];
+}
+
+inline LossConfig parse_loss(const std::string& kind, double floor, int levels) {
+  LossConfig c;
+  if (kind == "sse") c.kind = LOSS_SSE;
+  else if (kind == "weighted") c.kind = LOSS_WEIGHTED;
+  else if (kind == "lab") c.kind = LOSS_LAB;
+  else if (kind == "multiscale") c.kind = LOSS_MULTISCALE;
+  else Rcpp::stop("loss must be \"sse\", \"weighted\", \"lab\" or \"multiscale\"");
+  if (!(floor >= 0.0 && floor <= 1.0)) Rcpp::stop("loss_floor must be in [0, 1]");
+  if (levels < 1 || levels > LOSS_MAX_LEVELS) Rcpp::stop("loss_levels must be in 1..5");
+  c.floor = floor;
+  c.levels = levels;
+  return c;
+}
+
+// ---- CIELAB ----
+// sRGB to linear light and CIELAB's f(), as tables on [0, 1] read with
+// linear interpolation. Target and canvas go through the same tables, so the
+// loss is an exact function of the pixel values.
+
+inline const float* lab_table(int which) {
+  static const struct Tables {
+    float lin[LAB_TABLE + 2], f[LAB_TABLE + 2];
+    Tables() {
+      const double e = 216.0 / 24389.0, k = 24389.0 / 27.0;
+      for (int i = 0; i <= LAB_TABLE + 1; i++) {
+        const double v = std::min(1.0, (double)i / LAB_TABLE);
+        lin[i] = (float)(v <= 0.04045 ? v / 12.92 : std::pow((v + 0.055) / 1.055, 2.4));
+        f[i] = (float)(v > e ? std::cbrt(v) : (k * v + 16.0) / 116.0);
+      }
+    }
+  } t;
+  return which == 0 ? t.lin : t.f;
+}
+
+inline float lab_lookup(const float* tab, float v) {
+  v = std::min(1.0f, std::max(0.0f, v)) * LAB_TABLE;
+  const int i = (int)v;
+  return tab[i] + (v - i) * (tab[i + 1] - tab[i]);
+}
+
+// Scaled Lab of an RGB pixel into lab[0..2] (D65 white)
+inline void rgb_to_lab(const float* rgb, float* lab) {
+  const float* lin = lab_table(0);
+  const float* f = lab_table(1);
+  const float r = lab_lookup(lin, rgb[0]), g = lab_lookup(lin, rgb[1]), b = lab_lookup(lin, rgb[2]);
+  const float fx = lab_lookup(f, 0.4339563f * r + 0.3762153f * g + 0.1898430f * b);
+  const float fy = lab_lookup(f, 0.2126729f * r + 0.7151522f * g + 0.0721750f * b);
+  const float fz = lab_lookup(f, 0.0177566f * r + 0.1094682f * g + 0.8727752f * b);
+  lab[0] = (116.0f * LAB_SCALE) * fy - 16.0f * LAB_SCALE;
+  lab[1] = (500.0f * LAB_SCALE) * (fx - fy);
+  lab[2] = (200.0f * LAB_SCALE) * (fy - fz);
+}
+
+// ---- per-target loss data ----
+// What a loss needs besides the stored target: the weight map, the Lab
+// target or the target's cell means per level. Built once per target from
+// the exact planar values and shared like the target.
+class LossTarget {
+public:
+  LossTarget() : kind_(LOSS_SSE), levels_(0), cell_(1), H_(0), W_(0), floor_(0.0) {}
+
+  // From the R planar layout [H, W, 3] (see idx3)
+  LossTarget(const double* a, int H, int W, const LossConfig& cfg)
+    : kind_(cfg.kind), levels_(cfg.kind == LOSS_MULTISCALE ? cfg.levels : 0),
+      cell_(1 << levels_), H_(H), W_(W), floor_(cfg.floor) {
+    if (kind_ == LOSS_WEIGHTED) build_weights(a);
+    if (kind_ == LOSS_LAB) {
+      lab_.resize((size_t)H * W * 3);
+      for (int y = 1; y <= H; y++)
+        for (int x = 1; x <= W; x++) {
+          float rgb[3];
+          for (int c = 0; c < 3; c++) rgb[c] = (float)a[idx3(y, x, c, H, W)];
+          rgb_to_lab(rgb, &lab_[((size_t)(y - 1) * W + (x - 1)) * 3]);
+        }
+    }
+    for (int lv = 1; lv <= levels_; lv++) build_means(a, lv);
+  }
+
+  int kind() const { return kind_; }
+  int levels() const { return levels_; }
+  double floor() const { return floor_; }
+
+  // Edge of the coarsest cell; 1 without cell terms
+  int cell() const { return cell_; }
+
+  // b grown to whole coarsest cells, clipped to the image
+  BBox region(const BBox& b) const {
+    if (cell_ == 1) return b;
+    BBox r = { (b.xmin - 1) / cell_ * cell_ + 1, std::min(W_, ((b.xmax - 1) / cell_ + 1) * cell_),
+               (b.ymin - 1) / cell_ * cell_ + 1, std::min(H_, ((b.ymax - 1) / cell_ + 1) * cell_) };
+    return r;
+  }
+
+  // Weights of pixels x, x+1, ... of row y; NULL unless weighted
+  const float* weights(int y, int x) const {
+    return w_.empty() ? NULL : &w_[(size_t)(y - 1) * W_ + (x - 1)];
+  }
+
+  // Scaled Lab target of pixels x, x+1, ... of row y, packed RGB
+  const float* lab(int y, int x) const { return &lab_[((size_t)(y - 1) * W_ + (x - 1)) * 3]; }
+
+  // Target RGB mean of cell (cy, cx), 0-based, of level lv
+  const double* mean(int lv, int cy, int cx) const {
+    const size_t gw = (W_ + (1 << lv) - 1) >> lv;
+    return &means_[lv - 1][((size_t)cy * gw + cx) * 3];
+  }
+
+  size_t bytes() const {
+    size_t n = w_.size() * sizeof(float) + lab_.size() * sizeof(float);
+    for (size_t k = 0; k < means_.size(); k++) n += means_[k].size() * sizeof(double);
+    return n;
+  }
+
+private:
+  // Sobel magnitude of the luminance, box-blurred by LOSS_BLUR, then
+  // w = floor + (1 - floor) g / mean(g), capped at LOSS_WEIGHT_MAX and
+  // renormalised to mean 1 (all 1 on a flat image)
+  void build_weights(const double* a) {
+    const int H = H_, W = W_;
+    std::vector<double> lum((size_t)H * W), g((size_t)H * W);
+    for (int y = 1; y <= H; y++)
+      for (int x = 1; x <= W; x++)
+        lum[(size_t)(y - 1) * W + (x - 1)] = 0.299 * a[idx3(y, x, 0, H, W)] +
+          0.587 * a[idx3(y, x, 1, H, W)] + 0.114 * a[idx3(y, x, 2, H, W)];
+    auto L = [&](int y, int x) {
+      y = std::max(1, std::min(H, y));
+      x = std::max(1, std::min(W, x));
+      return lum[(size_t)(y - 1) * W + (x - 1)];
+    };
+    for (int y = 1; y <= H; y++)
+      for (int x = 1; x <= W; x++) {
+        const double gx = (L(y - 1, x + 1) + 2 * L(y, x + 1) + L(y + 1, x + 1)) -
+                          (L(y - 1, x - 1) + 2 * L(y, x - 1) + L(y + 1, x - 1));
+        const double gy = (L(y + 1, x - 1) + 2 * L(y + 1, x) + L(y + 1, x + 1)) -
+                          (L(y - 1, x - 1) + 2 * L(y - 1, x) + L(y - 1, x + 1));
+        g[(size_t)(y - 1) * W + (x - 1)] = std::sqrt(gx * gx + gy * gy);
+      }
+    // box blur from an integral image, clipped at the borders
+    std::vector<double> sum((size_t)(H + 1) * (W + 1), 0.0);
+    for (int y = 1; y <= H; y++)
+      for (int x = 1; x <= W; x++)
+        sum[(size_t)y * (W + 1) + x] = g[(size_t)(y - 1) * W + (x - 1)] +
+          sum[(size_t)(y - 1) * (W + 1) + x] + sum[(size_t)y * (W + 1) + x - 1] -
+          sum[(size_t)(y - 1) * (W + 1) + x - 1];
+    double mean = 0.0;
+    for (int y = 1; y <= H; y++)
+      for (int x = 1; x <= W; x++) {
+        const int y0 = std::max(1, y - LOSS_BLUR), y1 = std::min(H, y + LOSS_BLUR);
+        const int x0 = std::max(1, x - LOSS_BLUR), x1 = std::min(W, x + LOSS_BLUR);
+        const double s = sum[(size_t)y1 * (W + 1) + x1] - sum[(size_t)(y0 - 1) * (W + 1) + x1] -
+                         sum[(size_t)y1 * (W + 1) + x0 - 1] + sum[(size_t)(y0 - 1) * (W + 1) + x0 - 1];
+        g[(size_t)(y - 1) * W + (x - 1)] = s / ((double)(y1 - y0 + 1) * (x1 - x0 + 1));
+        mean += g[(size_t)(y - 1) * W + (x - 1)];
+      }
+    mean /= (double)H * W;
+    w_.assign((size_t)H * W, 1.0f);
+    if (!(mean > 1e-12)) return;
+    double wsum = 0.0;
+    std::vector<double> w(g.size());
+    for (size_t i = 0; i < g.size(); i++) {
+      w[i] = std::min(LOSS_WEIGHT_MAX, floor_ + (1.0 - floor_) * g[i] / mean);
+      wsum += w[i];
+    }
+    const double norm = (double)g.size() / wsum;
+    for (size_t i = 0; i < g.size(); i++) w_[i] = (float)(w[i] * norm);
+  }
+
+  void build_means(const double* a, int lv) {
+    const int C = 1 << lv;
+    const int gw = (W_ + C - 1) / C, gh = (H_ + C - 1) / C;
+    std::vector<double> m((size_t)gw * gh * 3, 0.0);
+    for (int y = 1; y <= H_; y++)
+      for (int x = 1; x <= W_; x++)
+        for (int c = 0; c < 3; c++)
+          m[((size_t)((y - 1) / C) * gw + (x - 1) / C) * 3 + c] += a[idx3(y, x, c, H_, W_)];
+    for (int cy = 0; cy < gh; cy++)
+      for (int cx = 0; cx < gw; cx++) {
+        const double area = (double)std::min(C, W_ - cx * C) * std::min(C, H_ - cy * C);
+        for (int c = 0; c < 3; c++) m[((size_t)cy * gw + cx) * 3 + c] /= area;
+      }
+    means_.push_back(m);
+  }
+
+  int kind_, levels_, cell_;
+  int H_, W_;
+  double floor_;
+  std::vector<float> w_;                    // weighted: per pixel, row-major
+  std::vector<float> lab_;                  // lab: scaled Lab target, row-major RGB
+  std::vector<std::vector<double> > means_; // multiscale: cell means per level
+};
+
+// ---- loss policies ----
+
+struct SseLoss {
+  enum { CELLS = 0 };
+  static double span(const LossTarget&, int, int, int n, const float* t, const float* c) {
+    return sse_rgba_span(t, c, n);
+  }
+  static double delta(const LossTarget&, int, int, int n, const float* t,
+                      const float* after, const float* before) {
+    return sse_delta_rgba_span(t, after, before, n);
+  }
+};
+
+struct WeightedLoss {
+  enum { CELLS = 0 };
+  static double span(const LossTarget& lt, int y, int x, int n, const float* t, const float* c) {
+    return sse_rgba_span_w(t, c, lt.weights(y, x), n);
+  }
+  static double delta(const LossTarget& lt, int y, int x, int n, const float* t,
+                      const float* after, const float* before) {
+    return sse_delta_rgba_span_w(t, after, before, lt.weights(y, x), n);
+  }
+};
+
+struct LabLoss {
+  enum { CELLS = 0 };
+  static double span(const LossTarget& lt, int y, int x, int n, const float*, const float* c) {
+    const float* t = lt.lab(y, x);
+    double acc = 0.0;
+    for (int i = 0; i < n; i++, t += 3, c += Canvas::CH) {
+      float v[3];
+      rgb_to_lab(c, v);
+      for (int k = 0; k < 3; k++) {
+        const double d = t[k] - v[k];
+        acc += d * d;
+      }
+    }
+    return acc;
+  }
+  static double delta(const LossTarget& lt, int y, int x, int n, const float*,
+                      const float* after, const float* before) {
+    const float* t = lt.lab(y, x);
+    double acc = 0.0;
+    for (int i = 0; i < n; i++, t += 3, after += Canvas::CH, before += Canvas::CH) {
+      float va[3], vb[3];
+      rgb_to_lab(after, va);
+      rgb_to_lab(before, vb);
+      for (int k = 0; k < 3; k++) {
+        const double da = t[k] - va[k], db = t[k] - vb[k];
+        acc += da * da - db * db;
+      }
+    }
+    return acc;
+  }
+};
+
+struct MultiscaleLoss : SseLoss {
+  enum { CELLS = 1 };
+};
+
+// ---- multiscale cell terms ----
+// add() collects after - before per 2 x 2 cell of region(b) while a kernel
+// walks the changed pixels of b; finish() sums the before canvas over the
+// region's cells and returns the change of the cell terms of every level.
+// Coarser levels are summed from the finer ones, so the cost is one extra
+// read of the region whatever the number of levels.
+class CellDelta {
+public:
+  // Per-thread instance for the kernels
+  static CellDelta& scratch() {
+    static thread_local CellDelta c;
+    return c;
+  }
+
+  void begin(const LossTarget& lt, const BBox& b) {
+    r_ = lt.region(b);
+    w1_ = (r_.xmax - r_.xmin + 2) / 2;
+    h1_ = (r_.ymax - r_.ymin + 2) / 2;
+    d_.assign((size_t)w1_ * h1_ * 3, 0.0);
+  }
+
+  void add(int y, int x, int n, const float* after, const float* before) {
+    double* row = &d_[(size_t)((y - r_.ymin) >> 1) * w1_ * 3];
+    for (int i = 0; i < n; i++, after += Canvas::CH, before += Canvas::CH) {
+      double* d = row + 3 * ((x + i - r_.xmin) >> 1);
+      d[0] += after[0] - before[0];
+      d[1] += after[1] - before[1];
+      d[2] += after[2] - before[2];
+    }
+  }
+
+  // Change of the cell terms; before must cover region(b)
+  double finish(const LossTarget& lt, const Canvas& before) { return terms(lt, before, true); }
+
+  // Cell terms of canvas over the cells of region(b)
+  double total(const LossTarget& lt, const Canvas& canvas, const BBox& b) {
+    begin(lt, b);
+    return terms(lt, canvas, false);
+  }
+
+private:
+  double terms(const LossTarget& lt, const Canvas& canvas, bool delta) {
+    s_.assign(d_.size(), 0.0);
+    for (int y = r_.ymin; y <= r_.ymax; y++) {
+      double* row = &s_[(size_t)((y - r_.ymin) >> 1) * w1_ * 3];
+      const float* p = canvas.px(y, r_.xmin);
+      for (int x = r_.xmin; x <= r_.xmax; x++, p += Canvas::CH) {
+        double* s = row + 3 * ((x - r_.xmin) >> 1);
+        s[0] += p[0];
+        s[1] += p[1];
+        s[2] += p[2];
+      }
+    }
+    double acc = 0.0;
+    int w = w1_, h = h1_;
+    for (int lv = 1; lv <= lt.levels(); lv++) {
+      if (lv > 1) {
+        halve(s_, w, h);
+        if (delta) halve(d_, w, h);
+        w = (w + 1) / 2;
+        h = (h + 1) / 2;
+      }
+      const int C = 1 << lv;
+      const int gx0 = (r_.xmin - 1) / C, gy0 = (r_.ymin - 1) / C;
+      for (int j = 0; j < h; j++)
+        for (int i = 0; i < w; i++) {
+          const size_t k = ((size_t)j * w + i) * 3;
+          const double* d = &d_[k];
+          if (delta && d[0] == 0.0 && d[1] == 0.0 && d[2] == 0.0) continue;
+          const int x0 = r_.xmin + i * C, y0 = r_.ymin + j * C;
+          const double area = (double)std::min(C, r_.xmax - x0 + 1) * std::min(C, r_.ymax - y0 + 1);
+          const double* t = lt.mean(lv, gy0 + j, gx0 + i);
+          for (int c = 0; c < 3; c++) {
+            const double eb = s_[k + c] / area - t[c];
+            if (delta) {
+              const double ea = (s_[k + c] + d[c]) / area - t[c];
+              acc += area * (ea * ea - eb * eb);
+            } else {
+              acc += area * eb * eb;
+            }
+          }
+        }
+    }
+    return acc;
+  }
+
+  // Sum 2 x 2 blocks of a w x h grid of RGB cells in place
+  static void halve(std::vector<double>& v, int w, int h) {
+    const int w2 = (w + 1) / 2, h2 = (h + 1) / 2;
+    for (int j = 0; j < h2; j++)
+      for (int i = 0; i < w2; i++) {
+        double s[3] = { 0.0, 0.0, 0.0 };
+        for (int dj = 0; dj < 2 && 2 * j + dj < h; dj++)
+          for (int di = 0; di < 2 && 2 * i + di < w; di++) {
+            const double* p = &v[((size_t)(2 * j + dj) * w + 2 * i + di) * 3];
+            s[0] += p[0];
+            s[1] += p[1];
+            s[2] += p[2];
+          }
+        double* out = &v[((size_t)j * w2 + i) * 3];
+        out[0] = s[0];
+        out[1] = s[1];
+        out[2] = s[2];
+      }
+  }
+
+  BBox r_;
+  int w1_, h1_;            // level-1 cells over r_
+  std::vector<double> d_;  // after - before per cell
+  std::vector<double> s_;  // before per cell
+};
+
+// R form: the loss, its settings and the bytes of its per-target data
+inline Rcpp::List loss_to_list(const LossTarget& lt) {
+  return Rcpp::List::create(
+    Rcpp::Named("loss") = loss_name(lt.kind()),
+    Rcpp::Named("floor") = lt.kind() == LOSS_WEIGHTED ? lt.floor() : NA_REAL,
+    Rcpp::Named("levels") = lt.levels(),
+    Rcpp::Named("loss_bytes") = (double)lt.bytes()
+  );
+}
+
+#endif
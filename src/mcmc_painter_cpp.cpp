@@ -2,23 +2,54 @@
 #include <Rcpp.h>
 #include <random>
 #include <cmath>
+#include "painter_engine.h"
+#include "painter_driver.h"
+#include "trace.h"
+#include "checkpoint.h"
+#include "image_reader.h"
+#include "hires_render.h"
+#include "line_policy.h"
 using namespace Rcpp;
 
-// ---- helpers ----
-inline double clamp01(double v) {
-  if (v < 0.0) return 0.0;
-  if (v > 1.0) return v;
-  return v;
+inline LineParams line_from_list(List line) {
+  LineParams l;
+  l.x1 = as<double>(line["x1"]);
+  l.y1 = as<double>(line["y1"]);
+  l.x2 = as<double>(line["x2"]);
+  l.y2 = as<double>(line["y2"]);
+  l.w = as<double>(line["w"]);
+  l.alpha = as<double>(line["alpha"]);
+  NumericVector col = as<NumericVector>(line["col"]);
+  for (int c = 0; c < 3; c++) l.col[c] = col[c];
+  return l;
+}
+
+inline List line_to_list(const LineParams& l) {
+  NumericVector col(3);
+  for (int c = 0; c < 3; c++) col[c] = l.col[c];
+  return List::create(
+    Named("x1") = l.x1, Named("y1") = l.y1,
+    Named("x2") = l.x2, Named("y2") = l.y2,
+    Named("w") = l.w, Named("alpha") = l.alpha,
+    Named("col") = col
+  );
+}
+
+inline std::vector<LineParams> lines_from_list(List lines) {
+  std::vector<LineParams> out;
+  out.reserve(lines.length());
+  for (int i = 0; i < lines.length(); i++) out.push_back(line_from_list(lines[i]));
+  return out;
 }
 
-// Linear index for R array [H, W, 3] (column-major)
-inline int idx3(int y, int x, int c, int H, int W) {
-  // y, x are 1-based coming from R/loops; convert to 0-based
-  int y0 = y - 1;
-  int x0 = x - 1;
-  return y0 + x0 * H + c * H * W;
+inline List lines_to_list(const std::vector<LineParams>& lines) {
+  List out(lines.size());
+  for (size_t i = 0; i < lines.size(); i++) out[i] = line_to_list(lines[i]);
+  return out;
 }
 
+typedef PrimitiveStore<LinePolicy> LineStore;
+
 // ---- 1) Composite one line into a bbox (alpha-over) ----
 // canvas: numeric array [H, W, 3] flattened (as.numeric(canvas))
 // col: length-3 numeric (r,g,b) in [0,1]
@@ -35,75 +66,11 @@ NumericVector composite_line_bbox_cpp(NumericVector canvas,
                                       NumericVector col,
                                       int xmin, int xmax,
                                       int ymin, int ymax){
+  if (canvas.length() < H * W * 3) stop("canvas must have length H*W*3");
   // Work directly on 'canvas' (R copies if NAMED>1)
-  double vx = x2 - x1, vy = y2 - y1;
-  double v2 = vx*vx + vy*vy + 1e-12;
-
-  const double r   = 0.5*w;
-  const double aa  = 0.5;
-  const double inr = r - aa;
-  const double outr= r + aa;
-  const double in2 = (inr>0)? inr*inr : 0.0;
-  const double ou2 = outr*outr;
-
-  const double cr = col[0], cg = col[1], cb = col[2];
-
-  for(int y=ymin; y<=ymax; ++y){
-    const double py = (double)y - 0.5;
-    const int y0 = y-1;
-    for(int x=xmin; x<=xmax; ++x){
-      const double px = (double)x - 0.5;
-      const int x0 = x-1;
-
-      // Bounds checking to prevent segmentation faults
-      if (y0 < 0 || y0 >= H || x0 < 0 || x0 >= W) continue;
-
-      double t = ((px-x1)*vx + (py-y1)*vy) / v2;
-      if (t<0.0) t=0.0; else if (t>1.0) t=1.0;
-
-      const double projx = x1 + t*vx;
-      const double projy = y1 + t*vy;
-
-      const double dx = px - projx;
-      const double dy = py - projy;
-      const double d2 = dx*dx + dy*dy;
-
-      double cov = 0.0;
-      if (inr <= 0.0){
-        // soft ramp 0..1 over [0, outr]
-        if (d2 < ou2){
-          cov = 1.0 - std::sqrt(d2) / outr;
-          if (cov < 0.0) cov = 0.0;
-        }
-      } else {
-        if (d2 <= in2) cov = 1.0;
-        else if (d2 >= ou2) cov = 0.0;
-        else {
-          cov = 1.0 - (std::sqrt(d2) - inr) / (outr - inr);
-        }
-      }
-      if (cov<=0.0 || alpha<=0.0) continue;
-
-      const double a = clamp01(cov * alpha);
-
-      const int i0 = idx3(y0,x0,0,H,W);
-      const int i1 = idx3(y0,x0,1,H,W);
-      const int i2 = idx3(y0,x0,2,H,W);
-
-      // Additional bounds checking for array indices
-      if (i0 < 0 || i0 >= canvas.length() || 
-          i1 < 0 || i1 >= canvas.length() || 
-          i2 < 0 || i2 >= canvas.length()) continue;
-
-      const double inR = canvas[i0];
-      const double inG = canvas[i1];
-      const double inB = canvas[i2];
-
-      canvas[i0] = a*cr + (1.0-a)*inR;
-      canvas[i1] = a*cg + (1.0-a)*inG;
-      canvas[i2] = a*cb + (1.0-a)*inB;
-    }
-  }
+  LineParams l = { x1, y1, x2, y2, w, alpha, { col[0], col[1], col[2] } };
+  BBox clip = { xmin, xmax, ymin, ymax };
+  composite<LinePolicy>(canvas.begin(), H, W, l, clip);
   return canvas; // same SEXP, possibly duplicated by R if needed
 }
 
@@ -115,357 +82,384 @@ double sse_bbox_cpp(NumericVector target,
                     int H, int W,
                     int xmin, int xmax,
                     int ymin, int ymax) {
-  double acc = 0.0;
-  for (int y = ymin; y <= ymax; ++y) {
-    for (int x = xmin; x <= xmax; ++x) {
-      int i0 = idx3(y, x, 0, H, W);
-      int i1 = idx3(y, x, 1, H, W);
-      int i2 = idx3(y, x, 2, H, W);
-      double d0 = target[i0] - canvas[i0];
-      double d1 = target[i1] - canvas[i1];
-      double d2 = target[i2] - canvas[i2];
-      acc += d0*d0 + d1*d1 + d2*d2;
-    }
-  }
-  return acc;
+  BBox b = { xmin, xmax, ymin, ymax };
+  return sse_bbox_raw(target.begin(), canvas.begin(), H, W, b);
 }
 
 // ---- 3) Fast bounding box calculation ----
 // [[Rcpp::export]]
-List line_bbox_cpp(double x1, double y1, double x2, double y2, 
+List line_bbox_cpp(double x1, double y1, double x2, double y2,
                    double w, int W, int H, int pad = 2) {
-  double r = w / 2.0 + pad;
-  int xmin = std::max(1, (int)std::floor(std::min(x1, x2) - r));
-  int xmax = std::min(W, (int)std::ceil(std::max(x1, x2) + r));
-  int ymin = std::max(1, (int)std::floor(std::min(y1, y2) - r));
-  int ymax = std::min(H, (int)std::ceil(std::max(y1, y2) + r));
-  
+  LineParams l = { x1, y1, x2, y2, w, 0.0, { 0.0, 0.0, 0.0 } };
+  BBox b = LinePolicy::bbox(l, W, H, pad);
+
   return List::create(
-    Named("xmin") = xmin,
-    Named("xmax") = xmax,
-    Named("ymin") = ymin,
-    Named("ymax") = ymax
+    Named("xmin") = b.xmin,
+    Named("xmax") = b.xmax,
+    Named("ymin") = b.ymin,
+    Named("ymax") = b.ymax
   );
 }
 
 // ---- 4) Fast line proposal generation ----
 // [[Rcpp::export]]
 List sample_line_prior_cpp(int W, int H) {
-  // Use R's random number generator
-  double x1 = R::runif(1.0, W);
-  double y1 = R::runif(1.0, H);
-  double ang = R::runif(0.0, 2.0 * M_PI);
-  double len = std::abs(R::rnorm(0.0, 30.0)) + 5.0;
-  double x2 = std::max(1.0, std::min((double)W, x1 + len * std::cos(ang)));
-  double y2 = std::max(1.0, std::min((double)H, y1 + len * std::sin(ang)));
-  double w = std::abs(R::rnorm(0.0, 3.0)) + 1.0;
-  double alpha = R::rbeta(2.0, 2.0);
-  NumericVector col(3);
-  col[0] = R::runif(0.0, 1.0);
-  col[1] = R::runif(0.0, 1.0);
-  col[2] = R::runif(0.0, 1.0);
-  
-  return List::create(
-    Named("x1") = x1, Named("y1") = y1,
-    Named("x2") = x2, Named("y2") = y2,
-    Named("w") = w, Named("alpha") = alpha,
-    Named("col") = col
-  );
+  RRng r;
+  NativeRng rng(draw_seed(r));  // seeded from R's stream, see rng.h
+  return line_to_list(LinePolicy::sample_prior(W, H, rng));
 }
 
 // ---- 5) Fast jitter proposal ----
 // [[Rcpp::export]]
-List jitter_line_cpp(List line, int W, int H, 
-                     double s_xy = 3.0, double s_w = 0.6, 
+List jitter_line_cpp(List line, int W, int H,
+                     double s_xy = 3.0, double s_w = 0.6,
                      double s_a = 0.1, double s_c = 0.08) {
-  List l2 = clone(line);
-  
-  l2["x1"] = std::max(1.0, std::min((double)W, as<double>(line["x1"]) + R::rnorm(0.0, s_xy)));
-  l2["y1"] = std::max(1.0, std::min((double)H, as<double>(line["y1"]) + R::rnorm(0.0, s_xy)));
-  l2["x2"] = std::max(1.0, std::min((double)W, as<double>(line["x2"]) + R::rnorm(0.0, s_xy)));
-  l2["y2"] = std::max(1.0, std::min((double)H, as<double>(line["y2"]) + R::rnorm(0.0, s_xy)));
-  l2["w"] = std::max(0.2, as<double>(line["w"]) + R::rnorm(0.0, s_w));
-  l2["alpha"] = std::min(0.999, std::max(0.001, as<double>(line["alpha"]) + R::rnorm(0.0, s_a)));
-  
-  NumericVector col = as<NumericVector>(line["col"]);
-  NumericVector new_col(3);
-  for (int i = 0; i < 3; i++) {
-    new_col[i] = std::min(1.0, std::max(0.0, col[i] + R::rnorm(0.0, s_c)));
-  }
-  l2["col"] = new_col;
-  
-  return l2;
+  JitterScales s = { s_xy, s_w, s_a, s_c };
+  RRng r;
+  NativeRng rng(draw_seed(r));  // seeded from R's stream, see rng.h
+  return line_to_list(LinePolicy::jitter(line_from_list(line), W, H, s, rng));
 }
 
 // ---- 6) Fast data-driven birth proposal ----
 // [[Rcpp::export]]
-List sample_line_birth_datadriven_cpp(NumericVector target, NumericVector canvas, 
+List sample_line_birth_datadriven_cpp(NumericVector target, NumericVector canvas,
                                      int H, int W) {
-  // Calculate residual magnitude per pixel
-  NumericVector E = target - canvas;
-  NumericVector mag_sq(H * W);
-  
-  for (int i = 0; i < H * W; i++) {
-    double sum = 0.0;
-    for (int c = 0; c < 3; c++) {
-      double diff = E[i + c * H * W];
-      sum += diff * diff;
-    }
-    mag_sq[i] = std::sqrt(sum);
-  }
-  
-  // Find max magnitude for normalization
-  double max_mag = 0.0;
-  for (int i = 0; i < H * W; i++) {
-    if (mag_sq[i] > max_mag) max_mag = mag_sq[i];
-  }
-  
-  // Normalize and sample seed pixel
-  double x0, y0;
-  if (max_mag < 1e-6) {
-    // Fallback to uniform if no residual
-    x0 = R::runif(1.0, W);
-    y0 = R::runif(1.0, H);
-  } else {
-    // Sample proportional to residual magnitude
-    double total_weight = 0.0;
-    for (int i = 0; i < H * W; i++) {
-      mag_sq[i] /= max_mag;
-      total_weight += mag_sq[i];
-    }
-    
-    double r = R::runif(0.0, total_weight);
-    double cumsum = 0.0;
-    int idx = 0;
-    for (int i = 0; i < H * W; i++) {
-      cumsum += mag_sq[i];
-      if (cumsum >= r) {
-        idx = i;
-        break;
-      }
-    }
-    
-    y0 = (idx % H) + 1;
-    x0 = (idx / H) + 1;
-  }
-  
-  // Generate line parameters
-  double ang = R::runif(0.0, 2.0 * M_PI);
-  double len = std::abs(R::rnorm(0.0, 35.0)) + 8.0;
-  double x1 = std::max(1.0, std::min((double)W, x0 - len/2.0 * std::cos(ang)));
-  double y1 = std::max(1.0, std::min((double)H, y0 - len/2.0 * std::sin(ang)));
-  double x2 = std::max(1.0, std::min((double)W, x0 + len/2.0 * std::cos(ang)));
-  double y2 = std::max(1.0, std::min((double)H, y0 + len/2.0 * std::sin(ang)));
-  double w = std::abs(R::rnorm(0.0, 3.0)) + 1.0;
-  double alpha = R::rbeta(3.0, 3.0);
-  
-  // Sample color from target along the line
-  int nprobe = 20;
-  NumericVector col(3, 0.0);
-  int count = 0;
-  
-  for (int i = 0; i < nprobe; i++) {
-    double t = (double)i / (nprobe - 1);
-    int px = std::min(W, std::max(1, (int)std::round(x1 + t * (x2 - x1))));
-    int py = std::min(H, std::max(1, (int)std::round(y1 + t * (y2 - y1))));
-    
-    if (px >= 1 && px <= W && py >= 1 && py <= H) {
-      for (int c = 0; c < 3; c++) {
-        col[c] += target[idx3(py, px, c, H, W)];
-      }
-      count++;
-    }
-  }
-  
-  if (count > 0) {
-    for (int c = 0; c < 3; c++) {
-      col[c] /= count;
-    }
-  }
-  
-  return List::create(
-    Named("x1") = x1, Named("y1") = y1,
-    Named("x2") = x2, Named("y2") = y2,
-    Named("w") = w, Named("alpha") = alpha,
-    Named("col") = col
-  );
+  TargetImage t(target.begin(), H, W);
+  ResidualTree residual;
+  residual.build(t, canvas_from_planar(canvas.begin(), H, W));
+  RRng r;
+  NativeRng rng(draw_seed(r));  // seeded from R's stream, see rng.h
+  return line_to_list(LinePolicy::sample_birth(t, residual, rng));
 }
 
 // ---- 7) Fast canvas re-rendering in bbox ----
 // [[Rcpp::export]]
-NumericVector re_render_bbox_from_lines_cpp(NumericVector base_canvas, 
-                                           List lines, 
+NumericVector re_render_bbox_from_lines_cpp(NumericVector base_canvas,
+                                           List lines,
                                            int xmin, int xmax, int ymin, int ymax,
                                            int H, int W) {
   NumericVector canvas = clone(base_canvas);
-  
-  // Clear bbox region to white background
-  for (int y = ymin; y <= ymax; y++) {
-    for (int x = xmin; x <= xmax; x++) {
-      for (int c = 0; c < 3; c++) {
-        canvas[idx3(y, x, c, H, W)] = 1.0;  // white background
-      }
-    }
-  }
-  
-  // Draw lines that intersect the bbox
-  int n_lines = lines.length();
-  for (int i = 0; i < n_lines; i++) {
-    List line = lines[i];
-    double x1 = as<double>(line["x1"]);
-    double y1 = as<double>(line["y1"]);
-    double x2 = as<double>(line["x2"]);
-    double y2 = as<double>(line["y2"]);
-    double w = as<double>(line["w"]);
-    
-    // Check if line intersects bbox
-    double r = w / 2.0 + 2.0; // pad
-    double line_xmin = std::min(x1, x2) - r;
-    double line_xmax = std::max(x1, x2) + r;
-    double line_ymin = std::min(y1, y2) - r;
-    double line_ymax = std::max(y1, y2) + r;
-    
-    if (!(line_xmax < xmin || line_xmin > xmax || line_ymax < ymin || line_ymin > ymax)) {
-      // Line intersects bbox, draw it
-      double alpha = as<double>(line["alpha"]);
-      NumericVector col = as<NumericVector>(line["col"]);
-      
-      // Calculate actual bbox overlap
-      int draw_xmin = std::max(xmin, (int)std::floor(line_xmin));
-      int draw_xmax = std::min(xmax, (int)std::ceil(line_xmax));
-      int draw_ymin = std::max(ymin, (int)std::floor(line_ymin));
-      int draw_ymax = std::min(ymax, (int)std::ceil(line_ymax));
-      
-      // Draw line in overlap region
-      double vx = x2 - x1, vy = y2 - y1;
-      double v2 = vx*vx + vy*vy + 1e-12;
-      double r_line = 0.5 * w;
-      double aa = 0.5;
-      double inr = r_line - aa;
-      double outr = r_line + aa;
-      double in2 = (inr > 0) ? inr * inr : 0.0;
-      double ou2 = outr * outr;
-      
-      for (int y = draw_ymin; y <= draw_ymax; y++) {
-        double py = (double)y - 0.5;
-        for (int x = draw_xmin; x <= draw_xmax; x++) {
-          double px = (double)x - 0.5;
-          
-          double t = ((px - x1) * vx + (py - y1) * vy) / v2;
-          if (t < 0.0) t = 0.0; else if (t > 1.0) t = 1.0;
-          
-          double projx = x1 + t * vx;
-          double projy = y1 + t * vy;
-          
-          double dx = px - projx;
-          double dy = py - projy;
-          double d2 = dx * dx + dy * dy;
-          
-          double cov = 0.0;
-          if (inr <= 0.0) {
-            if (d2 < ou2) {
-              cov = 1.0 - std::sqrt(d2) / outr;
-              if (cov < 0.0) cov = 0.0;
-            }
-          } else {
-            if (d2 <= in2) cov = 1.0;
-            else if (d2 >= ou2) cov = 0.0;
-            else {
-              cov = 1.0 - (std::sqrt(d2) - inr) / (outr - inr);
-            }
-          }
-          
-          if (cov > 0.0 && alpha > 0.0) {
-            double a = clamp01(cov * alpha);
-            
-            for (int c = 0; c < 3; c++) {
-              int i = idx3(y, x, c, H, W);
-              double in_val = canvas[i];
-              canvas[i] = a * col[c] + (1.0 - a) * in_val;
-            }
-          }
-        }
-      }
-    }
-  }
-  
+  BBox b = { xmin, xmax, ymin, ymax };
+  re_render_bbox<LinePolicy>(canvas.begin(), lines_from_list(lines), b, H, W);
   return canvas;
 }
 
 // ---- 8) Fast full canvas rendering from lines ----
+// Rendered in row bands on n_threads workers (<= 0: one per core); the
+// result does not depend on n_threads
 // [[Rcpp::export]]
-NumericVector render_full_canvas_cpp(List lines, int H, int W) {
-  NumericVector canvas(H * W * 3, 1.0);  // white background
-  
-  int n_lines = lines.length();
-  for (int i = 0; i < n_lines; i++) {
-    List line = lines[i];
-    double x1 = as<double>(line["x1"]);
-    double y1 = as<double>(line["y1"]);
-    double x2 = as<double>(line["x2"]);
-    double y2 = as<double>(line["y2"]);
-    double w = as<double>(line["w"]);
-    double alpha = as<double>(line["alpha"]);
-    NumericVector col = as<NumericVector>(line["col"]);
-    
-    // Calculate bbox
-    double r = w / 2.0 + 2.0;
-    int xmin = std::max(1, (int)std::floor(std::min(x1, x2) - r));
-    int xmax = std::min(W, (int)std::ceil(std::max(x1, x2) + r));
-    int ymin = std::max(1, (int)std::floor(std::min(y1, y2) - r));
-    int ymax = std::min(H, (int)std::ceil(std::max(y1, y2) + r));
-    
-    // Draw line
-    double vx = x2 - x1, vy = y2 - y1;
-    double v2 = vx * vx + vy * vy + 1e-12;
-    double r_line = 0.5 * w;
-    double aa = 0.5;
-    double inr = r_line - aa;
-    double outr = r_line + aa;
-    double in2 = (inr > 0) ? inr * inr : 0.0;
-    double ou2 = outr * outr;
-    
-    for (int y = ymin; y <= ymax; y++) {
-      double py = (double)y - 0.5;
-      for (int x = xmin; x <= xmax; x++) {
-        double px = (double)x - 0.5;
-        
-        double t = ((px - x1) * vx + (py - y1) * vy) / v2;
-        if (t < 0.0) t = 0.0; else if (t > 1.0) t = 1.0;
-        
-        double projx = x1 + t * vx;
-        double projy = y1 + t * vy;
-        
-        double dx = px - projx;
-        double dy = py - projy;
-        double d2 = dx * dx + dy * dy;
-        
-        double cov = 0.0;
-        if (inr <= 0.0) {
-          if (d2 < ou2) {
-            cov = 1.0 - std::sqrt(d2) / outr;
-            if (cov < 0.0) cov = 0.0;
-          }
-        } else {
-          if (d2 <= in2) cov = 1.0;
-          else if (d2 >= ou2) cov = 0.0;
-          else {
-            cov = 1.0 - (std::sqrt(d2) - inr) / (outr - inr);
-          }
-        }
-        
-        if (cov > 0.0 && alpha > 0.0) {
-          double a = clamp01(cov * alpha);
-          
-          for (int c = 0; c < 3; c++) {
-            int i = idx3(y, x, c, H, W);
-            double in_val = canvas[i];
-            canvas[i] = a * col[c] + (1.0 - a) * in_val;
-          }
-        }
-      }
-    }
-  }
-  
+NumericVector render_full_canvas_cpp(List lines, int H, int W, int n_threads = 0) {
+  NumericVector canvas(H * W * 3);
+  render_full<LinePolicy>(canvas.begin(), lines_from_list(lines), H, W, n_threads);
+  return canvas;
+}
+
+// Driver result: final state of the cold chain, best state of the best chain
+template <class Sampler>
+List line_result(const Sampler& cold, const Sampler& best, List tempering, List stats) {
+  return List::create(
+    Named("canvas") = canvas_to_array(cold.canvas()),
+    Named("lines") = lines_to_list(cold.prims()),
+    Named("store") = XPtr<LineStore>(new LineStore(cold.store()), true),
+    Named("best") = List::create(
+      Named("sse") = best.best_sse(),
+      Named("canvas") = canvas_to_array(best.best_canvas()),
+      Named("lines") = lines_to_list(best.best_prims()),
+      Named("store") = XPtr<LineStore>(new LineStore(best.best_store()), true),
+      Named("iter") = best.best_iter()
+    ),
+    Named("tempering") = tempering,
+    Named("stats") = stats,
+    Named("precision") = precision_to_list(cold.target()),
+    Named("loss") = loss_to_list(cold.target().loss()),
+    Named("adapt") = adapt_to_list(cold.prob_moves(), cold.jitter(), cold.adapter())
+  );
+}
+
+// ---- 9) Native RJ-MCMC driver loop ----
+// Runs the whole birth/death/jitter/swap sampler of rjmcmc_line_paint() on the
+// generic engine (painter_engine.h); R is only touched for snapshots.
+//
+// target:      [H,W,3] flattened numeric vector
+// prob_moves:  c(birth, death, jitter, swap), need not sum to 1
+// on_snapshot: function(canvas, iter, K, beta, sse) called at iter 0 and every
+//              save_every iterations (never called when save_every <= 0)
+// n_chains:    > 1 runs parallel tempering (tempering.h): chain c at
+//              beta * beta_ratio^c, neighbour swaps every swap_every
+//              iterations, chains on n_threads workers (0 = all cores).
+//              The result is the coldest chain's state, best is the lowest
+//              SSE over all chains, and tempering holds the swap counts.
+// tile_size:   > 0 adds a tile-parallel sweep every tile_moves iterations:
+//              tile_moves proposals in each tile_size x tile_size tile at
+//              once, on n_threads workers (see RJSampler::tile_sweep)
+// jitter_tries: > 1 makes each jitter a multiple-try Metropolis move over
+//              that many candidates, scored in one pass against shared layers
+//              (see RJSampler::move_jitter_mtm); tile sweeps still single-try
+// mala_step:   > 0 makes single-try jitters gradient guided (MALA): the SSE
+//              gradient of the jittered primitive is taken in the same layer
+//              pass as its SSE and drifts the proposal, with the Hastings
+//              correction (see RJSampler::move_jitter_mala); the proposal
+//              variance is mala_step times the squared jitter scales
+// adapt_iters: > 0 tunes prob_moves and the jitter scales during the first
+//              adapt_iters iterations (adapt.h): jitter sds towards an
+//              acceptance of adapt_target (<= 0: 0.234, or 0.574 for MALA),
+//              the move mix towards the SSE gained per scored pixel of each
+//              move type; both are frozen afterwards (the sds still narrowing
+//              as 1 / sqrt(beta)) and returned as adapt
+// snapshot_dir: non-empty writes the snapshots natively as
+//              snapshot_dir/iter_XXXXXX.png on a background thread, at most
+//              snapshot_queue pending (png_writer.h); on_snapshot then gets
+//              NULL for the canvas. All writes finish before returning.
+// trace_file:  non-empty appends every accepted change of the (cold) chain
+//              to this binary trace (trace.h), for replay_line_trace_cpp()
+// checkpoint_file: non-empty saves the full sampler state there every
+//              checkpoint_every iterations and at the end (checkpoint.h);
+//              resume = true continues from it instead of starting afresh
+//              (init is then ignored), with the same result as an
+//              uninterrupted run. A checkpoint of other sampler settings
+//              (driver_config_hash in painter_driver.h) is refused. A
+//              resumed trace_file is cut back to the checkpoint and
+//              continued, so it still covers the whole run (resume_trace in
+//              trace.h)
+// stats_every: history period of the run statistics returned as stats
+//              (stats.h): move counts and acceptance, section timers, mean
+//              bbox area, throughput, and K / SSE every stats_every
+//              iterations; stats_file streams each history row as CSV, or
+//              JSON lines for a .json / .jsonl name
+// precision:   storage of the target, "float32", "float16" or "uint8"
+//              (target_image.h); SSEs are still accumulated in float /
+//              double, and a full-canvas SSE is within precision$sse_bound
+//              of the SSE against the exact target
+// loss:        "sse", "weighted", "lab" or "multiscale" (loss.h), minimised
+//              in place of the SSE: loss_floor is the weight of edge-free
+//              pixels under "weighted", loss_levels the number of cell
+//              levels (2, 4, ... 2^loss_levels px) under "multiscale", where
+//              tile_size must be a multiple of 2^loss_levels. Every sse
+//              reported is then that loss; loss describes it
+// seed:        native RNG seed; chains and tiles get their own streams, so
+//              a run depends on seed only, not on R's RNG or n_threads
+// init:        optional starting lines (paint order) instead of a blank
+//              canvas, e.g. from a coarser pyramid level
+//
+// [[Rcpp::export]]
+List rjmcmc_line_paint_cpp(NumericVector target, int H, int W,
+                           int iters,
+                           double beta_init, double beta_final,
+                           NumericVector prob_moves,
+                           double K_lambda,
+                           int save_every,
+                           Function on_snapshot,
+                           bool verbose = true,
+                           int n_chains = 1, double beta_ratio = 0.7,
+                           int swap_every = 100, int n_threads = 0,
+                           int tile_size = 0, int tile_moves = 50,
+                           int jitter_tries = 1, int seed = 42,
+                           Nullable<List> init = R_NilValue,
+                           std::string snapshot_dir = "", int snapshot_queue = 4,
+                           std::string trace_file = "",
+                           std::string checkpoint_file = "", int checkpoint_every = 0,
+                           bool resume = false,
+                           int stats_every = 1000, std::string stats_file = "",
+                           std::string precision = "float32", double mala_step = 0.0,
+                           int adapt_iters = 0, double adapt_target = 0.0,
+                           std::string loss = "sse", double loss_floor = 0.25,
+                           int loss_levels = 3) {
+  if (target.length() != H * W * 3) stop("target must have length H*W*3");
+  if (prob_moves.length() != 4) stop("prob_moves must be c(birth, death, jitter, swap)");
+
+  const DriverOptions o = {
+    iters, beta_init, beta_final, save_every, verbose, n_chains, beta_ratio, swap_every,
+    n_threads, tile_size, tile_moves, jitter_tries, seed, snapshot_dir, snapshot_queue,
+    trace_file, checkpoint_file, checkpoint_every, resume, stats_every, stats_file, precision,
+    mala_step, adapt_iters, adapt_target, loss, loss_floor, loss_levels
+  };
+  SamplerConfig cfg = driver_config(o);
+  for (int m = 0; m < 4; m++) cfg.prob_moves[m] = prob_moves[m];
+  cfg.K_lambda = K_lambda;
+  cfg.datadriven_birth = true;
+  cfg.jitter_every_iter = false;
+  cfg.jitter = LinePolicy::default_jitter();
+  return run_painter<LinePolicy>(target, H, W, cfg, o, on_snapshot, init, TRACE_LINES,
+                                 lines_from_list, line_result<RJSampler<LinePolicy> >);
+}
+
+// ---- 10) Native SoA line store (external pointer) ----
+// Lines live in contiguous float arrays (see primitive_store.h); the R list
+// form is only built by line_store_to_list_cpp(). Indices are 1-based slots.
+// remove swaps the last slot into i, so slot indices are not stable across
+// removals; paint order is kept separately and is what to_list returns.
+inline unsigned long long line_store_next_order(const LineStore& s) {
+  unsigned long long o = 0;
+  for (int i = 0; i < s.size(); i++) o = std::max(o, s.order(i) + 1);
+  return o;
+}
+
+inline int line_store_slot(const LineStore& s, int i) {
+  if (i < 1 || i > s.size()) stop("line store index out of range");
+  return i - 1;
+}
+
+// [[Rcpp::export]]
+SEXP line_store_cpp(List lines) {
+  XPtr<LineStore> store(new LineStore(), true);
+  std::vector<LineParams> v = lines_from_list(lines);
+  store->reserve((int)v.size());
+  for (size_t i = 0; i < v.size(); i++) store->push(v[i], i);
+  return store;
+}
+
+// [[Rcpp::export]]
+List line_store_to_list_cpp(SEXP store) {
+  XPtr<LineStore> s(store);
+  return lines_to_list(s->to_vector());
+}
+
+// [[Rcpp::export]]
+int line_store_size_cpp(SEXP store) {
+  XPtr<LineStore> s(store);
+  return s->size();
+}
+
+// Append on top of the paint order; returns the new slot
+// [[Rcpp::export]]
+int line_store_push_cpp(SEXP store, List line) {
+  XPtr<LineStore> s(store);
+  return s->push(line_from_list(line), line_store_next_order(*s)) + 1;
+}
+
+// In-place update; paint order is unchanged
+// [[Rcpp::export]]
+void line_store_set_cpp(SEXP store, int i, List line) {
+  XPtr<LineStore> s(store);
+  s->set(line_store_slot(*s, i), line_from_list(line));
+}
+
+// O(1) swap-remove
+// [[Rcpp::export]]
+void line_store_remove_cpp(SEXP store, int i) {
+  XPtr<LineStore> s(store);
+  s->swap_remove(line_store_slot(*s, i));
+}
+
+// [[Rcpp::export]]
+NumericVector render_line_store_cpp(SEXP store, int H, int W, int n_threads = 0) {
+  XPtr<LineStore> s(store);
+  NumericVector canvas(H * W * 3);
+  render_full<LinePolicy>(canvas.begin(), s->to_vector(), H, W, n_threads);
   return canvas;
 }
+
+// ---- 11) Replay a line trace ----
+// Rebuilds the run recorded by rjmcmc_line_paint_cpp(trace_file = ...) and
+// calls on_frame(canvas, iter, K) with the state after each of iters (any
+// order, rendered ascending). H, W <= 0 render at the traced size; any other
+// size rescales the lines first, as scale_primitives() does. Frames render on
+// n_threads workers (<= 0: one per core). Returns the last iteration in the
+// trace.
+// [[Rcpp::export]]
+int replay_line_trace_cpp(std::string path, IntegerVector iters, int H, int W,
+                        Function on_frame, int n_threads = 0) {
+  return render_trace<LinePolicy>(path, TRACE_LINES, as<std::vector<int> >(iters), H, W,
+                          [&](const Canvas& canvas, int iter, int K) {
+    on_frame(canvas_to_array(canvas), iter, K);
+  }, n_threads);
+}
+
+// ---- 12) Trace header ----
+// kind ("lines" or "dots"), traced canvas size, record count and last
+// iteration of a trace written by either driver
+// [[Rcpp::export]]
+List trace_info_cpp(std::string path) {
+  const TraceInfo info = trace_info(path);
+  return List::create(
+    Named("kind") = info.header.kind == TRACE_LINES ? "lines" : "dots",
+    Named("height") = info.header.H,
+    Named("width") = info.header.W,
+    Named("records") = (double)info.records,
+    Named("last_iter") = info.last_iter
+  );
+}
+
+// ---- 13) Native image ingest ----
+// A decoded source image held as an external pointer, so load_image_rgb()
+// decodes a file once and resamples it to each requested size. The list
+// carries the source size and sample depth alongside the pointer.
+inline List source_image_list(XPtr<SourceImage> img) {
+  return List::create(
+    Named("ptr") = img,
+    Named("width") = img->W,
+    Named("height") = img->H,
+    Named("depth") = img->depth,
+    Named("bytes") = (double)img->bytes()
+  );
+}
+
+// [[Rcpp::export]]
+List read_png_cpp(std::string path) {
+  XPtr<SourceImage> img(new SourceImage(), true);
+  std::string err;
+  if (!decode_png(path, *img, err)) stop(err);
+  return source_image_list(img);
+}
+
+// bitmap: 8-bit RGB as magick::image_data(channels = "rgb") returns it,
+// i.e. a raw [3, W, H] array; depth 16 takes the samples of
+// image_bitmap_cpp(), two bytes each in native byte order
+// [[Rcpp::export]]
+List image_from_bitmap_cpp(RawVector bitmap, int W, int H, int depth = 8) {
+  if (depth != 8 && depth != 16) stop("depth must be 8 or 16");
+  const size_t n = (size_t)3 * W * H;
+  if (W < 1 || H < 1 || (size_t)bitmap.length() != n * (depth / 8))
+    stop("bitmap must have length 3*W*H samples");
+  XPtr<SourceImage> img(new SourceImage(), true);
+  img->W = W;
+  img->H = H;
+  img->depth = depth;
+  if (depth == 8) {
+    img->u8.assign(bitmap.begin(), bitmap.end());
+  } else {
+    img->u16.resize(n);
+    std::memcpy(img->u16.data(), &bitmap[0], n * sizeof(uint16_t));
+  }
+  return source_image_list(img);
+}
+
+// The decoded samples as raw bytes, interleaved RGB rows, so an image can
+// be shipped to another process and rebuilt by image_from_bitmap_cpp()
+// without decoding the file again
+// [[Rcpp::export]]
+RawVector image_bitmap_cpp(SEXP image) {
+  XPtr<SourceImage> img(image);
+  RawVector out((R_xlen_t)img->bytes());
+  if (img->depth == 8) std::copy(img->u8.begin(), img->u8.end(), out.begin());
+  else std::memcpy(&out[0], img->u16.data(), img->u16.size() * sizeof(uint16_t));
+  return out;
+}
+
+// Box-filtered [out_h, out_w, 3] array in [0, 1]
+// [[Rcpp::export]]
+NumericVector resize_image_cpp(SEXP image, int out_w, int out_h) {
+  XPtr<SourceImage> img(image);
+  if (out_w < 1 || out_h < 1) stop("output size must be positive");
+  NumericVector out((R_xlen_t)out_h * out_w * 3);
+  resize_box(*img, out.begin(), out_h, out_w);
+  out.attr("dim") = IntegerVector::create(out_h, out_w, 3);
+  return out;
+}
+
+// ---- 14) High-resolution export ----
+// Lines painted on an H x W canvas drawn at out_h x out_w straight into the
+// PNG at path, strip by strip in bounded memory (hires_render.h): n_threads
+// workers (<= 0: one per core), strip_rows rows per strip (<= 0: about 16 MB
+// each). The pixels match render_full_canvas_cpp() of the rescaled lines.
+// [[Rcpp::export]]
+List render_lines_png_cpp(List lines, int H, int W, int out_h, int out_w,
+                          std::string path, int n_threads = 0, int strip_rows = 0) {
+  if (out_h < 1 || out_w < 1) stop("output size must be positive");
+  HiresInfo info;
+  std::string err;
+  if (!render_png<LinePolicy>(lines_from_list(lines), H, W, out_h, out_w, path,
+                              n_threads, strip_rows, info, err))
+    stop(err);
+  return hires_to_list(info, out_h, out_w, path);
+}
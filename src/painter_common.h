@@ -0,0 +1,111 @@
+// painter_common.h
+// Helpers shared by the line and dot painters: R array layout, bboxes, SSE.
+#ifndef MCMCPAINTER_PAINTER_COMMON_H
+#define MCMCPAINTER_PAINTER_COMMON_H
+
+#include <Rcpp.h>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+// ---- helpers ----
+inline double clamp01(double v) {
+  if (v < 0.0) return 0.0;
+  if (v > 1.0) return 1.0;
+  return v;
+}
+
+// Linear index for R array [H, W, 3] (column-major)
+inline int idx3(int y, int x, int c, int H, int W) {
+  // y, x are 1-based coming from R/loops; convert to 0-based
+  int y0 = y - 1;
+  int x0 = x - 1;
+  return y0 + x0 * H + c * H * W;
+}
+
+// Inclusive pixel bbox, 1-based like the R side
+struct BBox {
+  int xmin, xmax, ymin, ymax;
+};
+
+inline bool bbox_empty(const BBox& b) {
+  return b.xmin > b.xmax || b.ymin > b.ymax;
+}
+
+inline BBox bbox_union(const BBox& a, const BBox& b) {
+  BBox u;
+  u.xmin = std::min(a.xmin, b.xmin);
+  u.xmax = std::max(a.xmax, b.xmax);
+  u.ymin = std::min(a.ymin, b.ymin);
+  u.ymax = std::max(a.ymax, b.ymax);
+  return u;
+}
+
+inline BBox bbox_intersect(const BBox& a, const BBox& b) {
+  BBox u;
+  u.xmin = std::max(a.xmin, b.xmin);
+  u.xmax = std::min(a.xmax, b.xmax);
+  u.ymin = std::max(a.ymin, b.ymin);
+  u.ymax = std::min(a.ymax, b.ymax);
+  return u;
+}
+
+// Pixel-centre coordinate v on an n-pixel axis resized by factor s, as
+// scale_primitives() in R/utilities.R: (v - 0.5) * s + 0.5 clamped to [1, n]
+inline double rescale_coord(double v, double s, int n) {
+  return std::min((double)n, std::max(1.0, (v - 0.5) * s + 0.5));
+}
+
+// Jitter standard deviations: position, size (line width / dot radius),
+// alpha and colour
+struct JitterScales {
+  double s_xy, s_size, s_a, s_c;
+};
+
+inline double sse_bbox_raw(const double* target, const double* canvas,
+                           int H, int W, const BBox& b) {
+  double acc = 0.0;
+  for (int y = b.ymin; y <= b.ymax; ++y) {
+    for (int x = b.xmin; x <= b.xmax; ++x) {
+      int i0 = idx3(y, x, 0, H, W);
+      int i1 = idx3(y, x, 1, H, W);
+      int i2 = idx3(y, x, 2, H, W);
+      double d0 = target[i0] - canvas[i0];
+      double d1 = target[i1] - canvas[i1];
+      double d2 = target[i2] - canvas[i2];
+      acc += d0*d0 + d1*d1 + d2*d2;
+    }
+  }
+  return acc;
+}
+
+inline void fill_bbox(double* canvas, int H, int W, const BBox& b, double v) {
+  for (int c = 0; c < 3; c++)
+    for (int x = b.xmin; x <= b.xmax; x++)
+      for (int y = b.ymin; y <= b.ymax; y++)
+        canvas[idx3(y, x, c, H, W)] = v;
+}
+
+// Kahan-compensated running sum, for totals updated by many small deltas
+struct KahanSum {
+  double sum, comp;
+  KahanSum() : sum(0.0), comp(0.0) {}
+  void reset(double v) { sum = v; comp = 0.0; }
+  void add(double x) {
+    const double y = x - comp;
+    const double t = sum + y;
+    comp = (t - sum) - y;
+    sum = t;
+  }
+  double value() const { return sum; }
+};
+
+// Poisson prior on the number of primitives, up to constants;
+// lambda <= 0 means no prior on K
+inline double log_prior_K_raw(int K, double lambda) {
+  if (K < 0) return R_NegInf;
+  if (lambda <= 0.0) return 0.0;
+  return K * std::log(lambda + 1e-12) - lambda - std::lgamma(K + 1.0);
+}
+
+#endif
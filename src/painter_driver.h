@@ -0,0 +1,160 @@
+// painter_driver.h
+// The native driver loop shared by rjmcmc_line_paint_cpp() and
+// rjmcmc_dot_paint_cpp(): snapshots, trace, checkpoints, the stats log and
+// the single-chain or parallel-tempering run, for any primitive policy.
+// The drivers only add their move mix, K prior, jitter scales and R
+// converters.
+#ifndef MCMCPAINTER_PAINTER_DRIVER_H
+#define MCMCPAINTER_PAINTER_DRIVER_H
+
+#include <Rcpp.h>
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+#include "painter_engine.h"
+#include "tempering.h"
+#include "png_writer.h"
+#include "trace.h"
+#include "checkpoint.h"
+#include "stats.h"
+
+// Driver arguments common to both painters, in their R signature order
+// (see rjmcmc_line_paint_cpp() for what each one does)
+struct DriverOptions {
+  int iters;
+  double beta_init, beta_final;
+  int save_every;
+  bool verbose;
+  int n_chains;
+  double beta_ratio;
+  int swap_every, n_threads, tile_size, tile_moves, jitter_tries, seed;
+  std::string snapshot_dir;
+  int snapshot_queue;
+  std::string trace_file, checkpoint_file;
+  int checkpoint_every;
+  bool resume;
+  int stats_every;
+  std::string stats_file, precision;
+  double mala_step;
+  int adapt_iters;
+  double adapt_target;
+  std::string loss;
+  double loss_floor;
+  int loss_levels;
+};
+
+// Sampler config from the common options; the caller fills in prob_moves,
+// K_lambda, datadriven_birth, jitter_every_iter and jitter
+inline SamplerConfig driver_config(const DriverOptions& o) {
+  SamplerConfig cfg;
+  cfg.iters = o.iters;
+  cfg.beta_init = o.beta_init;
+  cfg.beta_final = o.beta_final;
+  cfg.jitter_tries = o.jitter_tries;
+  cfg.sse_check_every = 10000;
+  cfg.save_every = o.save_every;
+  cfg.checkpoint_every = o.checkpoint_file.empty() ? 0 : o.checkpoint_every;
+  cfg.stats_every = o.stats_every;
+  cfg.tile_size = o.tile_size;
+  cfg.tile_moves = o.tile_moves;
+  cfg.n_threads = o.n_threads;
+  cfg.verbose = o.verbose;
+  cfg.precision = parse_precision(o.precision);
+  cfg.mala_step = o.mala_step;
+  cfg.adapt_iters = o.adapt_iters;
+  cfg.adapt_target = o.adapt_target;
+  cfg.loss = parse_loss(o.loss, o.loss_floor, o.loss_levels);
+  return cfg;
+}
+
+// Hash of the settings the chain's path depends on besides the target,
+// precision and loss, so a checkpoint only resumes under the same seed,
+// move mix, K prior, jitter kernel, tile sweeps, MALA, adaptation and
+// tempering ladder. iters and the beta schedule are in the header on their
+// own; n_threads, periods and verbose do not change the path.
+inline uint64_t driver_config_hash(const SamplerConfig& cfg, const DriverOptions& o) {
+  const bool tiles = cfg.tile_size > 0, pt = o.n_chains > 1;
+  const double v[] = {
+    (double)o.seed, cfg.prob_moves[0], cfg.prob_moves[1], cfg.prob_moves[2], cfg.prob_moves[3],
+    cfg.K_lambda, (double)cfg.datadriven_birth, (double)cfg.jitter_every_iter,
+    (double)cfg.jitter_tries, (double)cfg.sse_check_every, cfg.jitter.s_xy, cfg.jitter.s_size,
+    cfg.jitter.s_a, cfg.jitter.s_c, tiles ? (double)cfg.tile_size : 0.0,
+    tiles ? (double)cfg.tile_moves : 0.0, cfg.mala_step, (double)cfg.adapt_iters,
+    cfg.adapt_target, pt ? o.beta_ratio : 0.0, pt ? (double)o.swap_every : 0.0
+  };
+  return checkpoint_hash(v, sizeof(v) / sizeof(v[0]));
+}
+
+// Runs the sampler for P on target ([H,W,3] flattened) and returns
+// make_result(cold, best, tempering, stats). from_list converts init (R
+// list of primitives, paint order); kind tags the trace and checkpoint.
+template <class P, class FromList, class MakeResult>
+Rcpp::List run_painter(const Rcpp::NumericVector& target, int H, int W, const SamplerConfig& cfg,
+                       const DriverOptions& o, Rcpp::Function on_snapshot,
+                       Rcpp::Nullable<Rcpp::List> init, TraceKind kind, FromList from_list,
+                       MakeResult make_result) {
+  std::unique_ptr<SnapshotWriter> writer;  // joined (after draining) on any exit
+  if (!o.snapshot_dir.empty()) writer.reset(new SnapshotWriter(o.snapshot_queue));
+  auto snapshot = [&](const Canvas& canvas, int iter, int K, double beta, double sse) {
+    if (writer) {
+      writer->write(canvas, snapshot_file(o.snapshot_dir, iter));
+      on_snapshot(R_NilValue, iter, K, beta, sse);
+    } else {
+      on_snapshot(canvas_to_array(canvas), iter, K, beta, sse);
+    }
+  };
+  std::unique_ptr<TraceWriter<P> > trace;  // outlives the samplers below
+  const uint64_t target_hash =
+    checkpoint_hash(checkpoint_hash(target.begin(), target.length()), cfg.precision, cfg.loss);
+  Checkpointer ck(o.checkpoint_file, kind, H, W, std::max(1, o.n_chains), P::NFIELDS,
+                  o.iters, o.beta_init, o.beta_final, target_hash, driver_config_hash(cfg, o));
+  if (o.resume && !ck.enabled()) Rcpp::stop("resume needs a checkpoint_file");
+  auto start_trace = [&]() {  // after ck.load(), which sets trace_records()
+    if (!o.trace_file.empty())
+      trace.reset(o.resume ? resume_trace<P>(o.trace_file, kind, H, W, ck.trace_records())
+                           : open_trace<P>(o.trace_file, kind, H, W));
+  };
+  StatsLog stats_log(o.stats_every > 0 ? o.stats_file : "");
+  Rcpp::List tempering;
+  if (o.n_chains <= 1) {
+    RJSampler<P> sampler(target.begin(), H, W, cfg, NativeRng(o.seed));
+    if (o.resume) ck.load(sampler);
+    else if (init.isNotNull()) sampler.init(from_list(init.get()));
+    start_trace();
+    sampler.set_trace(trace.get(), !trace || trace->records() == 0);
+    sampler.set_stats_log(&stats_log);
+    sampler.run(snapshot, [&](int t, double beta) { ck.save(sampler, t, beta, trace_mark(trace.get())); });
+    finish_snapshots(writer.get());
+    if (cfg.checkpoint_every <= 0 || o.iters % cfg.checkpoint_every != 0)
+      ck.save(sampler, sampler.iter(), sampler.beta_at(sampler.iter()), trace_mark(trace.get()));
+    finish_trace(trace.get());
+    stats_log.close();
+    const SamplerStats& st = sampler.stats();
+    return make_result(sampler, sampler, tempering,
+                       stats_to_list(st, st, sampler.iter(), sampler.run_seconds()));
+  }
+  ParallelTempering<P> pt(target.begin(), H, W, cfg, o.n_chains, o.beta_ratio, o.swap_every,
+                          o.n_threads, o.seed);
+  if (o.resume) ck.load(pt);
+  else if (init.isNotNull()) pt.init(from_list(init.get()));
+  start_trace();
+  pt.set_trace(trace.get(), !trace || trace->records() == 0);
+  pt.set_stats_log(&stats_log);
+  pt.run(snapshot, [&](int t, double beta) { ck.save(pt, t, beta, trace_mark(trace.get())); });
+  finish_snapshots(writer.get());
+  if (cfg.checkpoint_every <= 0 || o.iters % cfg.checkpoint_every != 0)
+    ck.save(pt, pt.cold().iter(), pt.cold().beta_at(pt.cold().iter()), trace_mark(trace.get()));
+  finish_trace(trace.get());
+  stats_log.close();
+  tempering = Rcpp::List::create(
+    Rcpp::Named("n_chains") = pt.n_chains(),
+    Rcpp::Named("swaps_proposed") = pt.swaps_proposed(),
+    Rcpp::Named("swaps_accepted") = pt.swaps_accepted()
+  );
+  return make_result(pt.cold(), pt.best(), tempering,
+                     stats_to_list(pt.counters(), pt.history(), pt.cold().iter(),
+                                   pt.run_seconds()));
+}
+
+#endif
@@ -0,0 +1,1510 @@
+// painter_engine.h
+// Generic RJ-MCMC painting engine. The primitive type (line, dot, ...) is a
+// policy; the sampler loop, bbox re-rendering and best tracking live here once.
+// The sampler works on the interleaved float Canvas (canvas.h) against a
+// TargetImage (target_image.h) of the configured precision; the planar
+// double overloads below serve the per-call R exports. "SSE" below stands
+// for the configured loss (loss.h), which the scoring kernels switch on
+// once per bbox.
+//
+// A primitive policy P provides:
+//
+//   typedef ... Params;
+//   enum { NFIELDS = ... };  get_fields() / set_fields()   (see primitive_store.h)
+//   static BBox footprint(const Params& p, int W, int H);
+//       clamped pixel bbox that p can touch
+//   static CapsuleSpans spans(const Params& p);
+//       per-row runs of nonzero and full coverage (see raster.h); the
+//       renderers walk only the nonzero run of each row
+//   static void coverage_row(const Params& p, int y, int x0, int n,
+//                            int solid0, int solid1, float* a);
+//       coverage * alpha in [0,1] for pixels x0 .. x0+n-1 of row y, written in
+//       whole VF_WIDTH blocks (see simd.h); solid0 .. solid1 is the fully
+//       covered run from spans()
+//   template <class Rng> static Params sample_prior(int W, int H, Rng& rng);
+//   template <class Rng>
+//   static Params sample_birth(const TargetImage& target, const ResidualTree& residual, Rng& rng);
+//       data-driven birth proposal, seeded from the residual tree
+//   template <class Rng>
+//   static Params jitter(const Params& p, int W, int H, const JitterScales& s, Rng& rng);
+//   static JitterScales default_jitter();
+//   static double log_prior(const Params& p, int W, int H);
+//   static double coverage_grad(const Params& p, int y, int x, double* dcov);
+//   static void jitter_sd(const JitterScales& s, double* sd);
+//   static void log_prior_grad(const Params& p, double* g);
+//       for the gradient-guided jitter (RJSampler::move_jitter_mala): scalar
+//       coverage of one pixel with its derivatives by the geometric fields
+//       (every field but alpha, which is the last), and the jitter sd and
+//       log prior gradient of each field
+//   static Params rescale(const Params& p, double sx, double sy, int W, int H);
+//       p on the canvas resized by sx, sy to W x H (trace replay)
+//
+// All random draws go through the sampler's own Rng (rng.h), a NativeRng
+// stream by default, so a sampler never touches R's RNG.
+#ifndef MCMCPAINTER_PAINTER_ENGINE_H
+#define MCMCPAINTER_PAINTER_ENGINE_H
+
+#include "painter_common.h"
+#include "canvas.h"
+#include "target_image.h"
+#include "raster.h"
+#include "residual_tree.h"
+#include "spatial_index.h"
+#include "primitive_store.h"
+#include "rng.h"
+#include "parallel.h"
+#include "trace.h"
+#include "stats.h"
+#include "adapt.h"
+#include <functional>
+#include <memory>
+
+// ---- generic rendering ----
+
+// Pixels per coverage_row call; the buffer carries VF_WIDTH slack
+enum { COVERAGE_CHUNK = 256 };
+static_assert((int)COVERAGE_CHUNK <= (int)TARGET_CHUNK, "a coverage chunk must fit one target span");
+
+// Run of row y with nonzero coverage within clip; false if none
+inline bool clipped_span(const CapsuleSpans& spans, int y, const BBox& clip,
+                         int& xmin, int& xmax) {
+  if (!spans.outer(y, xmin, xmax)) return false;
+  xmin = std::max(xmin, clip.xmin);
+  xmax = std::min(xmax, clip.xmax);
+  return xmin <= xmax;
+}
+
+// Alpha-over p into canvas within clip (clip must lie inside the canvas)
+template <class P>
+inline void composite(Canvas& canvas, const typename P::Params& p, const BBox& clip) {
+  float a[COVERAGE_CHUNK + VF_WIDTH];
+  const float col[4] = { (float)p.col[0], (float)p.col[1], (float)p.col[2], 1.0f };
+  const CapsuleSpans spans = P::spans(p);
+  int xmin, xmax, solid0, solid1;
+  for (int y = clip.ymin; y <= clip.ymax; y++) {
+    if (!clipped_span(spans, y, clip, xmin, xmax)) continue;
+    spans.inner(y, solid0, solid1);
+    for (int x = xmin; x <= xmax; x += COVERAGE_CHUNK) {
+      const int n = std::min((int)COVERAGE_CHUNK, xmax - x + 1);
+      P::coverage_row(p, y, x, n, solid0, solid1, a);
+      blend_rgba_row(canvas.px(y, x), a, n, col);
+    }
+  }
+}
+
+// Same blend into a planar R array [H, W, 3]
+template <class P>
+inline void composite(double* canvas, int H, int W, const typename P::Params& p, const BBox& clip) {
+  float a[COVERAGE_CHUNK + VF_WIDTH];
+  BBox b = bbox_intersect(clip, BBox{ 1, W, 1, H });
+  const CapsuleSpans spans = P::spans(p);
+  int xmin, xmax, solid0, solid1;
+  for (int y = b.ymin; y <= b.ymax; y++) {
+    if (!clipped_span(spans, y, b, xmin, xmax)) continue;
+    spans.inner(y, solid0, solid1);
+    for (int x = xmin; x <= xmax; x += COVERAGE_CHUNK) {
+      const int n = std::min((int)COVERAGE_CHUNK, xmax - x + 1);
+      P::coverage_row(p, y, x, n, solid0, solid1, a);
+      for (int i = 0; i < n; i++) {
+        if (a[i] <= 0.0f) continue;
+        for (int c = 0; c < 3; c++) {
+          double& v = canvas[idx3(y, x + i, c, H, W)];
+          v += a[i] * (p.col[c] - v);
+        }
+      }
+    }
+  }
+}
+
+// composite_delta() under loss L: each chunk is blended, then scored
+// against base while it is still in cache
+template <class P, class L>
+inline double composite_delta_loss(Canvas& tile, const Canvas& base, const TargetImage& target,
+                                   const typename P::Params& p, const BBox& b) {
+  float a[COVERAGE_CHUNK + VF_WIDTH];
+  alignas(16) float tbuf[Canvas::CH * COVERAGE_CHUNK];
+  const float col[4] = { (float)p.col[0], (float)p.col[1], (float)p.col[2], 1.0f };
+  const size_t px_bytes = Canvas::CH * sizeof(float);
+  const LossTarget& lt = target.loss();
+  CellDelta& cells = CellDelta::scratch();
+  if (L::CELLS) cells.begin(lt, b);
+  double delta = 0.0;
+  const CapsuleSpans spans = P::spans(p);
+  int xmin, xmax, solid0, solid1;
+  for (int y = b.ymin; y <= b.ymax; y++) {
+    std::memcpy(tile.px(y, b.xmin), base.px(y, b.xmin), (b.xmax - b.xmin + 1) * px_bytes);
+    if (!clipped_span(spans, y, b, xmin, xmax)) continue;
+    spans.inner(y, solid0, solid1);
+    for (int x = xmin; x <= xmax; x += COVERAGE_CHUNK) {
+      const int n = std::min((int)COVERAGE_CHUNK, xmax - x + 1);
+      P::coverage_row(p, y, x, n, solid0, solid1, a);
+      blend_rgba_row(tile.px(y, x), a, n, col);
+      delta += L::delta(lt, y, x, n, target.span(y, x, n, tbuf), tile.px(y, x), base.px(y, x));
+      if (L::CELLS) cells.add(y, x, n, tile.px(y, x), base.px(y, x));
+    }
+  }
+  if (L::CELLS) delta += cells.finish(lt, base);
+  return delta;
+}
+
+// Birth proposal: tile = base with p composited over b, returning the SSE
+// change against target in the same pass. tile must cover b; pixels of b
+// outside p's row spans are copied from base unchanged.
+template <class P>
+inline double composite_delta(Canvas& tile, const Canvas& base, const TargetImage& target,
+                              const typename P::Params& p, const BBox& b) {
+  switch (target.loss().kind()) {
+    case LOSS_WEIGHTED:   return composite_delta_loss<P, WeightedLoss>(tile, base, target, p, b);
+    case LOSS_LAB:        return composite_delta_loss<P, LabLoss>(tile, base, target, p, b);
+    case LOSS_MULTISCALE: return composite_delta_loss<P, MultiscaleLoss>(tile, base, target, p, b);
+  }
+  float a[COVERAGE_CHUNK + VF_WIDTH];
+  alignas(16) float tbuf[Canvas::CH * COVERAGE_CHUNK];  // decoded packed target
+  const float col[4] = { (float)p.col[0], (float)p.col[1], (float)p.col[2], 1.0f };
+  const size_t px_bytes = Canvas::CH * sizeof(float);
+  double delta = 0.0;
+  const CapsuleSpans spans = P::spans(p);
+  int xmin, xmax, solid0, solid1;
+  for (int y = b.ymin; y <= b.ymax; y++) {
+    if (!clipped_span(spans, y, b, xmin, xmax)) {
+      std::memcpy(tile.px(y, b.xmin), base.px(y, b.xmin), (b.xmax - b.xmin + 1) * px_bytes);
+      continue;
+    }
+    if (xmin > b.xmin)
+      std::memcpy(tile.px(y, b.xmin), base.px(y, b.xmin), (xmin - b.xmin) * px_bytes);
+    if (xmax < b.xmax)
+      std::memcpy(tile.px(y, xmax + 1), base.px(y, xmax + 1), (b.xmax - xmax) * px_bytes);
+    spans.inner(y, solid0, solid1);
+    for (int x = xmin; x <= xmax; x += COVERAGE_CHUNK) {
+      const int n = std::min((int)COVERAGE_CHUNK, xmax - x + 1);
+      P::coverage_row(p, y, x, n, solid0, solid1, a);
+      delta += blend_delta_rgba_row(target.span(y, x, n, tbuf), base.px(y, x), tile.px(y, x),
+                                    a, n, col);
+    }
+  }
+  return delta;
+}
+
+// composite_layer_delta() under loss L: each chunk of the inserted pixels
+// is formed in a buffer and scored against without (which must cover
+// region(b) for the multiscale cell terms)
+template <class P, class L>
+inline double composite_layer_delta_loss(const Canvas& under, const Canvas& mult,
+                                         const Canvas& without, const TargetImage& target,
+                                         const typename P::Params& p, const BBox& b) {
+  float a[COVERAGE_CHUNK + VF_WIDTH];
+  alignas(16) float tbuf[Canvas::CH * COVERAGE_CHUNK];
+  alignas(16) float v[Canvas::CH * COVERAGE_CHUNK];
+  const float col[4] = { (float)p.col[0], (float)p.col[1], (float)p.col[2], 1.0f };
+  const LossTarget& lt = target.loss();
+  CellDelta& cells = CellDelta::scratch();
+  if (L::CELLS) cells.begin(lt, b);
+  double delta = 0.0;
+  const CapsuleSpans spans = P::spans(p);
+  int xmin, xmax, solid0, solid1;
+  for (int y = b.ymin; y <= b.ymax; y++) {
+    if (!clipped_span(spans, y, b, xmin, xmax)) continue;
+    spans.inner(y, solid0, solid1);
+    for (int x = xmin; x <= xmax; x += COVERAGE_CHUNK) {
+      const int n = std::min((int)COVERAGE_CHUNK, xmax - x + 1);
+      P::coverage_row(p, y, x, n, solid0, solid1, a);
+      const float* u = under.px(y, x);
+      const float* m = mult.px(y, x);
+      const float* z = without.px(y, x);
+      for (int i = 0; i < n; i++)
+        for (int c = 0; c < Canvas::CH; c++) {
+          const int k = Canvas::CH * i + c;
+          v[k] = z[k] + m[k] * a[i] * (col[c] - u[k]);
+        }
+      delta += L::delta(lt, y, x, n, target.span(y, x, n, tbuf), v, z);
+      if (L::CELLS) cells.add(y, x, n, v, z);
+    }
+  }
+  if (L::CELLS) delta += cells.finish(lt, without);
+  return delta;
+}
+
+// Score p at its paint position without drawing it: under is the render of
+// the primitives painted below p, mult the transmittance of those above it
+// and without the render with p left out (all covering b; see
+// RJSampler::render_layers). Returns the SSE change of adding p over b.
+template <class P>
+inline double composite_layer_delta(const Canvas& under, const Canvas& mult,
+                                    const Canvas& without, const TargetImage& target,
+                                    const typename P::Params& p, const BBox& b) {
+  switch (target.loss().kind()) {
+    case LOSS_WEIGHTED:
+      return composite_layer_delta_loss<P, WeightedLoss>(under, mult, without, target, p, b);
+    case LOSS_LAB:
+      return composite_layer_delta_loss<P, LabLoss>(under, mult, without, target, p, b);
+    case LOSS_MULTISCALE:
+      return composite_layer_delta_loss<P, MultiscaleLoss>(under, mult, without, target, p, b);
+  }
+  float a[COVERAGE_CHUNK + VF_WIDTH];
+  alignas(16) float tbuf[Canvas::CH * COVERAGE_CHUNK];
+  const float col[4] = { (float)p.col[0], (float)p.col[1], (float)p.col[2], 1.0f };
+  double delta = 0.0;
+  const CapsuleSpans spans = P::spans(p);
+  int xmin, xmax, solid0, solid1;
+  for (int y = b.ymin; y <= b.ymax; y++) {
+    if (!clipped_span(spans, y, b, xmin, xmax)) continue;
+    spans.inner(y, solid0, solid1);
+    for (int x = xmin; x <= xmax; x += COVERAGE_CHUNK) {
+      const int n = std::min((int)COVERAGE_CHUNK, xmax - x + 1);
+      P::coverage_row(p, y, x, n, solid0, solid1, a);
+      delta += layer_delta_rgba_row(target.span(y, x, n, tbuf), under.px(y, x), mult.px(y, x),
+                                    without.px(y, x), a, n, col);
+    }
+  }
+  return delta;
+}
+
+// composite_layer_delta() and its gradient in one pass: grad[f] is the
+// derivative of the SSE change by field f of p (get_fields order), then
+// grad[NFIELDS + c] by colour c. Scalar, from P::coverage_grad(), so it
+// agrees with the vector coverage to float rounding. The weighted loss is
+// followed exactly; under the Lab and multiscale losses the gradient is
+// the RGB SSE one, a drift only, while the returned change is the loss's
+// own, so the MALA acceptance stays exact.
+template <class P>
+inline double composite_layer_grad(const Canvas& under, const Canvas& mult,
+                                   const Canvas& without, const TargetImage& target,
+                                   const typename P::Params& p, const BBox& b, double* grad) {
+  enum { NF = P::NFIELDS };
+  alignas(16) float tbuf[Canvas::CH * TARGET_CHUNK];
+  for (int f = 0; f < NF + 3; f++) grad[f] = 0.0;
+  double fields[NF];
+  P::get_fields(p, fields);
+  const double alpha = fields[NF - 1];
+  double delta = 0.0;
+  const CapsuleSpans spans = P::spans(p);
+  int xmin, xmax;
+  for (int y = b.ymin; y <= b.ymax; y++) {
+    if (!clipped_span(spans, y, b, xmin, xmax)) continue;
+    for (int x0 = xmin; x0 <= xmax; x0 += TARGET_CHUNK) {
+      const int n = std::min((int)TARGET_CHUNK, xmax - x0 + 1);
+      const float* t = target.span(y, x0, n, tbuf);
+      const float* w = target.loss().weights(y, x0);
+      for (int i = 0; i < n; i++) {
+        double dcov[NF];
+        const double cov = P::coverage_grad(p, y, x0 + i, dcov);
+        if (cov <= 0.0) continue;
+        const double a = cov * alpha, wt = w != NULL ? w[i] : 1.0;
+        const float* u = under.px(y, x0 + i);
+        const float* m = mult.px(y, x0 + i);
+        const float* z = without.px(y, x0 + i);
+        double da = 0.0;  // d SSE / d a
+        for (int c = 0; c < 3; c++) {
+          const double e = p.col[c] - u[c];
+          const double tv = t[Canvas::CH * i + c];
+          const double r = tv - (z[c] + m[c] * a * e), r0 = tv - z[c];
+          delta += wt * (r * r - r0 * r0);
+          grad[NF + c] -= 2.0 * wt * r * m[c] * a;
+          da -= 2.0 * wt * r * m[c] * e;
+        }
+        grad[NF - 1] += da * cov;
+        for (int f = 0; f < NF - 1; f++) grad[f] += da * alpha * dcov[f];
+      }
+    }
+  }
+  const int loss = target.loss().kind();
+  if (loss == LOSS_LAB || loss == LOSS_MULTISCALE)
+    delta = composite_layer_delta<P>(under, mult, without, target, p, b);
+  return delta;
+}
+
+// Draw p into canvas (or tile) restricted to clip; no-op if p does not touch clip
+template <class P>
+inline void composite_clipped(Canvas& canvas, const typename P::Params& p, const BBox& clip) {
+  const BBox r = canvas.bounds();
+  BBox b = bbox_intersect(P::footprint(p, r.xmax, r.ymax), clip);
+  if (!bbox_empty(b)) composite<P>(canvas, p, b);
+}
+
+template <class P>
+inline void composite_clipped(double* canvas, int H, int W,
+                              const typename P::Params& p, const BBox& clip) {
+  BBox b = bbox_intersect(P::footprint(p, W, H), clip);
+  if (!bbox_empty(b)) composite<P>(canvas, H, W, p, b);
+}
+
+// Clear bbox to white and redraw every primitive that touches it, in paint order.
+// If skip >= 0, prims[skip] is replaced by *subst (or omitted when subst is NULL).
+template <class P>
+inline void re_render_bbox(double* canvas, const std::vector<typename P::Params>& prims,
+                           const BBox& b, int H, int W,
+                           int skip = -1, const typename P::Params* subst = NULL) {
+  fill_bbox(canvas, H, W, b, 1.0);  // white background
+  const int n = (int)prims.size();
+  for (int i = 0; i < n; i++) {
+    if (i == skip) {
+      if (subst != NULL) composite_clipped<P>(canvas, H, W, *subst, b);
+      continue;
+    }
+    composite_clipped<P>(canvas, H, W, prims[i], b);
+  }
+}
+
+// ---- threaded full-canvas passes ----
+// A full render or SSE is independent per pixel, so it is split into bands
+// of RENDER_BAND rows on n_threads workers (<= 0: one per core). Every
+// pixel sees the same primitives in the same order and row sums are added
+// in row order, so the result is bit-identical to the single-threaded pass.
+
+enum { RENDER_BAND = 32 };
+
+inline int render_bands(int H) { return (H + RENDER_BAND - 1) / RENDER_BAND; }
+
+inline BBox render_band(int i, int H, int W) {
+  BBox b = { 1, W, 1 + i * RENDER_BAND, std::min(H, (i + 1) * RENDER_BAND) };
+  return b;
+}
+
+// Indices of the primitives whose footprint touches each band, in paint order
+template <class P>
+inline std::vector<std::vector<int> > band_bins(const std::vector<typename P::Params>& prims,
+                                                int H, int W) {
+  std::vector<std::vector<int> > bins(render_bands(H));
+  for (size_t i = 0; i < prims.size(); i++) {
+    const BBox f = P::footprint(prims[i], W, H);
+    if (bbox_empty(f)) continue;
+    for (int k = (f.ymin - 1) / RENDER_BAND; k <= (f.ymax - 1) / RENDER_BAND; k++)
+      bins[k].push_back((int)i);
+  }
+  return bins;
+}
+
+template <class P>
+inline void render_full(Canvas& canvas, const std::vector<typename P::Params>& prims,
+                        int n_threads = 1) {
+  const int H = canvas.H(), W = canvas.W();
+  if (worker_count(n_threads, render_bands(H)) == 1) {
+    BBox all = { 1, W, 1, H };
+    canvas.fill(all, 1.0f);  // white background
+    for (size_t i = 0; i < prims.size(); i++) composite_clipped<P>(canvas, prims[i], all);
+    return;
+  }
+  const std::vector<std::vector<int> > bins = band_bins<P>(prims, H, W);
+  parallel_for(render_bands(H), n_threads, [&](int k) {
+    const BBox band = render_band(k, H, W);
+    canvas.fill(band, 1.0f);
+    for (size_t i = 0; i < bins[k].size(); i++) composite_clipped<P>(canvas, prims[bins[k][i]], band);
+  });
+}
+
+template <class P>
+inline void render_full(double* canvas, const std::vector<typename P::Params>& prims,
+                        int H, int W, int n_threads = 1) {
+  if (worker_count(n_threads, render_bands(H)) == 1) {
+    std::fill(canvas, canvas + (size_t)H * W * 3, 1.0);  // white background
+    BBox all = { 1, W, 1, H };
+    for (size_t i = 0; i < prims.size(); i++) composite_clipped<P>(canvas, H, W, prims[i], all);
+    return;
+  }
+  const std::vector<std::vector<int> > bins = band_bins<P>(prims, H, W);
+  parallel_for(render_bands(H), n_threads, [&](int k) {
+    const BBox band = render_band(k, H, W);
+    fill_bbox(canvas, H, W, band, 1.0);
+    for (size_t i = 0; i < bins[k].size(); i++)
+      composite_clipped<P>(canvas, H, W, prims[bins[k][i]], band);
+  });
+}
+
+static_assert((1 << LOSS_MAX_LEVELS) <= (int)RENDER_BAND,
+              "a render band must hold whole multiscale cells");
+
+// sse_bbox() over the whole canvas. Other losses are summed per band (whole
+// cells of every multiscale level) with or without threads, so the total
+// does not depend on n_threads either.
+inline double sse_full(const TargetImage& target, const Canvas& canvas, int n_threads = 1) {
+  const int H = canvas.H(), W = canvas.W();
+  if (target.loss().kind() != LOSS_SSE) {
+    std::vector<double> bands(render_bands(H));
+    parallel_for(render_bands(H), n_threads, [&](int k) {
+      bands[k] = sse_bbox(target, canvas, render_band(k, H, W));
+    });
+    double acc = 0.0;
+    for (size_t k = 0; k < bands.size(); k++) acc += bands[k];
+    return acc;
+  }
+  if (worker_count(n_threads, render_bands(H)) == 1) {
+    BBox all = { 1, W, 1, H };
+    return sse_bbox(target, canvas, all);
+  }
+  std::vector<double> rows(H);
+  parallel_for(render_bands(H), n_threads, [&](int k) {
+    const BBox band = render_band(k, H, W);
+    for (int y = band.ymin; y <= band.ymax; y++) {
+      const BBox row = { 1, W, y, y };
+      rows[y - 1] = sse_bbox(target, canvas, row);
+    }
+  });
+  double acc = 0.0;
+  for (int y = 0; y < H; y++) acc += rows[y];
+  return acc;
+}
+
+// Replay the trace at path (see trace.h) and render the state at each of
+// iters on an H x W canvas (<= 0: the traced size), rescaling the primitives
+// when the size differs. on_frame(const Canvas&, iter, K) per frame; returns
+// the last iteration in the trace.
+template <class P, class Frame>
+inline int render_trace(const std::string& path, uint32_t kind, std::vector<int> iters,
+                        int H, int W, Frame on_frame, int n_threads = 1) {
+  const TraceHeader h = trace_info(path).header;
+  if (H <= 0) H = h.H;
+  if (W <= 0) W = h.W;
+  const double sx = (double)W / h.W, sy = (double)H / h.H;
+  const bool resize = H != h.H || W != h.W;
+  std::sort(iters.begin(), iters.end());
+
+  Canvas canvas(H, W);
+  std::vector<typename P::Params> prims;
+  return replay_trace<P>(path, kind, iters, [&](const PrimitiveStore<P>& store, int iter) {
+    prims = store.to_vector();
+    if (resize)
+      for (size_t i = 0; i < prims.size(); i++) prims[i] = P::rescale(prims[i], sx, sy, W, H);
+    render_full<P>(canvas, prims, n_threads);
+    on_frame(canvas, iter, store.size());
+  });
+}
+
+// ---- sampler ----
+
+struct SamplerConfig {
+  int iters;
+  double beta_init, beta_final;  // geometric schedule beta_init * (beta_final/beta_init)^(t/iters)
+  double prob_moves[4];          // birth, death, jitter, swap; need not sum to 1
+  double K_lambda;               // Poisson prior mean on K; <= 0 disables the prior
+  bool datadriven_birth;         // residual-seeded births instead of prior draws
+  bool jitter_every_iter;        // additionally jitter one primitive after every move
+  int jitter_tries;              // > 1: multiple-try jitter over this many candidates
+                                 // (regular moves only; tile sweeps try one)
+  int sse_check_every;           // full rescan of the running SSE; <= 0 never
+  int save_every;                // snapshot period; <= 0 disables snapshots
+  int checkpoint_every;          // on_checkpoint period in run(); <= 0 never
+  int stats_every;               // K / SSE / throughput history period in run(); <= 0 none
+  int tile_size;                 // tile-parallel sweeps on tile_size px tiles; <= 0 off
+  int tile_moves;                // proposals per tile per sweep, one sweep every tile_moves iterations
+  int n_threads;                 // sweep and full-canvas workers; <= 0 one per core
+  bool verbose;
+  JitterScales jitter;
+  int precision;                 // target storage (StoragePrecision); 0 = float32
+  double mala_step;              // > 0: gradient-guided single-try jitter with proposal
+                                 // variance mala_step * sd^2 (regular moves only)
+  int adapt_iters;               // > 0: tune prob_moves and jitter over the first
+                                 // adapt_iters iterations, then freeze (adapt.h)
+  double adapt_target;           // jitter acceptance to tune to; <= 0 the kernel's default
+  LossConfig loss;               // minimised in place of the SSE (loss.h); default SSE
+};
+
+// ---- tile-parallel sweeps ----
+// One tile of a sweep (see RJSampler::tile_sweep). The tile holds a copy of
+// the canvas over its bounds and every primitive touching it; only those
+// whose footprint lies inside the tile ("owned") may die or move, and births
+// must land inside it, so every change and every pixel read stays in the
+// tile. Tiles therefore never see each other's changes and can run on
+// separate threads. run() touches no shared state and no R state.
+template <class P>
+class TileTask {
+public:
+  typedef typename P::Params Params;
+
+  struct Item {
+    Params p;
+    BBox fp;
+    unsigned long long order;
+    int slot;      // store slot, -1 for a birth in this sweep
+    bool owned, alive, changed;
+  };
+
+  // Main thread: start a sweep over tile; births get order keys
+  // order_base + order_stride * k
+  void reset(const BBox& tile, uint64_t seed,
+             unsigned long long order_base, unsigned long long order_stride) {
+    tile_ = tile;
+    seed_ = seed;
+    order_base_ = order_base;
+    order_stride_ = order_stride;
+    items_.clear();
+    owned_.clear();
+    births_ = 0;
+    dsse_ = 0.0;
+    counts_.clear();
+    dirty_ = BBox{ tile.xmax + 1, tile.xmin - 1, tile.ymax + 1, tile.ymin - 1 };
+  }
+
+  // Main thread: register a primitive touching the tile; call in paint order
+  void add(const Params& p, const BBox& fp, unsigned long long order, int slot) {
+    Item it = { p, fp, order, slot, false, true, false };
+    it.owned = fp.xmin >= tile_.xmin && fp.xmax <= tile_.xmax &&
+               fp.ymin >= tile_.ymin && fp.ymax <= tile_.ymax;
+    if (it.owned) owned_.push_back((int)items_.size());
+    items_.push_back(it);
+  }
+
+  // Worker: n_moves birth/death/jitter proposals against the tile, with
+  // K the global primitive count at the start of the sweep
+  void run(const TargetImage& target, const Canvas& canvas, const SamplerConfig& cfg,
+           double beta, int K, int n_moves) {
+    const int W = target.W(), H = target.H();
+    NativeRng rng(seed_);
+    local_.reset_tile(tile_);
+    local_.copy_from(canvas, tile_);
+    if (cfg.datadriven_birth) residual_.build(target, local_, tile_);
+    K_ = K;
+
+    const double* pm = cfg.prob_moves;
+    const double p_total = pm[MOVE_BIRTH] + pm[MOVE_DEATH] + pm[MOVE_JITTER];
+    if (!(p_total > 0.0)) return;
+    for (int m = 0; m < n_moves; m++) {
+      const double u = rng.runif(0.0, p_total);
+      int mtype = MOVE_JITTER;
+      if (u < pm[MOVE_BIRTH]) mtype = MOVE_BIRTH;
+      else if (u < pm[MOVE_BIRTH] + pm[MOVE_DEATH]) mtype = MOVE_DEATH;
+      counts_.proposed[mtype]++;
+      if (mtype == MOVE_BIRTH) move_birth(target, cfg, beta, W, H, rng);
+      else if (mtype == MOVE_DEATH) move_death(target, cfg, beta, W, H, rng);
+      else move_jitter(target, cfg, beta, W, H, rng);
+      if (cfg.jitter_every_iter) {
+        counts_.proposed[MOVE_JITTER]++;
+        move_jitter(target, cfg, beta, W, H, rng);
+      }
+    }
+  }
+
+  const BBox& tile() const { return tile_; }
+  const std::vector<Item>& items() const { return items_; }
+  const Canvas& canvas() const { return local_; }
+  double dsse() const { return dsse_; }
+  // Union of the accepted changes; empty if nothing was accepted
+  const BBox& dirty() const { return dirty_; }
+  int births() const { return births_; }
+  const MoveCounts& counts() const { return counts_; }
+
+private:
+  bool inside(const BBox& b) const {
+    return b.xmin >= tile_.xmin && b.xmax <= tile_.xmax &&
+           b.ymin >= tile_.ymin && b.ymax <= tile_.ymax;
+  }
+
+  int pick_owned(NativeRng& rng) const {
+    const int n = (int)owned_.size();
+    int j = (int)(rng.unif() * n);
+    return j >= n ? n - 1 : j;
+  }
+
+  // scratch_ over b: the tile re-rendered with item skip replaced by *subst
+  void re_render(const BBox& b, int skip, const Params* subst) {
+    scratch_.reset_tile(b);
+    scratch_.fill(b, 1.0f);  // white background
+    for (size_t i = 0; i < items_.size(); i++) {
+      const Item& it = items_[i];
+      if (!it.alive || bbox_empty(bbox_intersect(it.fp, b))) continue;
+      if ((int)i == skip) {
+        if (subst != NULL) composite_clipped<P>(scratch_, *subst, b);
+        continue;
+      }
+      composite_clipped<P>(scratch_, it.p, b);
+    }
+  }
+
+  void commit(const TargetImage& target, const SamplerConfig& cfg, const BBox& b, double dsse) {
+    local_.copy_from(scratch_, b);
+    if (cfg.datadriven_birth) residual_.update(target, local_, b);
+    dsse_ += dsse;
+    dirty_ = bbox_union(dirty_, b);
+  }
+
+  // Same acceptance ratios as RJSampler's moves, with the uniform death
+  // choice taken over the tile's own primitives
+  void move_birth(const TargetImage& target, const SamplerConfig& cfg, double beta,
+                  int W, int H, NativeRng& rng) {
+    Params prop = PrimitiveStore<P>::round(cfg.datadriven_birth
+      ? P::sample_birth(target, residual_, rng)
+      : P::sample_prior(W, H, rng));
+    const double lp_new = P::log_prior(prop, W, H);
+    if (!std::isfinite(lp_new)) return;
+    const BBox b = P::footprint(prop, W, H);
+    if (bbox_empty(b) || !inside(b)) return;
+
+    scratch_.reset_tile(b);
+    const double dsse = composite_delta<P>(scratch_, local_, target, prop, b);
+    const int Kt = (int)owned_.size();
+    const double log_acc = -beta * dsse + lp_new +
+      log_prior_K_raw(K_ + 1, cfg.K_lambda) - log_prior_K_raw(K_, cfg.K_lambda) +
+      std::log(1.0 / (Kt + 1 + 1e-12));
+    if (std::log(rng.unif()) < log_acc) {
+      Item it = { prop, b, order_base_ + order_stride_ * births_++, -1, true, true, true };
+      owned_.push_back((int)items_.size());
+      items_.push_back(it);
+      K_++;
+      counts_.accepted[MOVE_BIRTH]++;
+      commit(target, cfg, b, dsse);
+    }
+  }
+
+  void move_death(const TargetImage& target, const SamplerConfig& cfg, double beta,
+                  int W, int H, NativeRng& rng) {
+    const int Kt = (int)owned_.size();
+    if (Kt == 0) return;
+    const int k = pick_owned(rng);
+    Item& it = items_[owned_[k]];
+    re_render(it.fp, owned_[k], NULL);
+
+    const double dsse = sse_delta_bbox(target, scratch_, local_, it.fp);
+    const double log_acc = -beta * dsse +
+      log_prior_K_raw(K_ - 1, cfg.K_lambda) - log_prior_K_raw(K_, cfg.K_lambda) -
+      P::log_prior(it.p, W, H) + std::log(Kt + 1e-12);
+    if (std::log(rng.unif()) < log_acc) {
+      it.alive = false;
+      owned_[k] = owned_.back();
+      owned_.pop_back();
+      K_--;
+      counts_.accepted[MOVE_DEATH]++;
+      commit(target, cfg, it.fp, dsse);
+    }
+  }
+
+  void move_jitter(const TargetImage& target, const SamplerConfig& cfg, double beta,
+                   int W, int H, NativeRng& rng) {
+    if (owned_.empty()) return;
+    const int i = owned_[pick_owned(rng)];
+    Item& it = items_[i];
+    Params prop = PrimitiveStore<P>::round(P::jitter(it.p, W, H, cfg.jitter, rng));
+    const double lp_cur = P::log_prior(it.p, W, H);
+    const double lp_new = P::log_prior(prop, W, H);
+    if (!std::isfinite(lp_new) || !std::isfinite(lp_cur)) return;
+    const BBox fp = P::footprint(prop, W, H);
+    if (bbox_empty(fp) || !inside(fp)) return;  // stays owned, so the move is symmetric
+
+    const BBox b = bbox_union(it.fp, fp);
+    re_render(b, i, &prop);
+    const double dsse = sse_delta_bbox(target, scratch_, local_, b);
+    if (std::log(rng.unif()) < -beta * dsse + (lp_new - lp_cur)) {
+      it.p = prop;
+      it.fp = fp;
+      it.changed = true;
+      counts_.accepted[MOVE_JITTER]++;
+      commit(target, cfg, b, dsse);
+    }
+  }
+
+  BBox tile_;
+  uint64_t seed_;
+  unsigned long long order_base_, order_stride_;
+  std::vector<Item> items_;  // paint order
+  std::vector<int> owned_;   // indices into items_ of the live owned primitives
+  Canvas local_;             // canvas over tile_
+  Canvas scratch_;           // proposal tile
+  ResidualTree residual_;    // birth seeds within the tile
+  int K_;                    // global K including this tile's accepted moves
+  int births_;
+  double dsse_;
+  MoveCounts counts_;        // this sweep's proposals and acceptances
+  BBox dirty_;
+};
+
+template <class P, class Rng = NativeRng>
+class RJSampler {
+public:
+  typedef typename P::Params Params;
+
+  // target: planar [H, W, 3], stored at cfg.precision
+  RJSampler(const double* target, int H, int W, const SamplerConfig& cfg,
+            const Rng& rng = Rng())
+    : RJSampler(std::make_shared<const TargetImage>(target, H, W, cfg.precision, cfg.loss),
+                cfg, rng) {}
+
+  // A target shared with other samplers (the replicas of ParallelTempering)
+  RJSampler(std::shared_ptr<const TargetImage> target, const SamplerConfig& cfg,
+            const Rng& rng = Rng())
+    : target_ptr_(target), target_(*target_ptr_), H_(target->H()), W_(target->W()), cfg_(cfg),
+      rng_(rng), canvas_(H_, W_),
+      index_(H_, W_), next_order_(0), trace_(NULL), stats_log_(NULL), run_seconds_(0.0),
+      pool_(cfg.tile_size > 0 ? cfg.n_threads : 1), iter_(0),
+      at_best_(true), best_canvas_valid_(false), best_iter_(0) {
+    p_total_ = 0.0;
+    for (int m = 0; m < 4; m++) p_total_ += cfg_.prob_moves[m];
+    if (!(p_total_ > 0.0)) Rcpp::stop("prob_moves must have positive total");
+    if (cfg_.tile_size > 0 && cfg_.tile_moves < 1) Rcpp::stop("tile_moves must be >= 1");
+    if (cfg_.tile_size > 0 && cfg_.tile_size % target_.loss().cell() != 0)
+      Rcpp::stop("tile_size must be a multiple of the coarsest multiscale cell, 2^loss_levels");
+    if (cfg_.jitter_tries > 1) {
+      tries_.resize(cfg_.jitter_tries);
+      lw_.resize(cfg_.jitter_tries);
+    }
+    jitter0_ = cfg_.jitter;
+    adapt_.start(cfg_.prob_moves);
+
+    full_.xmin = 1; full_.xmax = W_; full_.ymin = 1; full_.ymax = H_;
+    sse_.reset(full_sse());
+    best_sse_ = sse();
+    if (cfg_.datadriven_birth) residual_.build(target_, canvas_);
+  }
+
+  // Start from prims (paint order) instead of the blank canvas, e.g. the
+  // set carried over from a coarser pyramid level. Call before run().
+  void init(const std::vector<Params>& prims) {
+    store_.clear();
+    index_.clear();
+    next_order_ = 0;
+    if (trace_ != NULL) trace_->dump(iter_, store_);
+    store_.reserve((int)prims.size());
+    for (size_t i = 0; i < prims.size(); i++) add_prim(PrimitiveStore<P>::round(prims[i]));
+    render_full<P>(canvas_, store_.to_vector(), cfg_.n_threads);
+    sse_.reset(full_sse());
+    at_best_ = true;
+    best_canvas_valid_ = false;
+    best_sse_ = sse();
+    best_iter_ = 0;
+    if (cfg_.datadriven_birth) residual_.build(target_, canvas_);
+  }
+
+  // on_snapshot(const Canvas&, iter, K, beta, sse) is called at iteration 0
+  // and every save_every iterations, on_checkpoint(iter, beta) every
+  // checkpoint_every. A sampler restored from a checkpoint continues after
+  // the iteration it was taken at.
+  template <class Snapshot>
+  void run(Snapshot on_snapshot) {
+    run(on_snapshot, [](int, double) {});
+  }
+
+  template <class Snapshot, class Checkpoint>
+  void run(Snapshot on_snapshot, Checkpoint on_checkpoint) {
+    if (cfg_.save_every > 0 && iter_ == 0) on_snapshot(canvas_, 0, K(), cfg_.beta_init, sse());
+    const long long t0 = stat_now_ns();
+    if (cfg_.stats_every > 0) record_stats(iter_, beta_at(iter_), 0.0);
+
+    for (int t = iter_ + 1; t <= cfg_.iters; t++) {
+      if (cfg_.verbose && t % 100 == 0) Rcpp::Rcout << "t:  " << t << " \n";
+      if (t % 1000 == 0) Rcpp::checkUserInterrupt();
+
+      const double beta = beta_at(t);
+      step(t, beta);
+
+      if (cfg_.save_every > 0 && t % cfg_.save_every == 0) {
+        on_snapshot(canvas_, t, K(), beta, sse());
+      }
+      if (cfg_.stats_every > 0 && t % cfg_.stats_every == 0)
+        record_stats(t, beta, 1e-9 * (stat_now_ns() - t0));
+      if (cfg_.checkpoint_every > 0 && t % cfg_.checkpoint_every == 0) on_checkpoint(t, beta);
+    }
+    run_seconds_ = 1e-9 * (stat_now_ns() - t0);
+  }
+
+  // One iteration t at inverse temperature beta. Touches no R state when
+  // Rng does not, so it may run on a worker thread.
+  void step(int t, double beta) {
+    iter_ = t;
+
+    double u = rng_.runif(0.0, p_total_);
+    int mtype = MOVE_BIRTH;
+    while (mtype < MOVE_SWAP && u >= cfg_.prob_moves[mtype]) u -= cfg_.prob_moves[mtype++];
+
+    const bool adapting = t <= cfg_.adapt_iters;
+    if (cfg_.adapt_iters > 0) adapt_.apply(cfg_.jitter, jitter0_, beta);
+    move(mtype, beta, adapting);
+    if (cfg_.jitter_every_iter) move(MOVE_JITTER, beta, adapting);
+    if (adapting && (t % ADAPT_WINDOW == 0 || t == cfg_.adapt_iters)) {
+      adapt_.update(cfg_.prob_moves, beta, adapt_target());
+      p_total_ = 0.0;
+      for (int m = 0; m < 4; m++) p_total_ += cfg_.prob_moves[m];
+    }
+    if (cfg_.tile_size > 0 && t % cfg_.tile_moves == 0) {
+      ScopedNs timer(stats_.ns[TIME_TILES]);
+      tile_sweep(beta);
+    }
+
+    if (cfg_.sse_check_every > 0 && t % cfg_.sse_check_every == 0) sse_.reset(full_sse());
+  }
+
+  // Move mix and jitter scales in use: the configured ones, or as tuned
+  // so far during burn-in (see adapt.h)
+  const double* prob_moves() const { return cfg_.prob_moves; }
+  const JitterScales& jitter() const { return cfg_.jitter; }
+  const MoveAdapter& adapter() const { return adapt_; }
+  double adapt_target() const {
+    return cfg_.adapt_target > 0.0 ? cfg_.adapt_target
+      : adapt_default_target(cfg_.mala_step > 0.0 && cfg_.jitter_tries <= 1);
+  }
+
+  double beta_at(int t) const {
+    return cfg_.beta_init * std::pow(cfg_.beta_final / cfg_.beta_init, (double)t / cfg_.iters);
+  }
+
+  // O(HW) rescan; sse() is the running total kept from accepted deltas
+  double full_sse() const { return sse_full(target_, canvas_, cfg_.n_threads); }
+  double sse() const { return sse_.value(); }
+
+  const Canvas& canvas() const { return canvas_; }
+  const TargetImage& target() const { return target_; }
+  int K() const { return store_.size(); }
+  int iter() const { return iter_; }  // last completed iteration
+
+  // Counters and timers since construction, and the history kept by run()
+  // (see stats.h); the log, if set, gets every history row as it is taken
+  const SamplerStats& stats() const { return stats_; }
+  double run_seconds() const { return run_seconds_; }
+  void set_stats_log(StatsLog* log) { stats_log_ = log; }
+
+  // Record every accepted change to the store into trace (NULL detaches),
+  // starting with a dump of the current state unless the trace already
+  // ends in it (a resumed trace, see resume_trace). The writer must outlive
+  // the chain or be detached first.
+  void set_trace(TraceWriter<P>* trace, bool dump = true) {
+    trace_ = trace;
+    if (trace_ != NULL && dump) trace_->dump(iter_, store_);
+  }
+
+  // Native primitive store; slots are unordered, see prims() for paint order
+  const PrimitiveStore<P>& store() const { return store_; }
+
+  // Primitives in paint order
+  std::vector<Params> prims() const { return store_.to_vector(); }
+  // Lowest-SSE state seen, checked after every accepted move. Only its
+  // primitives are kept; the canvas is re-rendered on first request.
+  double best_sse() const { return best_sse_; }
+  const PrimitiveStore<P>& best_store() const { return at_best_ ? store_ : best_store_; }
+  std::vector<Params> best_prims() const { return best_store().to_vector(); }
+  int best_iter() const { return best_iter_; }
+
+  const Canvas& best_canvas() const {
+    if (at_best_) return canvas_;
+    if (!best_canvas_valid_) {
+      best_canvas_ = Canvas(H_, W_);
+      render_full<P>(best_canvas_, best_prims(), cfg_.n_threads);
+      best_canvas_valid_ = true;
+    }
+    return best_canvas_;
+  }
+
+  // Save or load the chain state (see checkpoint.h): everything the next
+  // iteration depends on except what restore() rebuilds from the primitives
+  template <class Ar>
+  void checkpoint(Ar& ar) {
+    ar.pod(iter_);
+    ar.pod(next_order_);
+    rng_.checkpoint(ar);
+    store_.checkpoint(ar);
+    ar.pod(sse_.sum);
+    ar.pod(sse_.comp);
+    ar.pod(at_best_);
+    best_store_.checkpoint(ar);
+    ar.pod(best_sse_);
+    ar.pod(best_iter_);
+    ar.pod(cfg_.prob_moves);
+    ar.pod(cfg_.jitter);
+    ar.pod(p_total_);
+    adapt_.checkpoint(ar);
+  }
+
+  // After a load: canvas, tile index and residual tree from the primitives.
+  // The canvas re-renders bit for bit to the one the checkpoint was taken
+  // from, so the run continues exactly as it would have.
+  void restore() {
+    index_.clear();
+    for (int i = 0; i < store_.size(); i++)
+      index_.insert(i, P::footprint(store_.get(i), W_, H_));
+    render_full<P>(canvas_, store_.to_vector(), cfg_.n_threads);
+    best_canvas_valid_ = false;
+    if (cfg_.datadriven_birth) residual_.build(target_, canvas_);
+  }
+
+private:
+  // f() with its wall time added to timer k
+  template <class F>
+  auto timed(int k, F f) -> decltype(f()) {
+    ScopedNs timer(stats_.ns[k]);
+    return f();
+  }
+
+  // One regular move of type m; while adapting, its outcome, work and SSE
+  // gain go to the adapter
+  void move(int m, double beta, bool adapting) {
+    stats_.moves.proposed[m]++;
+    const long long acc0 = stats_.moves.accepted[m];
+    const double sse0 = sse(), area0 = stats_.area;
+    switch (m) {
+      case MOVE_BIRTH:  move_birth(beta); break;
+      case MOVE_DEATH:  move_death(beta); break;
+      case MOVE_JITTER: move_jitter(beta); break;
+      case MOVE_SWAP:   move_swap(beta); break;
+    }
+    if (adapting)
+      adapt_.record(m, stats_.moves.accepted[m] > acc0, stats_.area - area0, sse0 - sse());
+  }
+
+  void record_stats(int t, double beta, double seconds) {
+    stats_.record(t, K(), sse(), beta, seconds);
+    if (stats_log_ != NULL) stats_log_->write(stats_, stats_);
+  }
+
+  int pick_index(int K) {
+    int j = (int)(rng_.unif() * K);
+    return j >= K ? K - 1 : j;
+  }
+
+  // SSE change of replacing canvas_ by tile_ over b
+  double delta_sse(const BBox& b) const {
+    return sse_delta_bbox(target_, tile_, canvas_, b);
+  }
+
+  void sort_paint_order(std::vector<int>& ids) const {
+    const std::vector<unsigned long long>& ord = store_.orders();
+    std::sort(ids.begin(), ids.end(), [&ord](int a, int b) { return ord[a] < ord[b]; });
+  }
+
+  // Clear b to white and redraw, in paint order, only the primitives the tile
+  // index reports near b. Slot skip is replaced by *subst (omitted if NULL).
+  void re_render(Canvas& canvas, const BBox& b, int skip, const Params* subst) {
+    canvas.fill(b, 1.0f);  // white background
+    index_.query(b, hits_);
+    sort_paint_order(hits_);
+    for (size_t k = 0; k < hits_.size(); k++) {
+      const int id = hits_[k];
+      if (id == skip) {
+        if (subst != NULL) composite_clipped<P>(canvas, *subst, b);
+        continue;
+      }
+      composite_clipped<P>(canvas, store_.get(id), b);
+    }
+  }
+
+  void add_prim(const Params& p) { add_prim(p, next_order_++); }  // births paint on top
+
+  void add_prim(const Params& p, unsigned long long order) {
+    const int id = store_.push(p, order);
+    index_.insert(id, P::footprint(p, W_, H_));
+    if (trace_ != NULL) trace_->add(iter_, id, order, p);
+  }
+
+  // Swap-remove: the last slot moves into j, paint order is kept by the key
+  void remove_prim(int j) {
+    const int last = store_.size() - 1;
+    index_.remove(j, P::footprint(store_.get(j), W_, H_));
+    if (j != last) index_.relabel(last, j, P::footprint(store_.get(last), W_, H_));
+    store_.swap_remove(j);
+    if (trace_ != NULL) trace_->remove(iter_, j);
+  }
+
+  void update_prim(int j, const Params& p) {
+    index_.move(j, P::footprint(store_.get(j), W_, H_), P::footprint(p, W_, H_));
+    store_.set(j, p);
+    if (trace_ != NULL) trace_->set(iter_, j, p);
+  }
+
+  // Accepted reordering; the trial orders in move_swap bypass the trace
+  void set_order(int j, unsigned long long o) {
+    store_.set_order(j, o);
+    if (trace_ != NULL) trace_->order(iter_, j, o);
+  }
+
+  // Call before applying an accepted move with SSE change dsse. While the
+  // current state is the best one, the best state is simply "current"; it is
+  // copied out (parameters only) just before a move makes things worse.
+  void keep_best(double dsse) {
+    if (at_best_ && sse() + dsse > best_sse_) {
+      best_store_ = store_;
+      at_best_ = false;
+      best_canvas_valid_ = false;
+    }
+  }
+
+  // Call after the move has been applied
+  void track_best() {
+    if (sse() < best_sse_) {
+      best_sse_ = sse();
+      best_iter_ = iter_;
+      at_best_ = true;
+    }
+  }
+
+  // Write the accepted proposal back into the live canvas. tile_ holds the
+  // exact re-render of b (everything outside b is untouched by the move), so
+  // only b is copied instead of redrawing the whole primitive set.
+  void commit(const BBox& b, double dsse) {
+    canvas_.copy_from(tile_, b);
+    sse_.add(dsse);
+    if (cfg_.datadriven_birth) residual_.update(target_, canvas_, b);
+    track_best();
+  }
+
+  // Birth: new primitive composited on top of the current canvas
+  void move_birth(double beta) {
+    const int K = store_.size();
+    Params prop = timed(TIME_BIRTH, [&] {
+      return PrimitiveStore<P>::round(cfg_.datadriven_birth
+        ? P::sample_birth(target_, residual_, rng_)
+        : P::sample_prior(W_, H_, rng_));
+    });
+    double lp_new = P::log_prior(prop, W_, H_);
+    if (!std::isfinite(lp_new)) return;
+
+    BBox b = P::footprint(prop, W_, H_);
+    if (bbox_empty(b)) return;
+    stats_.bbox(b);
+    tile_.reset_tile(b);
+    const double dsse = timed(TIME_RASTER, [&] {
+      return composite_delta<P>(tile_, canvas_, target_, prop, b);
+    });
+
+    // RJ ratio with a uniform death choice (1/(K+1)); the birth proposal
+    // density is treated as constant
+    double log_acc = -beta * dsse + lp_new +
+      log_prior_K_raw(K + 1, cfg_.K_lambda) - log_prior_K_raw(K, cfg_.K_lambda) +
+      std::log(1.0 / (K + 1 + 1e-12));
+
+    if (std::log(rng_.unif()) < log_acc) {
+      ScopedNs timer(stats_.ns[TIME_COMMIT]);
+      stats_.moves.accepted[MOVE_BIRTH]++;
+      keep_best(dsse);
+      add_prim(prop);
+      commit(b, dsse);
+    }
+  }
+
+  // Death: re-render the removed primitive's bbox from the remaining ones
+  void move_death(double beta) {
+    const int K = store_.size();
+    if (K == 0) return;
+    const int j = pick_index(K);
+    const Params rem = store_.get(j);
+    BBox b = P::footprint(rem, W_, H_);
+    if (bbox_empty(b)) return;
+    stats_.bbox(b);
+    tile_.reset_tile(b);
+    timed(TIME_RASTER, [&] { re_render(tile_, b, j, NULL); });
+
+    const double dsse = timed(TIME_SSE, [&] { return delta_sse(b); });
+    double log_acc = -beta * dsse +
+      log_prior_K_raw(K - 1, cfg_.K_lambda) - log_prior_K_raw(K, cfg_.K_lambda) -
+      P::log_prior(rem, W_, H_) + std::log(K + 1e-12);  // inverse of birth's 1/(K+1)
+
+    if (std::log(rng_.unif()) < log_acc) {
+      ScopedNs timer(stats_.ns[TIME_COMMIT]);
+      stats_.moves.accepted[MOVE_DEATH]++;
+      keep_best(dsse);
+      remove_prim(j);
+      commit(b, dsse);
+    }
+  }
+
+  // Jitter: the perturbed primitive is scored at its own paint position
+  void move_jitter(double beta) {
+    const int K = store_.size();
+    if (K == 0) return;
+    if (cfg_.jitter_tries > 1) {
+      move_jitter_mtm(beta);
+      return;
+    }
+    if (cfg_.mala_step > 0.0) {
+      move_jitter_mala(beta);
+      return;
+    }
+    const int j = pick_index(K);
+    const Params cur = store_.get(j);
+    Params prop = PrimitiveStore<P>::round(P::jitter(cur, W_, H_, cfg_.jitter, rng_));
+
+    double lp_cur = P::log_prior(cur, W_, H_);
+    double lp_new = P::log_prior(prop, W_, H_);
+    if (!std::isfinite(lp_new) || !std::isfinite(lp_cur)) return;
+
+    BBox b = bbox_union(P::footprint(cur, W_, H_), P::footprint(prop, W_, H_));
+    if (bbox_empty(b)) return;
+    stats_.bbox(b);
+    tile_.reset_tile(b);
+    timed(TIME_RASTER, [&] { re_render(tile_, b, j, &prop); });
+
+    const double dsse = timed(TIME_SSE, [&] { return delta_sse(b); });
+    double log_acc = -beta * dsse + (lp_new - lp_cur);  // symmetric proposal
+    if (std::log(rng_.unif()) < log_acc) {
+      ScopedNs timer(stats_.ns[TIME_COMMIT]);
+      stats_.moves.accepted[MOVE_JITTER]++;
+      keep_best(dsse);
+      update_prim(j, prop);
+      commit(b, dsse);
+    }
+  }
+
+  // Multiple-try jitter (Liu, Liang & Wong 2000): M = jitter_tries candidates
+  // y_1..y_M around x, one picked with weight pi(y_i); then M - 1 reference
+  // points around the pick plus x itself, accepted with
+  //   sum pi(y_i) / sum pi(x_i).
+  // With the symmetric jitter kernel pi is the plain target density. All 2M-1
+  // scores share one set of layers around j (render_layers) and each costs a
+  // single pass over the candidate's own pixels; only an accepted pick is
+  // re-rendered exactly.
+  void move_jitter_mtm(double beta) {
+    const int M = cfg_.jitter_tries;
+    const int j = pick_index(store_.size());
+    const Params cur = store_.get(j);
+    if (!std::isfinite(P::log_prior(cur, W_, H_))) return;
+
+    BBox region = P::footprint(cur, W_, H_);
+    for (int m = 0; m < M; m++) {
+      tries_[m] = PrimitiveStore<P>::round(P::jitter(cur, W_, H_, cfg_.jitter, rng_));
+      region = bbox_union(region, P::footprint(tries_[m], W_, H_));
+    }
+    stats_.bbox(region);
+    timed(TIME_RASTER, [&] { render_layers(region, j); });
+    timed(TIME_SSE, [&] {
+      for (int m = 0; m < M; m++) lw_[m] = layer_weight(tries_[m], region, beta);
+    });
+    const double lse_y = log_sum_exp(lw_);
+    if (!std::isfinite(lse_y)) return;
+
+    // pick y_k with probability pi(y_k) / sum pi(y_i)
+    const double top = max_of(lw_);
+    double u = rng_.unif() * std::exp(lse_y - top);
+    int k = 0;
+    while (k + 1 < M && (u -= std::exp(lw_[k] - top)) >= 0.0) k++;
+    const Params prop = tries_[k];
+
+    // references around the pick; the layers are redone only if they grow
+    BBox grown = region;
+    for (int m = 0; m + 1 < M; m++) {
+      tries_[m] = PrimitiveStore<P>::round(P::jitter(prop, W_, H_, cfg_.jitter, rng_));
+      grown = bbox_union(grown, P::footprint(tries_[m], W_, H_));
+    }
+    tries_[M - 1] = cur;
+    if (grown.xmin < region.xmin || grown.xmax > region.xmax ||
+        grown.ymin < region.ymin || grown.ymax > region.ymax) {
+      region = grown;
+      timed(TIME_RASTER, [&] { render_layers(region, j); });
+    }
+    timed(TIME_SSE, [&] {
+      for (int m = 0; m < M; m++) lw_[m] = layer_weight(tries_[m], region, beta);
+    });
+
+    if (std::log(rng_.unif()) < lse_y - log_sum_exp(lw_)) {
+      BBox b = bbox_union(P::footprint(cur, W_, H_), P::footprint(prop, W_, H_));
+      tile_.reset_tile(b);
+      timed(TIME_RASTER, [&] { re_render(tile_, b, j, &prop); });
+      const double dsse = timed(TIME_SSE, [&] { return delta_sse(b); });
+      ScopedNs timer(stats_.ns[TIME_COMMIT]);
+      stats_.moves.accepted[MOVE_JITTER]++;
+      keep_best(dsse);
+      update_prim(j, prop);
+      commit(b, dsse);
+    }
+  }
+
+  // Gradient-guided jitter (MALA): with sd_f the jitter sd of field f and
+  // h = mala_step, the proposal is
+  //   y_f = x_f + mu_f(x) + sqrt(h) sd_f N(0, 1),
+  //   mu_f(x) = h sd_f^2 / 2 * d/dx_f [log prior - beta SSE],
+  // each drift capped at sd_f so steep gradients cannot throw the move far
+  // off. The SSE and its gradient come from one layer pass per point
+  // (composite_layer_grad), and the acceptance carries the Hastings ratio
+  // q(x | y) / q(y | x) of the two Gaussians. Proposals outside the prior
+  // support are rejected rather than clamped, which keeps the ratio exact.
+  void move_jitter_mala(double beta) {
+    enum { NP = P::NFIELDS + 3 };
+    const int j = pick_index(store_.size());
+    const Params cur = store_.get(j);
+    const double lp_cur = P::log_prior(cur, W_, H_);
+    if (!std::isfinite(lp_cur)) return;
+
+    double sd[NP], x[NP], y[NP], mu_x[NP], mu_y[NP];
+    P::jitter_sd(cfg_.jitter, sd);
+    sd[NP - 3] = sd[NP - 2] = sd[NP - 1] = cfg_.jitter.s_c;
+    BBox region = P::footprint(cur, W_, H_);
+    if (bbox_empty(region)) return;
+    stats_.bbox(region);
+    timed(TIME_RASTER, [&] { render_layers(region, j); });
+    const double d_cur = timed(TIME_SSE, [&] { return mala_drift(cur, region, beta, sd, mu_x); });
+
+    const double h = cfg_.mala_step, rh = std::sqrt(h);
+    mala_vec(cur, x);
+    for (int f = 0; f < NP; f++) y[f] = x[f] + mu_x[f] + rh * sd[f] * rng_.rnorm(0.0, 1.0);
+    const Params prop = PrimitiveStore<P>::round(mala_params(cur, y));
+    const double lp_new = P::log_prior(prop, W_, H_);
+    if (!std::isfinite(lp_new)) return;
+    mala_vec(prop, y);
+
+    const BBox fp = P::footprint(prop, W_, H_);
+    if (bbox_empty(fp)) return;
+    const BBox grown = bbox_union(region, fp);
+    if (grown.xmin < region.xmin || grown.xmax > region.xmax ||
+        grown.ymin < region.ymin || grown.ymax > region.ymax) {
+      region = grown;  // layer pixels do not depend on the region, so d_cur holds
+      timed(TIME_RASTER, [&] { render_layers(region, j); });
+    }
+    const double d_new = timed(TIME_SSE, [&] { return mala_drift(prop, region, beta, sd, mu_y); });
+
+    double log_q = 0.0;  // log q(x | y) - log q(y | x)
+    for (int f = 0; f < NP; f++) {
+      const double fwd = y[f] - x[f] - mu_x[f], rev = x[f] - y[f] - mu_y[f];
+      log_q += (fwd * fwd - rev * rev) / (2.0 * h * sd[f] * sd[f]);
+    }
+    const double log_acc = -beta * (d_new - d_cur) + (lp_new - lp_cur) + log_q;
+    if (std::log(rng_.unif()) < log_acc) {
+      BBox b = bbox_union(P::footprint(cur, W_, H_), fp);
+      tile_.reset_tile(b);
+      timed(TIME_RASTER, [&] { re_render(tile_, b, j, &prop); });
+      const double dsse = timed(TIME_SSE, [&] { return delta_sse(b); });
+      ScopedNs timer(stats_.ns[TIME_COMMIT]);
+      stats_.moves.accepted[MOVE_JITTER]++;
+      keep_best(dsse);
+      update_prim(j, prop);
+      commit(b, dsse);
+    }
+  }
+
+  // Layer SSE change of slot j replaced by p, and the capped MALA drift at p
+  double mala_drift(const Params& p, const BBox& region, double beta,
+                    const double* sd, double* mu) const {
+    enum { NF = P::NFIELDS };
+    double grad[NF + 3], lpg[NF];
+    const BBox b = bbox_intersect(P::footprint(p, W_, H_), region);
+    const double d = bbox_empty(b) ? 0.0
+      : composite_layer_grad<P>(under_, mult_, without_, target_, p, b, grad);
+    if (bbox_empty(b)) std::fill(grad, grad + NF + 3, 0.0);
+    P::log_prior_grad(p, lpg);
+    for (int f = 0; f < NF + 3; f++) {
+      const double g = (f < NF ? lpg[f] : 0.0) - beta * grad[f];
+      const double m = 0.5 * cfg_.mala_step * sd[f] * sd[f] * g;
+      mu[f] = std::max(-sd[f], std::min(sd[f], m));
+    }
+    return d;
+  }
+
+  // Fields then colours of p, and back
+  static void mala_vec(const Params& p, double* v) {
+    P::get_fields(p, v);
+    for (int c = 0; c < 3; c++) v[P::NFIELDS + c] = p.col[c];
+  }
+
+  static Params mala_params(const Params& like, const double* v) {
+    Params p = like;
+    P::set_fields(p, v);
+    for (int c = 0; c < 3; c++) p.col[c] = v[P::NFIELDS + c];
+    return p;
+  }
+
+  // Layers around slot j over b for composite_layer_delta: the primitives
+  // below j, the transmittance of those above it (drawn in black over white)
+  // and everything but j. They cover b grown to whole multiscale cells, for
+  // the cell terms of the candidates.
+  void render_layers(const BBox& region, int j) {
+    const BBox b = target_.loss().region(region);
+    under_.reset_tile(b);
+    mult_.reset_tile(b);
+    without_.reset_tile(b);
+    under_.fill(b, 1.0f);
+    mult_.fill(b, 1.0f);
+    without_.fill(b, 1.0f);
+    const unsigned long long oj = store_.order(j);
+    index_.query(b, hits_);
+    sort_paint_order(hits_);
+    for (size_t h = 0; h < hits_.size(); h++) {
+      const int id = hits_[h];
+      if (id == j) continue;
+      Params p = store_.get(id);
+      composite_clipped<P>(without_, p, b);
+      if (store_.order(id) < oj) {
+        composite_clipped<P>(under_, p, b);
+      } else {
+        p.col[0] = p.col[1] = p.col[2] = 0.0;
+        composite_clipped<P>(mult_, p, b);
+      }
+    }
+  }
+
+  // log pi of slot j replaced by p, up to a constant shared by all candidates
+  double layer_weight(const Params& p, const BBox& region, double beta) const {
+    const double lp = P::log_prior(p, W_, H_);
+    if (!std::isfinite(lp)) return R_NegInf;
+    const BBox b = bbox_intersect(P::footprint(p, W_, H_), region);
+    if (bbox_empty(b)) return lp;
+    return lp - beta * composite_layer_delta<P>(under_, mult_, without_, target_, p, b);
+  }
+
+  static double max_of(const std::vector<double>& v) {
+    return *std::max_element(v.begin(), v.end());
+  }
+
+  static double log_sum_exp(const std::vector<double>& v) {
+    const double m = max_of(v);
+    if (!std::isfinite(m)) return m;
+    double s = 0.0;
+    for (size_t i = 0; i < v.size(); i++) s += std::exp(v[i] - m);
+    return m + std::log(s);
+  }
+
+  // Swap: exchange the paint order of a random primitive j and its nearest
+  // overlapping (by footprint) neighbour k above or below it. The stacking
+  // only changes where j meets k, or where k meets a primitive m stacked
+  // between them (no such m overlaps j, by the choice of k), so only that
+  // region is redrawn. The reverse move pairs k with j the same way, so the
+  // proposal is symmetric.
+  void move_swap(double beta) {
+    const int K = store_.size();
+    if (K < 2) return;
+    const int j = pick_index(K);
+    const bool up = rng_.unif() < 0.5;
+    const BBox fj = P::footprint(store_.get(j), W_, H_);
+    const unsigned long long oj = store_.order(j);
+
+    int k = -1;
+    index_.query(fj, hits_);
+    for (size_t h = 0; h < hits_.size(); h++) {
+      const int id = hits_[h];
+      const unsigned long long o = store_.order(id);
+      if (id == j || (up ? o < oj : o > oj)) continue;
+      if (k >= 0 && (up ? o > store_.order(k) : o < store_.order(k))) continue;
+      if (bbox_empty(bbox_intersect(P::footprint(store_.get(id), W_, H_), fj))) continue;
+      k = id;
+    }
+    if (k < 0) return;
+
+    const BBox fk = P::footprint(store_.get(k), W_, H_);
+    const unsigned long long ok = store_.order(k);
+    const unsigned long long lo = std::min(oj, ok), hi = std::max(oj, ok);
+    BBox region = bbox_intersect(fj, fk);
+    index_.query(fk, hits_);
+    for (size_t h = 0; h < hits_.size(); h++) {
+      const unsigned long long o = store_.order(hits_[h]);
+      if (o <= lo || o >= hi) continue;
+      BBox r = bbox_intersect(P::footprint(store_.get(hits_[h]), W_, H_), fk);
+      if (!bbox_empty(r)) region = bbox_union(region, r);
+    }
+
+    stats_.bbox(region);
+    store_.set_order(j, ok);
+    store_.set_order(k, oj);
+    tile_.reset_tile(region);
+    timed(TIME_RASTER, [&] { re_render(tile_, region, -1, NULL); });
+    store_.set_order(j, oj);
+    store_.set_order(k, ok);
+
+    const double dsse = timed(TIME_SSE, [&] { return delta_sse(region); });
+    if (std::log(rng_.unif()) < -beta * dsse) {
+      ScopedNs timer(stats_.ns[TIME_COMMIT]);
+      stats_.moves.accepted[MOVE_SWAP]++;
+      keep_best(dsse);
+      set_order(j, ok);
+      set_order(k, oj);
+      commit(region, dsse);
+    }
+  }
+
+  // Tile-parallel sweep: cut the canvas into tile_size tiles, on a grid with
+  // a random offset so the tile boundaries move between sweeps, and run
+  // tile_moves proposals in every tile at once (TileTask). A proposal that
+  // stays inside its tile cannot affect or see any other tile, so each tile
+  // is an ordinary MH chain over its own primitives; primitives straddling a
+  // boundary are left to the regular moves. The accepted changes of all
+  // tiles are applied afterwards in one batch. Under the multiscale loss the
+  // grid keeps to whole coarsest cells, so no cell term spans two tiles.
+  void tile_sweep(double beta) {
+    const int T = cfg_.tile_size, C = target_.loss().cell();
+    int ox = pick_index(T), oy = pick_index(T);
+    ox -= ox % C;
+    oy -= oy % C;
+    std::vector<BBox> tiles;
+    for (int y0 = 1 - oy; y0 <= H_; y0 += T)
+      for (int x0 = 1 - ox; x0 <= W_; x0 += T)
+        tiles.push_back(bbox_intersect(BBox{ x0, x0 + T - 1, y0, y0 + T - 1 }, full_));
+    const int n = (int)tiles.size();
+
+    const unsigned long long base = next_order_;
+    if ((int)tasks_.size() < n) tasks_.resize(n);
+    for (int i = 0; i < n; i++) {
+      TileTask<P>& task = tasks_[i];
+      task.reset(tiles[i], draw_seed(rng_), base + i, n);
+      index_.query(tiles[i], hits_);
+      sort_paint_order(hits_);
+      for (size_t h = 0; h < hits_.size(); h++) {
+        const Params p = store_.get(hits_[h]);
+        task.add(p, P::footprint(p, W_, H_), store_.order(hits_[h]), hits_[h]);
+      }
+    }
+
+    const int K0 = K();
+    pool_.run(n, [&](int i) {
+      tasks_[i].run(target_, canvas_, cfg_, beta, K0, cfg_.tile_moves);
+    });
+
+    double dsse = 0.0;
+    int max_births = 0;
+    bool any = false;
+    for (int i = 0; i < n; i++) {
+      stats_.tile_moves.add(tasks_[i].counts());
+      dsse += tasks_[i].dsse();
+      max_births = std::max(max_births, tasks_[i].births());
+      any = any || !bbox_empty(tasks_[i].dirty());
+    }
+    if (!any) return;
+
+    keep_best(dsse);
+    std::vector<int> dead;
+    for (int i = 0; i < n; i++) {
+      const std::vector<typename TileTask<P>::Item>& items = tasks_[i].items();
+      for (size_t k = 0; k < items.size(); k++) {
+        const typename TileTask<P>::Item& it = items[k];
+        if (it.slot < 0) {
+          if (it.alive) add_prim(it.p, it.order);
+        } else if (!it.alive) {
+          dead.push_back(it.slot);
+        } else if (it.changed) {
+          update_prim(it.slot, it.p);
+        }
+      }
+    }
+    // descending, so each swap-remove only moves a slot that stays
+    std::sort(dead.begin(), dead.end(), std::greater<int>());
+    for (size_t k = 0; k < dead.size(); k++) remove_prim(dead[k]);
+    next_order_ = base + (unsigned long long)n * max_births;
+
+    for (int i = 0; i < n; i++) {
+      const BBox& b = tasks_[i].dirty();
+      if (bbox_empty(b)) continue;
+      canvas_.copy_from(tasks_[i].canvas(), b);
+      if (cfg_.datadriven_birth) residual_.update(target_, canvas_, b);
+    }
+    sse_.add(dsse);
+    track_best();
+  }
+
+  const std::shared_ptr<const TargetImage> target_ptr_;
+  const TargetImage& target_;
+  const int H_, W_;
+  SamplerConfig cfg_;  // prob_moves and jitter are retuned during burn-in
+  JitterScales jitter0_;   // configured jitter, the base of the tuned scales
+  MoveAdapter adapt_;
+  Rng rng_;
+  double p_total_;               // sum of prob_moves
+  BBox full_;
+
+  Canvas canvas_;
+  Canvas tile_;                  // proposal tile covering the proposal bbox
+  ResidualTree residual_;        // birth seed sampler, kept in sync on commit
+  PrimitiveStore<P> store_;     // unordered slots with a paint-order key each
+  TileIndex index_;
+  unsigned long long next_order_;
+  TraceWriter<P>* trace_;        // accepted-move trace, not owned (set_trace)
+  SamplerStats stats_;
+  StatsLog* stats_log_;          // not owned (set_stats_log)
+  double run_seconds_;           // wall time of the last run()
+  std::vector<int> hits_;        // index query scratch
+  Canvas under_, mult_, without_;  // multiple-try jitter layers (render_layers)
+  std::vector<Params> tries_;    // multiple-try candidates, then references
+  std::vector<double> lw_;       // their log weights
+
+  KahanSum sse_;                 // running SSE of canvas_
+  std::vector<TileTask<P> > tasks_;  // tile sweep state, reused between sweeps
+  ThreadPool pool_;              // tile sweep workers, parked between sweeps
+
+  int iter_;
+
+  bool at_best_;                  // current state is the best state
+  PrimitiveStore<P> best_store_;  // best state, valid when !at_best_
+  mutable Canvas best_canvas_;    // lazily rendered from best_store_
+  mutable bool best_canvas_valid_;
+  double best_sse_;
+  int best_iter_;
+};
+
+#endif
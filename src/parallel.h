@@ -0,0 +1,148 @@
+// parallel.h
+// Minimal fork-join helpers for the samplers' worker threads: parallel_for()
+// for one-off loops, ThreadPool for loops repeated many times a run. Tasks
+// must not touch R (allocation, RNG, output); anything they throw is
+// rethrown on the calling thread once every worker has finished.
+#ifndef MCMCPAINTER_PARALLEL_H
+#define MCMCPAINTER_PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Worker count for a request of n_threads (<= 0: one per core), at most n_tasks
+inline int worker_count(int n_threads, int n_tasks) {
+  if (n_threads <= 0) n_threads = (int)std::thread::hardware_concurrency();
+  return std::max(1, std::min(n_threads, n_tasks));
+}
+
+// fn(i) for i = 0 .. n_tasks-1, tasks handed out in index order
+template <class Fn>
+inline void parallel_for(int n_tasks, int n_threads, Fn fn) {
+  const int n_workers = worker_count(n_threads, n_tasks);
+  if (n_workers == 1) {
+    for (int i = 0; i < n_tasks; i++) fn(i);
+    return;
+  }
+
+  std::atomic<int> next(0);
+  std::vector<std::exception_ptr> err(n_workers);
+  std::vector<std::thread> workers;
+  for (int w = 0; w < n_workers; w++) {
+    workers.push_back(std::thread([&, w]() {
+      try {
+        for (int i = next++; i < n_tasks; i = next++) fn(i);
+      } catch (...) {
+        err[w] = std::current_exception();
+        next = n_tasks;
+      }
+    }));
+  }
+  for (size_t w = 0; w < workers.size(); w++) workers[w].join();
+  for (size_t w = 0; w < err.size(); w++)
+    if (err[w]) std::rethrow_exception(err[w]);
+}
+
+// Persistent workers for fork-join rounds, e.g. a sampler's tile sweeps or
+// tempering rounds: run() is parallel_for() without starting and joining
+// threads every call. The calling thread takes tasks too, so a pool of
+// size() workers keeps size() - 1 threads parked between rounds. One run()
+// at a time.
+class ThreadPool {
+public:
+  // n_threads as for parallel_for() (<= 0: one per core), at most max_tasks
+  explicit ThreadPool(int n_threads, int max_tasks = INT_MAX)
+    : size_(worker_count(n_threads, max_tasks)), fn_(NULL), n_tasks_(0), next_(0),
+      round_(0), busy_(0), stop_(false) {
+    for (int w = 1; w < size_; w++) threads_.push_back(std::thread([this]() { loop(); }));
+  }
+
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    start_.notify_all();
+    for (size_t w = 0; w < threads_.size(); w++) threads_[w].join();
+  }
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  int size() const { return size_; }
+
+  // fn(i) for i = 0 .. n_tasks-1, tasks handed out in index order
+  template <class Fn>
+  void run(int n_tasks, Fn fn) {
+    if (size_ == 1 || n_tasks <= 1) {
+      for (int i = 0; i < n_tasks; i++) fn(i);
+      return;
+    }
+    const std::function<void(int)> task(fn);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      fn_ = &task;
+      n_tasks_ = n_tasks;
+      next_ = 0;
+      err_ = std::exception_ptr();
+      busy_ = (int)threads_.size();
+      round_++;
+    }
+    start_.notify_all();
+    work();
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this]() { return busy_ == 0; });
+    fn_ = NULL;
+    if (err_) {
+      std::exception_ptr e = err_;
+      err_ = std::exception_ptr();
+      std::rethrow_exception(e);
+    }
+  }
+
+private:
+  void loop() {
+    unsigned long long seen = 0;
+    for (;;) {
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        start_.wait(lock, [&]() { return stop_ || round_ != seen; });
+        if (stop_) return;
+        seen = round_;
+      }
+      work();
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (--busy_ == 0) done_.notify_one();
+    }
+  }
+
+  void work() {
+    try {
+      for (int i = next_++; i < n_tasks_; i = next_++) (*fn_)(i);
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!err_) err_ = std::current_exception();
+      next_ = n_tasks_;
+    }
+  }
+
+  const int size_;
+  std::vector<std::thread> threads_;
+  std::mutex mutex_;
+  std::condition_variable start_, done_;
+  const std::function<void(int)>* fn_;  // this round's task, set by run()
+  int n_tasks_;
+  std::atomic<int> next_;
+  unsigned long long round_;
+  int busy_;                            // pool threads still in this round
+  bool stop_;
+  std::exception_ptr err_;
+};
+
+#endif
@@ -0,0 +1,314 @@
+// png_writer.h
+// Native snapshot output. encode_png() turns a canvas into an 8-bit RGB PNG
+// (zlib for the deflate stream and the chunk CRCs); PngStream writes one row
+// by row, for images too large to hold; SnapshotWriter moves the
+// encoding and the file write onto a background thread. write() only copies
+// the canvas into a pooled buffer and returns; at most `depth` snapshots are
+// pending before it blocks, and flush() / the destructor wait for the queue
+// to drain. The worker never touches R: failures are counted and reported by
+// flush() on the calling thread.
+#ifndef MCMCPAINTER_PNG_WRITER_H
+#define MCMCPAINTER_PNG_WRITER_H
+
+#include "canvas.h"
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <zlib.h>
+
+inline void png_put_u32(std::vector<unsigned char>& out, uint32_t v) {
+  out.push_back((unsigned char)(v >> 24));
+  out.push_back((unsigned char)(v >> 16));
+  out.push_back((unsigned char)(v >> 8));
+  out.push_back((unsigned char)v);
+}
+
+inline void png_chunk(std::vector<unsigned char>& out, const char* type,
+                      const unsigned char* data, size_t n) {
+  png_put_u32(out, (uint32_t)n);
+  const size_t start = out.size();
+  out.insert(out.end(), type, type + 4);
+  out.insert(out.end(), data, data + n);
+  png_put_u32(out, (uint32_t)crc32(0L, &out[start], (uInt)(n + 4)));
+}
+
+// One filtered scanline of W RGBA pixels into q (1 + 3 W bytes): 8-bit RGB
+// (v * 255 + 0.5, clamped to [0, 1] first) with the Sub filter
+inline void png_filter_row(const float* p, int W, unsigned char* q) {
+  *q++ = 1;  // Sub: each byte minus the one 3 to its left
+  unsigned char left[3] = { 0, 0, 0 };
+  for (int x = 0; x < W; x++, p += Canvas::CH)
+    for (int c = 0; c < 3; c++) {
+      const unsigned char v = (unsigned char)(clamp01(p[c]) * 255.0 + 0.5);
+      *q++ = (unsigned char)(v - left[c]);
+      left[c] = v;
+    }
+}
+
+inline void png_ihdr(std::vector<unsigned char>& ihdr, int W, int H) {
+  png_put_u32(ihdr, (uint32_t)W);
+  png_put_u32(ihdr, (uint32_t)H);
+  const unsigned char rest[5] = { 8, 2, 0, 0, 0 };  // 8-bit RGB, deflate, no interlace
+  ihdr.insert(ihdr.end(), rest, rest + 5);
+}
+
+static const unsigned char PNG_SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+
+// 8-bit RGB, each row with the Sub filter (png_filter_row); false if zlib fails
+inline bool encode_png(const Canvas& canvas, std::vector<unsigned char>& out,
+                       int level = Z_DEFAULT_COMPRESSION) {
+  const int H = canvas.H(), W = canvas.W();
+  const BBox r = canvas.bounds();
+  const size_t row_bytes = 1 + 3 * (size_t)W;
+  std::vector<unsigned char> raw(row_bytes * H);
+  for (int y = 0; y < H; y++) png_filter_row(canvas.px(r.ymin + y, r.xmin), W, &raw[row_bytes * y]);
+
+  uLongf zn = compressBound((uLong)raw.size());
+  std::vector<unsigned char> z(zn);
+  if (compress2(&z[0], &zn, &raw[0], (uLong)raw.size(), level) != Z_OK) return false;
+
+  std::vector<unsigned char> ihdr;
+  png_ihdr(ihdr, W, H);
+
+  out.assign(PNG_SIGNATURE, PNG_SIGNATURE + 8);
+  png_chunk(out, "IHDR", &ihdr[0], ihdr.size());
+  png_chunk(out, "IDAT", &z[0], zn);
+  png_chunk(out, "IEND", NULL, 0);
+  return true;
+}
+
+inline bool write_png(const Canvas& canvas, const std::string& path) {
+  std::vector<unsigned char> bytes;
+  if (!encode_png(canvas, bytes)) return false;
+  FILE* f = std::fopen(path.c_str(), "wb");
+  if (f == NULL) return false;
+  const bool ok = std::fwrite(&bytes[0], 1, bytes.size(), f) == bytes.size();
+  return std::fclose(f) == 0 && ok;
+}
+
+// A W x H PNG written as its rows arrive: each row is filtered as in
+// encode_png() and fed to one deflate stream, whose output leaves in IDAT
+// chunks of PNG_STREAM_CHUNK bytes. Memory is one row and one chunk,
+// whatever the image size. Not thread safe; rows go in top to bottom.
+enum { PNG_STREAM_CHUNK = 1 << 16 };
+
+class PngStream {
+public:
+  PngStream() : f_(NULL), z_open_(false), W_(0), rows_left_(0), bytes_(0) {}
+  ~PngStream() { abandon(); }
+
+  bool open(const std::string& path, int W, int H, int level = Z_DEFAULT_COMPRESSION) {
+    abandon();
+    f_ = std::fopen(path.c_str(), "wb");
+    if (f_ == NULL) return false;
+    std::memset(&z_, 0, sizeof(z_));
+    if (deflateInit(&z_, level) != Z_OK) return false;
+    z_open_ = true;
+    W_ = W;
+    rows_left_ = H;
+    row_.resize(1 + 3 * (size_t)W);
+    out_.resize(PNG_STREAM_CHUNK);
+    z_.next_out = &out_[0];
+    z_.avail_out = PNG_STREAM_CHUNK;
+    std::vector<unsigned char> ihdr;
+    png_ihdr(ihdr, W, H);
+    return put(PNG_SIGNATURE, 8) && chunk("IHDR", &ihdr[0], ihdr.size());
+  }
+
+  // Every row of canvas (a full canvas or a strip tile), top to bottom
+  bool write_rows(const Canvas& canvas) {
+    const BBox r = canvas.bounds();
+    if (canvas.W() != W_ || canvas.H() > rows_left_) return false;
+    for (int y = r.ymin; y <= r.ymax; y++) {
+      png_filter_row(canvas.px(y, r.xmin), W_, &row_[0]);
+      z_.next_in = &row_[0];
+      z_.avail_in = (uInt)row_.size();
+      if (!pump(Z_NO_FLUSH)) return false;
+    }
+    rows_left_ -= canvas.H();
+    return true;
+  }
+
+  // End the stream and close the file; true if every row arrived and the
+  // file is complete
+  bool finish() {
+    if (f_ == NULL) return false;
+    bool ok = rows_left_ == 0 && pump(Z_FINISH) && chunk("IEND", NULL, 0);
+    deflateEnd(&z_);
+    z_open_ = false;
+    ok = std::fclose(f_) == 0 && ok;
+    f_ = NULL;
+    return ok;
+  }
+
+  double bytes() const { return bytes_; }  // written so far
+
+private:
+  // Deflate the pending input; full output chunks (all with Z_FINISH) are
+  // written as IDAT
+  bool pump(int flush) {
+    for (;;) {
+      const int rc = deflate(&z_, flush);
+      if (rc == Z_STREAM_ERROR) return false;
+      const size_t n = PNG_STREAM_CHUNK - z_.avail_out;
+      if (z_.avail_out == 0 || (flush == Z_FINISH && n > 0)) {
+        if (!chunk("IDAT", &out_[0], n)) return false;
+        z_.next_out = &out_[0];
+        z_.avail_out = PNG_STREAM_CHUNK;
+      }
+      if (flush == Z_FINISH ? rc == Z_STREAM_END : z_.avail_in == 0 && z_.avail_out > 0)
+        return true;
+    }
+  }
+
+  bool put(const unsigned char* p, size_t n) {
+    if (n > 0 && std::fwrite(p, 1, n, f_) != n) return false;
+    bytes_ += n;
+    return true;
+  }
+
+  bool chunk(const char* type, const unsigned char* data, size_t n) {
+    std::vector<unsigned char> head;
+    png_put_u32(head, (uint32_t)n);
+    head.insert(head.end(), type, type + 4);
+    uLong crc = crc32(0L, (const Bytef*)type, 4);
+    if (n > 0) crc = crc32(crc, data, (uInt)n);
+    std::vector<unsigned char> tail;
+    png_put_u32(tail, (uint32_t)crc);
+    return put(&head[0], 8) && put(data, n) && put(&tail[0], 4);
+  }
+
+  void abandon() {
+    if (z_open_) deflateEnd(&z_);
+    z_open_ = false;
+    if (f_ != NULL) std::fclose(f_);
+    f_ = NULL;
+  }
+
+  FILE* f_;
+  z_stream z_;
+  bool z_open_;
+  int W_, rows_left_;
+  double bytes_;
+  std::vector<unsigned char> row_, out_;
+};
+
+class SnapshotWriter {
+public:
+  explicit SnapshotWriter(int depth = 4)
+    : depth_(std::max(1, depth)), pending_(0), failed_(0), stop_(false),
+      worker_(&SnapshotWriter::loop, this) {}
+
+  ~SnapshotWriter() {
+    {
+      std::unique_lock<std::mutex> lock(mu_);
+      stop_ = true;
+    }
+    wake_.notify_all();
+    worker_.join();  // drains the queue first
+  }
+
+  // Queue canvas for path; blocks while depth snapshots are pending
+  void write(const Canvas& canvas, const std::string& path) {
+    Job job;
+    {
+      std::unique_lock<std::mutex> lock(mu_);
+      done_.wait(lock, [this] { return pending_ < depth_; });
+      pending_++;
+      if (!pool_.empty()) {
+        job.canvas.swap(pool_.back());
+        pool_.pop_back();
+      }
+    }
+    try {
+      job.canvas = canvas;  // reuses the pooled allocation when the size matches
+      job.path = path;
+    } catch (...) {
+      std::unique_lock<std::mutex> lock(mu_);
+      pending_--;
+      done_.notify_all();
+      throw;
+    }
+    {
+      std::unique_lock<std::mutex> lock(mu_);
+      queue_.push_back(Job());
+      queue_.back().swap(job);
+    }
+    wake_.notify_one();
+  }
+
+  // Wait until every queued snapshot is on disk; returns the number of
+  // failed writes since the last flush, the first of them in first_failure
+  int flush(std::string* first_failure = NULL) {
+    std::unique_lock<std::mutex> lock(mu_);
+    done_.wait(lock, [this] { return pending_ == 0; });
+    const int n = failed_;
+    if (first_failure != NULL) *first_failure = first_failure_;
+    failed_ = 0;
+    first_failure_.clear();
+    return n;
+  }
+
+private:
+  struct Job {
+    Canvas canvas;
+    std::string path;
+    void swap(Job& o) {
+      canvas.swap(o.canvas);
+      path.swap(o.path);
+    }
+  };
+
+  void loop() {
+    std::unique_lock<std::mutex> lock(mu_);
+    for (;;) {
+      wake_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+      if (queue_.empty()) return;  // stop_ and drained
+      Job job;
+      job.swap(queue_.front());
+      queue_.pop_front();
+
+      lock.unlock();
+      const bool ok = write_png(job.canvas, job.path);
+      lock.lock();
+
+      if (!ok && failed_++ == 0) first_failure_ = job.path;
+      pool_.push_back(Canvas());
+      pool_.back().swap(job.canvas);
+      pending_--;
+      done_.notify_all();
+    }
+  }
+
+  const int depth_;
+  int pending_;  // queued or being written
+  int failed_;
+  std::string first_failure_;
+  bool stop_;
+  std::deque<Job> queue_;
+  std::vector<Canvas> pool_;  // canvases of finished jobs, for reuse
+  std::mutex mu_;
+  std::condition_variable wake_, done_;
+  std::thread worker_;  // last: started once the rest is initialised
+};
+
+// dir/iter_XXXXXX.png, the name the R snapshot callbacks use
+inline std::string snapshot_file(const std::string& dir, int iter) {
+  char name[32];
+  std::snprintf(name, sizeof(name), "iter_%06d.png", iter);
+  return dir + "/" + name;
+}
+
+// Drain w (if any) and turn failed writes into an R warning; main thread only
+inline void finish_snapshots(SnapshotWriter* w) {
+  if (w == NULL) return;
+  std::string first;
+  const int n = w->flush(&first);
+  if (n > 0) Rcpp::warning("%d snapshot(s) could not be written, first: %s", n, first.c_str());
+}
+
+#endif
@@ -0,0 +1,114 @@
+// raster.h
+// Scanline spans shared by the coverage kernels. Both primitives are
+// capsules: the points within R of a segment (a dot is a segment of length
+// zero). A capsule is convex, so the pixel centres of one row inside it form
+// a single run. The renderers composite only the run inside the outer
+// (zero-coverage) radius, and the kernels fill the run inside the inner
+// (full-coverage) radius without evaluating the distance field.
+#ifndef MCMCPAINTER_RASTER_H
+#define MCMCPAINTER_RASTER_H
+
+#include "simd.h"
+#include <algorithm>
+#include <cmath>
+
+class CapsuleSpans {
+public:
+  // Slack for float rounding in the kernels: the outer radius is widened and
+  // the inner one narrowed by this much, so pixels outside an outer run have
+  // exactly zero coverage and pixels of an inner run exactly full coverage
+  static constexpr double EPS = 0.01;
+
+  // r_in <= 0: no fully covered run
+  CapsuleSpans(double x1, double y1, double x2, double y2, double r_out, double r_in)
+    : x1_(x1), y1_(y1), x2_(x2), y2_(y2), r_out_(r_out + EPS), r_in_(r_in - EPS) {
+    const double vx = x2 - x1, vy = y2 - y1;
+    len_ = std::sqrt(vx * vx + vy * vy);
+    seg_ = len_ > 1e-9;
+    ux_ = seg_ ? vx / len_ : 1.0;
+    uy_ = seg_ ? vy / len_ : 0.0;
+    inv_ux_ = std::fabs(ux_) < 1e-12 ? 0.0 : 1.0 / ux_;
+    inv_uy_ = std::fabs(uy_) < 1e-12 ? 0.0 : -1.0 / uy_;
+    // the inner run lies in the band's chord, 2 r_in / |uy| wide; skip it
+    // when no whole VF_WIDTH block fits
+    solid_ = r_in_ > 0.0 && 2.0 * r_in_ >= VF_WIDTH * std::fabs(uy_);
+  }
+
+  // Pixels of row y that can have nonzero coverage; false if none
+  bool outer(int y, int& xmin, int& xmax) const {
+    double lo, hi;
+    return chord(r_out_, y - 0.5, lo, hi) && pixels(lo, hi, xmin, xmax);
+  }
+
+  // Pixels of row y with full coverage; xmin > xmax if none
+  void inner(int y, int& xmin, int& xmax) const {
+    double lo, hi;
+    if (!solid_ || !chord(r_in_, y - 0.5, lo, hi) || !pixels(lo, hi, xmin, xmax)) {
+      xmin = 1;
+      xmax = 0;
+    }
+  }
+
+private:
+  // x-interval of the line y = yc inside the disc of radius R at (cx, cy)
+  static bool disc(double cx, double cy, double R, double yc, double& lo, double& hi) {
+    const double dy = yc - cy;
+    const double h2 = R * R - dy * dy;
+    if (h2 < 0.0) return false;
+    const double h = std::sqrt(h2);
+    lo = cx - h;
+    hi = cx + h;
+    return true;
+  }
+
+  // Restrict [lo, hi] to the offsets dx with dlo <= dx * u + d0 <= dhi
+  // (inv_u = 1 / u, or 0 when u is negligible)
+  static bool slab(double inv_u, double d0, double dlo, double dhi, double& lo, double& hi) {
+    if (inv_u == 0.0) return d0 >= dlo && d0 <= dhi;
+    double a = (dlo - d0) * inv_u, b = (dhi - d0) * inv_u;
+    if (a > b) std::swap(a, b);
+    lo = std::max(lo, a);
+    hi = std::min(hi, b);
+    return lo <= hi;
+  }
+
+  static void join(bool& any, double a, double b, double& lo, double& hi) {
+    lo = any ? std::min(lo, a) : a;
+    hi = any ? std::max(hi, b) : b;
+    any = true;
+  }
+
+  // Row chord of the capsule: the union of the two end-cap chords and the
+  // chord of the rectangle between them
+  bool chord(double R, double yc, double& lo, double& hi) const {
+    if (R < 0.0) return false;
+    bool any = false;
+    double a, b;
+    if (disc(x1_, y1_, R, yc, a, b)) join(any, a, b, lo, hi);
+    if (seg_ && disc(x2_, y2_, R, yc, a, b)) join(any, a, b, lo, hi);
+    if (seg_) {
+      const double dy = yc - y1_;
+      a = -HUGE_VAL;
+      b = HUGE_VAL;
+      // along the segment, then across it; offsets from x1
+      if (slab(inv_ux_, dy * uy_, 0.0, len_, a, b) && slab(inv_uy_, dy * ux_, -R, R, a, b))
+        join(any, x1_ + a, x1_ + b, lo, hi);
+    }
+    return any;
+  }
+
+  // Pixels x whose centres (x - 0.5) lie in [lo, hi]
+  static bool pixels(double lo, double hi, int& xmin, int& xmax) {
+    xmin = (int)std::ceil(lo + 0.5);
+    xmax = (int)std::floor(hi + 0.5);
+    return xmin <= xmax;
+  }
+
+  double x1_, y1_, x2_, y2_;
+  double r_out_, r_in_;
+  double len_, ux_, uy_;
+  double inv_ux_, inv_uy_;  // 1 / ux, -1 / uy (the across-slab normal)
+  bool seg_, solid_;
+};
+
+#endif
@@ -0,0 +1,141 @@
+// residual_tree.h
+// Persistent residual-proportional seed sampler for data-driven births. The
+// per-pixel residual magnitude |target - canvas| (over RGB) is kept in a
+// Fenwick tree over row-major pixels, so a seed draw is O(log HW) and a
+// committed bbox b costs O(|b| log HW) instead of rescanning the image.
+// The tree can also cover just a sub-rectangle (a tile) of the canvas.
+// Under the weighted loss (loss.h) each magnitude is scaled by the pixel's
+// weight, so births are seeded where the loss is.
+#ifndef MCMCPAINTER_RESIDUAL_TREE_H
+#define MCMCPAINTER_RESIDUAL_TREE_H
+
+#include "canvas.h"
+#include "target_image.h"
+
+class ResidualTree {
+public:
+  ResidualTree() : x0_(1), y0_(1), H_(0), W_(0), total_(0.0), top_(0), updates_(0) {}
+
+  // O(HW) rebuild from scratch
+  void build(const TargetImage& target, const Canvas& canvas) {
+    BBox all = { 1, target.W(), 1, target.H() };
+    build(target, canvas, all);
+  }
+
+  // Same over region only (canvas may be a tile covering it)
+  void build(const TargetImage& target, const Canvas& canvas, const BBox& region) {
+    x0_ = region.xmin;
+    y0_ = region.ymin;
+    H_ = region.ymax - region.ymin + 1;
+    W_ = region.xmax - region.xmin + 1;
+    mag_.resize((size_t)H_ * W_);
+    for (int y = region.ymin; y <= region.ymax; y++) {
+      double* m = &mag_[(size_t)(y - y0_) * W_];
+      target_span_sum(target, y, x0_, W_, [&](const float* t, int x0, int n) {
+        const float* c = canvas.px(y, x0);
+        const float* w = target.loss().weights(y, x0);
+        double* mx = m + (x0 - x0_);
+        for (int k = 0; k < n; k++) {
+          mx[k] = residual(t + Canvas::CH * k, c + Canvas::CH * k);
+          if (w != NULL) mx[k] *= w[k];
+        }
+        return 0.0;
+      });
+    }
+    rebuild();
+  }
+
+  // Refresh the pixels of b (inside the region) after canvas changed there
+  void update(const TargetImage& target, const Canvas& canvas, const BBox& b) {
+    for (int y = b.ymin; y <= b.ymax; y++) {
+      const size_t row = (size_t)(y - y0_) * W_;
+      target_span_sum(target, y, b.xmin, b.xmax - b.xmin + 1, [&](const float* t, int x0, int n) {
+        const float* c = canvas.px(y, x0);
+        const float* w = target.loss().weights(y, x0);
+        for (int k = 0; k < n; k++, t += Canvas::CH, c += Canvas::CH) {
+          const size_t i = row + (x0 - x0_) + k;
+          const double m = w != NULL ? residual(t, c) * w[k] : residual(t, c);
+          if (m != mag_[i]) {
+            add(i, m - mag_[i]);
+            mag_[i] = m;
+          }
+        }
+        return 0.0;
+      });
+    }
+    // Incremental adds accumulate rounding; rebuild the sums now and then
+    if (++updates_ >= REBUILD_EVERY) rebuild();
+  }
+
+  double total() const { return total_; }
+
+  // Draw a seed pixel (1-based x0, y0) with probability proportional to the
+  // residual magnitude; uniform over the region when the canvas already matches
+  template <class Rng>
+  void sample(Rng& rng, double& x0, double& y0) const {
+    if (!(total_ > 1e-6)) {
+      x0 = rng.runif(x0_, x0_ + W_ - 1);
+      y0 = rng.runif(y0_, y0_ + H_ - 1);
+      return;
+    }
+    const size_t idx = find(rng.runif(0.0, total_));
+    y0 = (double)(idx / W_) + y0_;
+    x0 = (double)(idx % W_) + x0_;
+  }
+
+private:
+  enum { REBUILD_EVERY = 4096 };
+
+  static double residual(const float* t, const float* c) {
+    double sum = 0.0;
+    for (int k = 0; k < 3; k++) {
+      double diff = t[k] - c[k];
+      sum += diff * diff;
+    }
+    return std::sqrt(sum);
+  }
+
+  // O(N) Fenwick construction from mag_
+  void rebuild() {
+    const size_t n = mag_.size();
+    tree_.assign(n + 1, 0.0);
+    total_ = 0.0;
+    for (size_t i = 1; i <= n; i++) {
+      tree_[i] += mag_[i - 1];
+      total_ += mag_[i - 1];
+      const size_t j = i + (i & (~i + 1));
+      if (j <= n) tree_[j] += tree_[i];
+    }
+    top_ = 1;
+    while (top_ * 2 <= n) top_ *= 2;
+    updates_ = 0;
+  }
+
+  void add(size_t i, double d) {
+    total_ += d;
+    for (size_t k = i + 1; k < tree_.size(); k += k & (~k + 1)) tree_[k] += d;
+  }
+
+  // Smallest 0-based i with mag_[0] + ... + mag_[i] >= r
+  size_t find(double r) const {
+    const size_t n = mag_.size();
+    size_t pos = 0;
+    for (size_t step = top_; step > 0; step >>= 1) {
+      if (pos + step <= n && tree_[pos + step] < r) {
+        pos += step;
+        r -= tree_[pos];
+      }
+    }
+    return pos < n ? pos : n - 1;
+  }
+
+  int x0_, y0_;               // region origin
+  int H_, W_;                 // region size
+  std::vector<double> mag_;   // per-pixel residual magnitude, row-major
+  std::vector<double> tree_;  // Fenwick partial sums, 1-based
+  double total_;
+  size_t top_;                // highest power of two <= N
+  int updates_;
+};
+
+#endif
@@ -0,0 +1,189 @@
+// rng.h
+// Random number sources for the samplers. Policies and the engine are
+// templated on the generator so one code path serves both:
+//   NativeRng — xoshiro256++ with ziggurat normals; every chain, tile task
+//               and worker owns one, so it is safe off the main thread
+//   RRng      — R's own stream; main thread only. The per-call exports use
+//               it just to seed a NativeRng, so set.seed() still governs them
+// Independent streams come from jump(), which advances a generator by 2^128
+// draws: stream c of a seed is NativeRng(seed) jumped c times.
+#ifndef MCMCPAINTER_RNG_H
+#define MCMCPAINTER_RNG_H
+
+#include <Rcpp.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+struct RRng {
+  double unif() { return R::unif_rand(); }
+  double runif(double a, double b) { return R::runif(a, b); }
+  double rnorm(double mu, double sd) { return R::rnorm(mu, sd); }
+  double rbeta(double a, double b) { return R::rbeta(a, b); }
+};
+
+// 128-layer normal ziggurat tables (Marsaglia & Tsang 2000, in the form of
+// Doornik 2005): x[i] layer edges, r[i] = x[i+1] / x[i]
+struct ZigguratTables {
+  enum { N = 128 };
+  static constexpr double EDGE = 3.442619855899;  // start of the tail
+  double x[N + 1], r[N];
+
+  ZigguratTables() {
+    const double V = 9.91256303526217e-3;
+    double f = std::exp(-0.5 * EDGE * EDGE);
+    x[0] = V / f;  // bottom layer, including the tail
+    x[1] = EDGE;
+    x[N] = 0.0;
+    for (int i = 2; i < N; i++) {
+      x[i] = std::sqrt(-2.0 * std::log(V / x[i - 1] + f));
+      f = std::exp(-0.5 * x[i] * x[i]);
+    }
+    for (int i = 0; i < N; i++) r[i] = x[i + 1] / x[i];
+  }
+
+  static const ZigguratTables& get() {
+    static const ZigguratTables t;  // thread-safe one-time init
+    return t;
+  }
+};
+
+class NativeRng {
+public:
+  explicit NativeRng(uint64_t seed = 0) : zig_(&ZigguratTables::get()), nbuf_(NBUF) {
+    // splitmix64 expansion of the seed, never all zero
+    for (int k = 0; k < 4; k++) {
+      uint64_t z = (seed += 0x9e3779b97f4a7c15ULL);
+      z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+      z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+      s_[k] = z ^ (z >> 31);
+    }
+  }
+
+  uint64_t next() {
+    const uint64_t result = rotl(s_[0] + s_[3], 23) + s_[0];
+    const uint64_t t = s_[1] << 17;
+    s_[2] ^= s_[0];
+    s_[3] ^= s_[1];
+    s_[1] ^= s_[2];
+    s_[0] ^= s_[3];
+    s_[2] ^= t;
+    s_[3] = rotl(s_[3], 45);
+    return result;
+  }
+
+  // Advance 2^128 draws: the start of the next non-overlapping stream
+  void jump() {
+    static const uint64_t J[4] = { 0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL,
+                                   0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL };
+    uint64_t t[4] = { 0, 0, 0, 0 };
+    for (int i = 0; i < 4; i++)
+      for (int b = 0; b < 64; b++) {
+        if (J[i] & (1ULL << b))
+          for (int k = 0; k < 4; k++) t[k] ^= s_[k];
+        next();
+      }
+    for (int k = 0; k < 4; k++) s_[k] = t[k];
+    nbuf_ = NBUF;  // buffered normals belong to the old position
+  }
+
+  // Uniform on (0, 1), 53 random bits
+  double unif() { return ((double)(next() >> 11) + 0.5) * (1.0 / 9007199254740992.0); }
+  double runif(double a, double b) { return a + (b - a) * unif(); }
+
+  // Standard normals are generated NBUF at a time
+  double rnorm(double mu, double sd) {
+    if (nbuf_ == NBUF) refill();
+    return mu + sd * buf_[nbuf_++];
+  }
+
+  // Marsaglia-Tsang; shape < 1 by the u^(1/a) boost
+  double rgamma(double a) {
+    if (a < 1.0) return rgamma(a + 1.0) * std::pow(unif(), 1.0 / a);
+    const double d = a - 1.0 / 3.0, c = 1.0 / std::sqrt(9.0 * d);
+    for (;;) {
+      double x, v;
+      do {
+        x = rnorm(0.0, 1.0);
+        v = 1.0 + c * x;
+      } while (v <= 0.0);
+      v = v * v * v;
+      const double u = unif();
+      if (u < 1.0 - 0.0331 * x * x * x * x) return d * v;
+      if (std::log(u) < 0.5 * x * x + d * (1.0 - v + std::log(v))) return d * v;
+    }
+  }
+
+  // Small integer shapes (the alpha priors) as the a-th smallest of a+b-1
+  // uniforms; otherwise from two gammas
+  double rbeta(double a, double b) {
+    const int n = (int)(a + b) - 1;
+    if (a == std::floor(a) && b == std::floor(b) && a >= 1.0 && b >= 1.0 && n <= 16) {
+      double u[16];
+      for (int i = 0; i < n; i++) u[i] = unif();
+      std::nth_element(u, u + (int)a - 1, u + n);
+      return u[(int)a - 1];
+    }
+    const double x = rgamma(a), y = rgamma(b);
+    return x / (x + y);
+  }
+
+  // Save or load the generator state, buffered normals included
+  template <class Ar>
+  void checkpoint(Ar& ar) {
+    ar.raw(s_, sizeof(s_));
+    ar.pod(nbuf_);
+    ar.raw(buf_, sizeof(buf_));
+    if (nbuf_ < 0 || nbuf_ > NBUF) Rcpp::stop("checkpoint is corrupt (rng)");
+  }
+
+private:
+  enum { NBUF = 64 };
+
+  static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+  double normal() {
+    const ZigguratTables& z = *zig_;
+    for (;;) {
+      const uint64_t bits = next();
+      const double u = 2.0 * (((double)(bits >> 11) + 0.5) * (1.0 / 9007199254740992.0)) - 1.0;
+      const int i = (int)(bits & 0x7F);  // layer from the low bits, independent of u
+      if (std::fabs(u) < z.r[i]) return u * z.x[i];
+      if (i == 0) return tail(u < 0.0);
+      const double x = u * z.x[i];
+      const double f0 = std::exp(-0.5 * (z.x[i] * z.x[i] - x * x));
+      const double f1 = std::exp(-0.5 * (z.x[i + 1] * z.x[i + 1] - x * x));
+      if (f1 + unif() * (f0 - f1) < 1.0) return x;
+    }
+  }
+
+  double tail(bool negative) {
+    const double r = ZigguratTables::EDGE;
+    double x, y;
+    do {
+      x = std::log(unif()) / r;
+      y = std::log(unif());
+    } while (-2.0 * y < x * x);
+    return negative ? x - r : r - x;
+  }
+
+  void refill() {
+    for (int k = 0; k < NBUF; k++) buf_[k] = normal();
+    nbuf_ = 0;
+  }
+
+  uint64_t s_[4];
+  const ZigguratTables* zig_;
+  int nbuf_;  // next unused entry of buf_
+  double buf_[NBUF];
+};
+
+// 64-bit seed for a NativeRng, drawn from another stream
+template <class Rng>
+inline uint64_t draw_seed(Rng& rng) {
+  const uint64_t hi = (uint64_t)(rng.unif() * 4294967296.0);
+  const uint64_t lo = (uint64_t)(rng.unif() * 4294967296.0);
+  return (hi << 32) | lo;
+}
+
+#endif
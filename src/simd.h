@@ -0,0 +1,455 @@
+// simd.h
+// Minimal float SIMD layer for the pixel kernels. One path is picked at
+// compile time: AVX2 (8 lanes), SSE2 (4 lanes, always on x86-64), NEON on
+// AArch64 (4 lanes), else plain scalar (also forced by -DMCMCPAINTER_NO_SIMD).
+// Kernels written against vf produce the same per-lane arithmetic on every
+// path.
+//
+// The RGBA row kernels (blend, SSE, SSE delta and their weighted forms, the
+// fused blend + delta and the layered score) work on the interleaved float
+// canvas of canvas.h: 4 floats per pixel, 16-byte aligned.
+#ifndef MCMCPAINTER_SIMD_H
+#define MCMCPAINTER_SIMD_H
+
+#include <cstddef>
+#include <cmath>
+
+#if defined(MCMCPAINTER_NO_SIMD)
+#elif defined(__AVX2__)
+#include <immintrin.h>
+#define MCMCPAINTER_SIMD_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define MCMCPAINTER_SIMD_SSE2 1
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define MCMCPAINTER_SIMD_NEON 1
+#endif
+
+// ---- wide float vector ----
+
+#if defined(MCMCPAINTER_SIMD_AVX2)
+
+typedef __m256 vf;
+typedef __m256 vmask;
+enum { VF_WIDTH = 8 };
+inline vf vf_set1(float v) { return _mm256_set1_ps(v); }
+inline vf vf_iota() { return _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7); }
+inline void vf_storeu(float* p, vf a) { _mm256_storeu_ps(p, a); }
+inline vf vf_add(vf a, vf b) { return _mm256_add_ps(a, b); }
+inline vf vf_sub(vf a, vf b) { return _mm256_sub_ps(a, b); }
+inline vf vf_mul(vf a, vf b) { return _mm256_mul_ps(a, b); }
+inline vf vf_min(vf a, vf b) { return _mm256_min_ps(a, b); }
+inline vf vf_max(vf a, vf b) { return _mm256_max_ps(a, b); }
+inline vf vf_sqrt(vf a) { return _mm256_sqrt_ps(a); }
+inline vmask vf_le(vf a, vf b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+inline vf vf_select(vmask m, vf t, vf f) { return _mm256_blendv_ps(f, t, m); }
+
+#elif defined(MCMCPAINTER_SIMD_SSE2)
+
+typedef __m128 vf;
+typedef __m128 vmask;
+enum { VF_WIDTH = 4 };
+inline vf vf_set1(float v) { return _mm_set1_ps(v); }
+inline vf vf_iota() { return _mm_setr_ps(0, 1, 2, 3); }
+inline void vf_storeu(float* p, vf a) { _mm_storeu_ps(p, a); }
+inline vf vf_add(vf a, vf b) { return _mm_add_ps(a, b); }
+inline vf vf_sub(vf a, vf b) { return _mm_sub_ps(a, b); }
+inline vf vf_mul(vf a, vf b) { return _mm_mul_ps(a, b); }
+inline vf vf_min(vf a, vf b) { return _mm_min_ps(a, b); }
+inline vf vf_max(vf a, vf b) { return _mm_max_ps(a, b); }
+inline vf vf_sqrt(vf a) { return _mm_sqrt_ps(a); }
+inline vmask vf_le(vf a, vf b) { return _mm_cmple_ps(a, b); }
+inline vf vf_select(vmask m, vf t, vf f) { return _mm_or_ps(_mm_and_ps(m, t), _mm_andnot_ps(m, f)); }
+
+#elif defined(MCMCPAINTER_SIMD_NEON)
+
+typedef float32x4_t vf;
+typedef uint32x4_t vmask;
+enum { VF_WIDTH = 4 };
+inline vf vf_set1(float v) { return vdupq_n_f32(v); }
+inline vf vf_iota() { static const float i[4] = { 0, 1, 2, 3 }; return vld1q_f32(i); }
+inline void vf_storeu(float* p, vf a) { vst1q_f32(p, a); }
+inline vf vf_add(vf a, vf b) { return vaddq_f32(a, b); }
+inline vf vf_sub(vf a, vf b) { return vsubq_f32(a, b); }
+inline vf vf_mul(vf a, vf b) { return vmulq_f32(a, b); }
+inline vf vf_min(vf a, vf b) { return vminq_f32(a, b); }
+inline vf vf_max(vf a, vf b) { return vmaxq_f32(a, b); }
+inline vf vf_sqrt(vf a) { return vsqrtq_f32(a); }
+inline vmask vf_le(vf a, vf b) { return vcleq_f32(a, b); }
+inline vf vf_select(vmask m, vf t, vf f) { return vbslq_f32(m, t, f); }
+
+#else
+
+struct vf { float v; };
+typedef bool vmask;
+enum { VF_WIDTH = 1 };
+inline vf vf_set1(float v) { vf r = { v }; return r; }
+inline vf vf_iota() { return vf_set1(0.0f); }
+inline void vf_storeu(float* p, vf a) { *p = a.v; }
+inline vf vf_add(vf a, vf b) { return vf_set1(a.v + b.v); }
+inline vf vf_sub(vf a, vf b) { return vf_set1(a.v - b.v); }
+inline vf vf_mul(vf a, vf b) { return vf_set1(a.v * b.v); }
+inline vf vf_min(vf a, vf b) { return vf_set1(b.v < a.v ? b.v : a.v); }
+inline vf vf_max(vf a, vf b) { return vf_set1(b.v > a.v ? b.v : a.v); }
+inline vf vf_sqrt(vf a) { return vf_set1(std::sqrt(a.v)); }
+inline vmask vf_le(vf a, vf b) { return a.v <= b.v; }
+inline vf vf_select(vmask m, vf t, vf f) { return m ? t : f; }
+
+#endif
+
+inline vf vf_clamp01(vf a) { return vf_min(vf_max(a, vf_set1(0.0f)), vf_set1(1.0f)); }
+
+// ---- RGBA row kernels ----
+
+// px[i] += a[i] * (col - px[i]) for n interleaved RGBA pixels. col[3] should
+// be 1 so the alpha channel of an opaque canvas stays at 1.
+inline void blend_rgba_row(float* px, const float* a, int n, const float* col) {
+  int i = 0;
+#if defined(MCMCPAINTER_SIMD_AVX2)
+  const __m128 c4 = _mm_loadu_ps(col);
+  const __m256 c8 = _mm256_set_m128(c4, c4);
+  for (; i + 2 <= n; i += 2) {
+    float* p = px + 4 * (size_t)i;
+    const __m256 av = _mm256_set_m128(_mm_set1_ps(a[i + 1]), _mm_set1_ps(a[i]));
+    const __m256 d = _mm256_loadu_ps(p);
+    _mm256_storeu_ps(p, _mm256_add_ps(d, _mm256_mul_ps(av, _mm256_sub_ps(c8, d))));
+  }
+  for (; i < n; i++) {
+    float* p = px + 4 * (size_t)i;
+    const __m128 d = _mm_load_ps(p);
+    _mm_store_ps(p, _mm_add_ps(d, _mm_mul_ps(_mm_set1_ps(a[i]), _mm_sub_ps(c4, d))));
+  }
+#elif defined(MCMCPAINTER_SIMD_SSE2)
+  const __m128 c4 = _mm_loadu_ps(col);
+  for (; i < n; i++) {
+    float* p = px + 4 * (size_t)i;
+    const __m128 d = _mm_load_ps(p);
+    _mm_store_ps(p, _mm_add_ps(d, _mm_mul_ps(_mm_set1_ps(a[i]), _mm_sub_ps(c4, d))));
+  }
+#elif defined(MCMCPAINTER_SIMD_NEON)
+  const float32x4_t c4 = vld1q_f32(col);
+  for (; i < n; i++) {
+    float* p = px + 4 * (size_t)i;
+    const float32x4_t d = vld1q_f32(p);
+    vst1q_f32(p, vaddq_f32(d, vmulq_f32(vdupq_n_f32(a[i]), vsubq_f32(c4, d))));
+  }
+#else
+  for (; i < n; i++) {
+    float* p = px + 4 * (size_t)i;
+    for (int c = 0; c < 4; c++) p[c] = p[c] + a[i] * (col[c] - p[c]);
+  }
+#endif
+}
+
+// sum((t - c)^2) over n interleaved RGBA pixels, accumulated in double. The
+// alpha channel contributes nothing when both images are opaque.
+inline double sse_rgba_span(const float* t, const float* c, int n) {
+  double acc = 0.0;
+  int i = 0;
+#if defined(MCMCPAINTER_SIMD_AVX2)
+  __m256d s = _mm256_setzero_pd();
+  for (; i < n; i++) {
+    const __m128 d = _mm_sub_ps(_mm_load_ps(t + 4 * (size_t)i), _mm_load_ps(c + 4 * (size_t)i));
+    const __m256d dd = _mm256_cvtps_pd(d);
+    s = _mm256_add_pd(s, _mm256_mul_pd(dd, dd));
+  }
+  double buf[4];
+  _mm256_storeu_pd(buf, s);
+  acc = (buf[0] + buf[1]) + (buf[2] + buf[3]);
+#elif defined(MCMCPAINTER_SIMD_SSE2)
+  __m128d s0 = _mm_setzero_pd(), s1 = _mm_setzero_pd();
+  for (; i < n; i++) {
+    const __m128 d = _mm_sub_ps(_mm_load_ps(t + 4 * (size_t)i), _mm_load_ps(c + 4 * (size_t)i));
+    const __m128d lo = _mm_cvtps_pd(d);
+    const __m128d hi = _mm_cvtps_pd(_mm_movehl_ps(d, d));
+    s0 = _mm_add_pd(s0, _mm_mul_pd(lo, lo));
+    s1 = _mm_add_pd(s1, _mm_mul_pd(hi, hi));
+  }
+  double buf[4];
+  _mm_storeu_pd(buf, s0);
+  _mm_storeu_pd(buf + 2, s1);
+  acc = (buf[0] + buf[1]) + (buf[2] + buf[3]);
+#elif defined(MCMCPAINTER_SIMD_NEON)
+  float64x2_t s0 = vdupq_n_f64(0.0), s1 = vdupq_n_f64(0.0);
+  for (; i < n; i++) {
+    const float32x4_t d = vsubq_f32(vld1q_f32(t + 4 * (size_t)i), vld1q_f32(c + 4 * (size_t)i));
+    const float64x2_t lo = vcvt_f64_f32(vget_low_f32(d));
+    const float64x2_t hi = vcvt_high_f64_f32(d);
+    s0 = vaddq_f64(s0, vmulq_f64(lo, lo));
+    s1 = vaddq_f64(s1, vmulq_f64(hi, hi));
+  }
+  acc = (vgetq_lane_f64(s0, 0) + vgetq_lane_f64(s0, 1)) +
+        (vgetq_lane_f64(s1, 0) + vgetq_lane_f64(s1, 1));
+#else
+  for (; i < 4 * n; i++) {
+    const double d = (double)(t[i] - c[i]);
+    acc += d * d;
+  }
+#endif
+  return acc;
+}
+
+// sum((t - after)^2 - (t - before)^2) over n interleaved RGBA pixels
+inline double sse_delta_rgba_span(const float* t, const float* after,
+                                  const float* before, int n) {
+  double acc = 0.0;
+  int i = 0;
+#if defined(MCMCPAINTER_SIMD_AVX2)
+  __m256d s = _mm256_setzero_pd();
+  for (; i < n; i++) {
+    const __m128 tv = _mm_load_ps(t + 4 * (size_t)i);
+    const __m256d da = _mm256_cvtps_pd(_mm_sub_ps(tv, _mm_load_ps(after + 4 * (size_t)i)));
+    const __m256d db = _mm256_cvtps_pd(_mm_sub_ps(tv, _mm_load_ps(before + 4 * (size_t)i)));
+    s = _mm256_add_pd(s, _mm256_sub_pd(_mm256_mul_pd(da, da), _mm256_mul_pd(db, db)));
+  }
+  double buf[4];
+  _mm256_storeu_pd(buf, s);
+  acc = (buf[0] + buf[1]) + (buf[2] + buf[3]);
+#elif defined(MCMCPAINTER_SIMD_SSE2)
+  __m128d s0 = _mm_setzero_pd(), s1 = _mm_setzero_pd();
+  for (; i < n; i++) {
+    const __m128 tv = _mm_load_ps(t + 4 * (size_t)i);
+    const __m128 da = _mm_sub_ps(tv, _mm_load_ps(after + 4 * (size_t)i));
+    const __m128 db = _mm_sub_ps(tv, _mm_load_ps(before + 4 * (size_t)i));
+    const __m128d al = _mm_cvtps_pd(da), ah = _mm_cvtps_pd(_mm_movehl_ps(da, da));
+    const __m128d bl = _mm_cvtps_pd(db), bh = _mm_cvtps_pd(_mm_movehl_ps(db, db));
+    s0 = _mm_add_pd(s0, _mm_sub_pd(_mm_mul_pd(al, al), _mm_mul_pd(bl, bl)));
+    s1 = _mm_add_pd(s1, _mm_sub_pd(_mm_mul_pd(ah, ah), _mm_mul_pd(bh, bh)));
+  }
+  double buf[4];
+  _mm_storeu_pd(buf, s0);
+  _mm_storeu_pd(buf + 2, s1);
+  acc = (buf[0] + buf[1]) + (buf[2] + buf[3]);
+#elif defined(MCMCPAINTER_SIMD_NEON)
+  float64x2_t s0 = vdupq_n_f64(0.0), s1 = vdupq_n_f64(0.0);
+  for (; i < n; i++) {
+    const float32x4_t tv = vld1q_f32(t + 4 * (size_t)i);
+    const float32x4_t da = vsubq_f32(tv, vld1q_f32(after + 4 * (size_t)i));
+    const float32x4_t db = vsubq_f32(tv, vld1q_f32(before + 4 * (size_t)i));
+    const float64x2_t al = vcvt_f64_f32(vget_low_f32(da)), ah = vcvt_high_f64_f32(da);
+    const float64x2_t bl = vcvt_f64_f32(vget_low_f32(db)), bh = vcvt_high_f64_f32(db);
+    s0 = vaddq_f64(s0, vsubq_f64(vmulq_f64(al, al), vmulq_f64(bl, bl)));
+    s1 = vaddq_f64(s1, vsubq_f64(vmulq_f64(ah, ah), vmulq_f64(bh, bh)));
+  }
+  acc = (vgetq_lane_f64(s0, 0) + vgetq_lane_f64(s0, 1)) +
+        (vgetq_lane_f64(s1, 0) + vgetq_lane_f64(s1, 1));
+#else
+  for (; i < 4 * n; i++) {
+    const double da = (double)(t[i] - after[i]);
+    const double db = (double)(t[i] - before[i]);
+    acc += da * da - db * db;
+  }
+#endif
+  return acc;
+}
+
+// sum(w[i] * (t - c)^2) over n interleaved RGBA pixels, pixel i weighted by
+// w[i] (the weighted loss, loss.h)
+inline double sse_rgba_span_w(const float* t, const float* c, const float* w, int n) {
+  double acc = 0.0;
+  int i = 0;
+#if defined(MCMCPAINTER_SIMD_AVX2) || defined(MCMCPAINTER_SIMD_SSE2)
+  __m128d s0 = _mm_setzero_pd(), s1 = _mm_setzero_pd();
+  for (; i < n; i++) {
+    const __m128 d = _mm_sub_ps(_mm_load_ps(t + 4 * (size_t)i), _mm_load_ps(c + 4 * (size_t)i));
+    const __m128d lo = _mm_cvtps_pd(d), hi = _mm_cvtps_pd(_mm_movehl_ps(d, d));
+    const __m128d wv = _mm_set1_pd(w[i]);
+    s0 = _mm_add_pd(s0, _mm_mul_pd(wv, _mm_mul_pd(lo, lo)));
+    s1 = _mm_add_pd(s1, _mm_mul_pd(wv, _mm_mul_pd(hi, hi)));
+  }
+  double buf[4];
+  _mm_storeu_pd(buf, s0);
+  _mm_storeu_pd(buf + 2, s1);
+  acc = (buf[0] + buf[1]) + (buf[2] + buf[3]);
+#elif defined(MCMCPAINTER_SIMD_NEON)
+  float64x2_t s0 = vdupq_n_f64(0.0), s1 = vdupq_n_f64(0.0);
+  for (; i < n; i++) {
+    const float32x4_t d = vsubq_f32(vld1q_f32(t + 4 * (size_t)i), vld1q_f32(c + 4 * (size_t)i));
+    const float64x2_t lo = vcvt_f64_f32(vget_low_f32(d)), hi = vcvt_high_f64_f32(d);
+    const float64x2_t wv = vdupq_n_f64(w[i]);
+    s0 = vaddq_f64(s0, vmulq_f64(wv, vmulq_f64(lo, lo)));
+    s1 = vaddq_f64(s1, vmulq_f64(wv, vmulq_f64(hi, hi)));
+  }
+  acc = (vgetq_lane_f64(s0, 0) + vgetq_lane_f64(s0, 1)) +
+        (vgetq_lane_f64(s1, 0) + vgetq_lane_f64(s1, 1));
+#else
+  for (; i < n; i++) {
+    double s = 0.0;
+    for (int k = 4 * i; k < 4 * i + 4; k++) {
+      const double d = (double)(t[k] - c[k]);
+      s += d * d;
+    }
+    acc += w[i] * s;
+  }
+#endif
+  return acc;
+}
+
+// sum(w[i] * ((t - after)^2 - (t - before)^2)) over n interleaved RGBA pixels
+inline double sse_delta_rgba_span_w(const float* t, const float* after, const float* before,
+                                    const float* w, int n) {
+  double acc = 0.0;
+  int i = 0;
+#if defined(MCMCPAINTER_SIMD_AVX2) || defined(MCMCPAINTER_SIMD_SSE2)
+  __m128d s0 = _mm_setzero_pd(), s1 = _mm_setzero_pd();
+  for (; i < n; i++) {
+    const __m128 tv = _mm_load_ps(t + 4 * (size_t)i);
+    const __m128 da = _mm_sub_ps(tv, _mm_load_ps(after + 4 * (size_t)i));
+    const __m128 db = _mm_sub_ps(tv, _mm_load_ps(before + 4 * (size_t)i));
+    const __m128d al = _mm_cvtps_pd(da), ah = _mm_cvtps_pd(_mm_movehl_ps(da, da));
+    const __m128d bl = _mm_cvtps_pd(db), bh = _mm_cvtps_pd(_mm_movehl_ps(db, db));
+    const __m128d wv = _mm_set1_pd(w[i]);
+    s0 = _mm_add_pd(s0, _mm_mul_pd(wv, _mm_sub_pd(_mm_mul_pd(al, al), _mm_mul_pd(bl, bl))));
+    s1 = _mm_add_pd(s1, _mm_mul_pd(wv, _mm_sub_pd(_mm_mul_pd(ah, ah), _mm_mul_pd(bh, bh))));
+  }
+  double buf[4];
+  _mm_storeu_pd(buf, s0);
+  _mm_storeu_pd(buf + 2, s1);
+  acc = (buf[0] + buf[1]) + (buf[2] + buf[3]);
+#elif defined(MCMCPAINTER_SIMD_NEON)
+  float64x2_t s0 = vdupq_n_f64(0.0), s1 = vdupq_n_f64(0.0);
+  for (; i < n; i++) {
+    const float32x4_t tv = vld1q_f32(t + 4 * (size_t)i);
+    const float32x4_t da = vsubq_f32(tv, vld1q_f32(after + 4 * (size_t)i));
+    const float32x4_t db = vsubq_f32(tv, vld1q_f32(before + 4 * (size_t)i));
+    const float64x2_t al = vcvt_f64_f32(vget_low_f32(da)), ah = vcvt_high_f64_f32(da);
+    const float64x2_t bl = vcvt_f64_f32(vget_low_f32(db)), bh = vcvt_high_f64_f32(db);
+    const float64x2_t wv = vdupq_n_f64(w[i]);
+    s0 = vaddq_f64(s0, vmulq_f64(wv, vsubq_f64(vmulq_f64(al, al), vmulq_f64(bl, bl))));
+    s1 = vaddq_f64(s1, vmulq_f64(wv, vsubq_f64(vmulq_f64(ah, ah), vmulq_f64(bh, bh))));
+  }
+  acc = (vgetq_lane_f64(s0, 0) + vgetq_lane_f64(s0, 1)) +
+        (vgetq_lane_f64(s1, 0) + vgetq_lane_f64(s1, 1));
+#else
+  for (; i < n; i++) {
+    double s = 0.0;
+    for (int k = 4 * i; k < 4 * i + 4; k++) {
+      const double da = (double)(t[k] - after[k]);
+      const double db = (double)(t[k] - before[k]);
+      s += da * da - db * db;
+    }
+    acc += w[i] * s;
+  }
+#endif
+  return acc;
+}
+
+// Fused birth kernel: out = before blended with a[] and col (as in
+// blend_rgba_row), returning the SSE change against t, in one pass
+inline double blend_delta_rgba_row(const float* t, const float* before, float* out,
+                                   const float* a, int n, const float* col) {
+  double acc = 0.0;
+  int i = 0;
+#if defined(MCMCPAINTER_SIMD_AVX2) || defined(MCMCPAINTER_SIMD_SSE2)
+  const __m128 c4 = _mm_loadu_ps(col);
+  __m128d s0 = _mm_setzero_pd(), s1 = _mm_setzero_pd();
+  for (; i < n; i++) {
+    const size_t k = 4 * (size_t)i;
+    const __m128 tv = _mm_load_ps(t + k);
+    const __m128 d = _mm_load_ps(before + k);
+    const __m128 v = _mm_add_ps(d, _mm_mul_ps(_mm_set1_ps(a[i]), _mm_sub_ps(c4, d)));
+    _mm_store_ps(out + k, v);
+    const __m128 da = _mm_sub_ps(tv, v), db = _mm_sub_ps(tv, d);
+    const __m128d al = _mm_cvtps_pd(da), ah = _mm_cvtps_pd(_mm_movehl_ps(da, da));
+    const __m128d bl = _mm_cvtps_pd(db), bh = _mm_cvtps_pd(_mm_movehl_ps(db, db));
+    s0 = _mm_add_pd(s0, _mm_sub_pd(_mm_mul_pd(al, al), _mm_mul_pd(bl, bl)));
+    s1 = _mm_add_pd(s1, _mm_sub_pd(_mm_mul_pd(ah, ah), _mm_mul_pd(bh, bh)));
+  }
+  double buf[4];
+  _mm_storeu_pd(buf, s0);
+  _mm_storeu_pd(buf + 2, s1);
+  acc = (buf[0] + buf[1]) + (buf[2] + buf[3]);
+#elif defined(MCMCPAINTER_SIMD_NEON)
+  const float32x4_t c4 = vld1q_f32(col);
+  float64x2_t s0 = vdupq_n_f64(0.0), s1 = vdupq_n_f64(0.0);
+  for (; i < n; i++) {
+    const size_t k = 4 * (size_t)i;
+    const float32x4_t tv = vld1q_f32(t + k);
+    const float32x4_t d = vld1q_f32(before + k);
+    const float32x4_t v = vaddq_f32(d, vmulq_f32(vdupq_n_f32(a[i]), vsubq_f32(c4, d)));
+    vst1q_f32(out + k, v);
+    const float32x4_t da = vsubq_f32(tv, v), db = vsubq_f32(tv, d);
+    const float64x2_t al = vcvt_f64_f32(vget_low_f32(da)), ah = vcvt_high_f64_f32(da);
+    const float64x2_t bl = vcvt_f64_f32(vget_low_f32(db)), bh = vcvt_high_f64_f32(db);
+    s0 = vaddq_f64(s0, vsubq_f64(vmulq_f64(al, al), vmulq_f64(bl, bl)));
+    s1 = vaddq_f64(s1, vsubq_f64(vmulq_f64(ah, ah), vmulq_f64(bh, bh)));
+  }
+  acc = (vgetq_lane_f64(s0, 0) + vgetq_lane_f64(s0, 1)) +
+        (vgetq_lane_f64(s1, 0) + vgetq_lane_f64(s1, 1));
+#else
+  for (; i < n; i++) {
+    const size_t k = 4 * (size_t)i;
+    for (int c = 0; c < 4; c++) {
+      const float v = before[k + c] + a[i] * (col[c] - before[k + c]);
+      out[k + c] = v;
+      const double da = (double)(t[k + c] - v);
+      const double db = (double)(t[k + c] - before[k + c]);
+      acc += da * da - db * db;
+    }
+  }
+#endif
+  return acc;
+}
+
+// Layered scoring kernel: the pixel inserted at its paint position is
+// v = without + mult * a[i] * (col - under), where under is the render of
+// the layers below it, mult the transmittance of those above it (in every
+// channel) and without the render without it. Returns the SSE change of v
+// over without against t; nothing is written.
+inline double layer_delta_rgba_row(const float* t, const float* under, const float* mult,
+                                   const float* without, const float* a, int n,
+                                   const float* col) {
+  double acc = 0.0;
+  int i = 0;
+#if defined(MCMCPAINTER_SIMD_AVX2) || defined(MCMCPAINTER_SIMD_SSE2)
+  const __m128 c4 = _mm_loadu_ps(col);
+  __m128d s0 = _mm_setzero_pd(), s1 = _mm_setzero_pd();
+  for (; i < n; i++) {
+    const size_t k = 4 * (size_t)i;
+    const __m128 tv = _mm_load_ps(t + k);
+    const __m128 z = _mm_load_ps(without + k);
+    const __m128 g = _mm_mul_ps(_mm_load_ps(mult + k), _mm_set1_ps(a[i]));
+    const __m128 v = _mm_add_ps(z, _mm_mul_ps(g, _mm_sub_ps(c4, _mm_load_ps(under + k))));
+    const __m128 da = _mm_sub_ps(tv, v), db = _mm_sub_ps(tv, z);
+    const __m128d al = _mm_cvtps_pd(da), ah = _mm_cvtps_pd(_mm_movehl_ps(da, da));
+    const __m128d bl = _mm_cvtps_pd(db), bh = _mm_cvtps_pd(_mm_movehl_ps(db, db));
+    s0 = _mm_add_pd(s0, _mm_sub_pd(_mm_mul_pd(al, al), _mm_mul_pd(bl, bl)));
+    s1 = _mm_add_pd(s1, _mm_sub_pd(_mm_mul_pd(ah, ah), _mm_mul_pd(bh, bh)));
+  }
+  double buf[4];
+  _mm_storeu_pd(buf, s0);
+  _mm_storeu_pd(buf + 2, s1);
+  acc = (buf[0] + buf[1]) + (buf[2] + buf[3]);
+#elif defined(MCMCPAINTER_SIMD_NEON)
+  const float32x4_t c4 = vld1q_f32(col);
+  float64x2_t s0 = vdupq_n_f64(0.0), s1 = vdupq_n_f64(0.0);
+  for (; i < n; i++) {
+    const size_t k = 4 * (size_t)i;
+    const float32x4_t tv = vld1q_f32(t + k);
+    const float32x4_t z = vld1q_f32(without + k);
+    const float32x4_t g = vmulq_f32(vld1q_f32(mult + k), vdupq_n_f32(a[i]));
+    const float32x4_t v = vaddq_f32(z, vmulq_f32(g, vsubq_f32(c4, vld1q_f32(under + k))));
+    const float32x4_t da = vsubq_f32(tv, v), db = vsubq_f32(tv, z);
+    const float64x2_t al = vcvt_f64_f32(vget_low_f32(da)), ah = vcvt_high_f64_f32(da);
+    const float64x2_t bl = vcvt_f64_f32(vget_low_f32(db)), bh = vcvt_high_f64_f32(db);
+    s0 = vaddq_f64(s0, vsubq_f64(vmulq_f64(al, al), vmulq_f64(bl, bl)));
+    s1 = vaddq_f64(s1, vsubq_f64(vmulq_f64(ah, ah), vmulq_f64(bh, bh)));
+  }
+  acc = (vgetq_lane_f64(s0, 0) + vgetq_lane_f64(s0, 1)) +
+        (vgetq_lane_f64(s1, 0) + vgetq_lane_f64(s1, 1));
+#else
+  for (; i < n; i++) {
+    const size_t k = 4 * (size_t)i;
+    for (int c = 0; c < 4; c++) {
+      const float v = without[k + c] + mult[k + c] * a[i] * (col[c] - under[k + c]);
+      const double da = (double)(t[k + c] - v);
+      const double db = (double)(t[k + c] - without[k + c]);
+      acc += da * da - db * db;
+    }
+  }
+#endif
+  return acc;
+}
+
+#endif
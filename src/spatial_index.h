@@ -0,0 +1,106 @@
+// spatial_index.h
+// Uniform tile grid over primitive footprints. Each tile holds the ids of the
+// primitives whose bbox overlaps it, so a bbox query only looks at the
+// primitives in the overlapping tiles instead of scanning all K.
+#ifndef MCMCPAINTER_SPATIAL_INDEX_H
+#define MCMCPAINTER_SPATIAL_INDEX_H
+
+#include "painter_common.h"
+
+class TileIndex {
+public:
+  TileIndex(int H, int W, int tile_size = 32)
+    : tile_(tile_size), nx_((W + tile_size - 1) / tile_size),
+      ny_((H + tile_size - 1) / tile_size), bins_((size_t)nx_ * ny_), epoch_(0) {}
+
+  void clear() {
+    for (size_t i = 0; i < bins_.size(); i++) bins_[i].clear();
+  }
+
+  void insert(int id, const BBox& b) {
+    if (id >= (int)stamp_.size()) stamp_.resize(id + 1, 0);
+    int tx0, tx1, ty0, ty1;
+    if (!tiles(b, tx0, tx1, ty0, ty1)) return;
+    for (int ty = ty0; ty <= ty1; ty++)
+      for (int tx = tx0; tx <= tx1; tx++)
+        bins_[(size_t)ty * nx_ + tx].push_back(id);
+  }
+
+  void remove(int id, const BBox& b) {
+    int tx0, tx1, ty0, ty1;
+    if (!tiles(b, tx0, tx1, ty0, ty1)) return;
+    for (int ty = ty0; ty <= ty1; ty++)
+      for (int tx = tx0; tx <= tx1; tx++) {
+        std::vector<int>& bin = bins_[(size_t)ty * nx_ + tx];
+        for (size_t k = 0; k < bin.size(); k++) {
+          if (bin[k] == id) {
+            bin[k] = bin.back();
+            bin.pop_back();
+            break;
+          }
+        }
+      }
+  }
+
+  // Rename old_id to new_id in the tiles covered by b (used when the store
+  // moves its last slot into a freed one)
+  void relabel(int old_id, int new_id, const BBox& b) {
+    int tx0, tx1, ty0, ty1;
+    if (!tiles(b, tx0, tx1, ty0, ty1)) return;
+    for (int ty = ty0; ty <= ty1; ty++)
+      for (int tx = tx0; tx <= tx1; tx++) {
+        std::vector<int>& bin = bins_[(size_t)ty * nx_ + tx];
+        for (size_t k = 0; k < bin.size(); k++) {
+          if (bin[k] == old_id) {
+            bin[k] = new_id;
+            break;
+          }
+        }
+      }
+  }
+
+  void move(int id, const BBox& from, const BBox& to) {
+    remove(id, from);
+    insert(id, to);
+  }
+
+  // Ids of every primitive registered in a tile overlapping b, each once
+  // and in no particular order
+  void query(const BBox& b, std::vector<int>& out) {
+    out.clear();
+    int tx0, tx1, ty0, ty1;
+    if (!tiles(b, tx0, tx1, ty0, ty1)) return;
+    if (++epoch_ == 0) {
+      std::fill(stamp_.begin(), stamp_.end(), 0u);
+      epoch_ = 1;
+    }
+    for (int ty = ty0; ty <= ty1; ty++)
+      for (int tx = tx0; tx <= tx1; tx++) {
+        const std::vector<int>& bin = bins_[(size_t)ty * nx_ + tx];
+        for (size_t k = 0; k < bin.size(); k++) {
+          const int id = bin[k];
+          if (stamp_[id] != epoch_) {
+            stamp_[id] = epoch_;
+            out.push_back(id);
+          }
+        }
+      }
+  }
+
+private:
+  bool tiles(const BBox& b, int& tx0, int& tx1, int& ty0, int& ty1) const {
+    if (bbox_empty(b)) return false;
+    tx0 = std::max(0, (b.xmin - 1) / tile_);
+    tx1 = std::min(nx_ - 1, (b.xmax - 1) / tile_);
+    ty0 = std::max(0, (b.ymin - 1) / tile_);
+    ty1 = std::min(ny_ - 1, (b.ymax - 1) / tile_);
+    return tx0 <= tx1 && ty0 <= ty1;
+  }
+
+  int tile_, nx_, ny_;
+  std::vector<std::vector<int> > bins_;
+  std::vector<unsigned> stamp_;  // per-id query epoch, for de-duplication
+  unsigned epoch_;
+};
+
+#endif
@@ -0,0 +1,241 @@
+// stats.h
+// Run statistics of a sampler: proposal and acceptance counts per move type
+// (regular moves and tile-sweep moves apart), wall-clock nanoseconds spent
+// in the hot sections, the mean proposal bbox area and a periodic history
+// of K, SSE and throughput. Counting is a few integer adds per move and a
+// timer is two steady_clock reads, so the stats are always collected.
+//
+// Timer sections:
+//   raster  composite / re-render of proposal tiles (a birth's fused
+//           composite-and-delta kernel included), multiple-try layers
+//   sse     SSE deltas of re-rendered tiles, multiple-try scoring
+//   birth   birth proposals (residual-tree or prior draws)
+//   commit  applying accepted moves: store, index, canvas, residual tree
+//   tiles   whole tile-parallel sweeps (their moves are not timed apart)
+#ifndef MCMCPAINTER_STATS_H
+#define MCMCPAINTER_STATS_H
+
+#include "painter_common.h"
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+enum StatTimer { TIME_RASTER = 0, TIME_SSE, TIME_BIRTH, TIME_COMMIT, TIME_TILES, N_TIMERS };
+
+inline const char* stat_timer_name(int k) {
+  static const char* names[N_TIMERS] = { "raster", "sse", "birth", "commit", "tiles" };
+  return names[k];
+}
+
+enum MoveType { MOVE_BIRTH = 0, MOVE_DEATH = 1, MOVE_JITTER = 2, MOVE_SWAP = 3 };
+
+inline const char* move_name(int m) {
+  static const char* names[4] = { "birth", "death", "jitter", "swap" };
+  return names[m];
+}
+
+// Per move type (MoveType order): proposals made, proposals accepted
+struct MoveCounts {
+  long long proposed[4], accepted[4];
+
+  MoveCounts() { clear(); }
+  void clear() {
+    for (int m = 0; m < 4; m++) proposed[m] = accepted[m] = 0;
+  }
+  void add(const MoveCounts& o) {
+    for (int m = 0; m < 4; m++) {
+      proposed[m] += o.proposed[m];
+      accepted[m] += o.accepted[m];
+    }
+  }
+};
+
+inline long long stat_now_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Adds the lifetime of the scope to a nanosecond counter
+class ScopedNs {
+public:
+  explicit ScopedNs(long long& acc) : acc_(acc), t0_(stat_now_ns()) {}
+  ~ScopedNs() { acc_ += stat_now_ns() - t0_; }
+
+private:
+  long long& acc_;
+  const long long t0_;
+};
+
+struct SamplerStats {
+  MoveCounts moves;       // regular moves
+  MoveCounts tile_moves;  // moves inside tile sweeps
+  long long ns[N_TIMERS];
+  double area;            // summed pixel area of the scored proposal bboxes
+  long long area_n;
+
+  // history, one row per stats_every iterations
+  std::vector<int> hist_iter, hist_K;
+  std::vector<double> hist_sse, hist_beta, hist_seconds;
+
+  SamplerStats() { clear(); }
+
+  void clear() {
+    moves.clear();
+    tile_moves.clear();
+    for (int k = 0; k < N_TIMERS; k++) ns[k] = 0;
+    area = 0.0;
+    area_n = 0;
+    hist_iter.clear();
+    hist_K.clear();
+    hist_sse.clear();
+    hist_beta.clear();
+    hist_seconds.clear();
+  }
+
+  void bbox(const BBox& b) {
+    if (bbox_empty(b)) return;
+    area += (double)(b.xmax - b.xmin + 1) * (b.ymax - b.ymin + 1);
+    area_n++;
+  }
+
+  // Counters and timers of o added to these (the history is not merged)
+  void add(const SamplerStats& o) {
+    moves.add(o.moves);
+    tile_moves.add(o.tile_moves);
+    for (int k = 0; k < N_TIMERS; k++) ns[k] += o.ns[k];
+    area += o.area;
+    area_n += o.area_n;
+  }
+
+  void record(int iter, int K, double sse, double beta, double seconds) {
+    hist_iter.push_back(iter);
+    hist_K.push_back(K);
+    hist_sse.push_back(sse);
+    hist_beta.push_back(beta);
+    hist_seconds.push_back(seconds);
+  }
+};
+
+// Streams the history rows with the cumulative counters to a file as they
+// are recorded: CSV, or JSON lines (one object per row) when the name ends
+// in ".json" or ".jsonl". Main thread only; a failed open stops, a failed
+// write warns once at close().
+class StatsLog {
+public:
+  explicit StatsLog(const std::string& path)
+    : path_(path), f_(NULL), json_(false), failed_(false) {
+    if (path.empty()) return;
+    const size_t dot = path.find_last_of('.');
+    const std::string ext = dot == std::string::npos ? "" : path.substr(dot);
+    json_ = ext == ".json" || ext == ".jsonl";
+    f_ = std::fopen(path.c_str(), "w");
+    if (f_ == NULL) Rcpp::stop("cannot open stats file: " + path);
+    if (!json_) {
+      std::fprintf(f_, "iter,K,sse,beta,seconds,iters_per_sec");
+      for (int m = 0; m < 4; m++) std::fprintf(f_, ",%s_proposed,%s_accepted", move_name(m), move_name(m));
+      for (int m = 0; m < 4; m++) std::fprintf(f_, ",tile_%s_proposed,tile_%s_accepted", move_name(m), move_name(m));
+      for (int k = 0; k < N_TIMERS; k++) std::fprintf(f_, ",%s_ns", stat_timer_name(k));
+      std::fprintf(f_, ",mean_bbox_area\n");
+    }
+  }
+
+  ~StatsLog() {
+    if (f_ != NULL) std::fclose(f_);
+  }
+
+  // Latest history row of h with the counters of s; iters_per_sec since
+  // the previous row
+  void write(const SamplerStats& s, const SamplerStats& h) {
+    if (f_ == NULL || h.hist_iter.empty()) return;
+    const size_t r = h.hist_iter.size() - 1;
+    const double dt = h.hist_seconds[r] - (r > 0 ? h.hist_seconds[r - 1] : 0.0);
+    const int di = h.hist_iter[r] - (r > 0 ? h.hist_iter[r - 1] : 0);
+    const double ips = dt > 0.0 ? di / dt : 0.0;
+    const double area = s.area_n > 0 ? s.area / s.area_n : 0.0;
+    int n;
+    if (json_) {
+      std::fprintf(f_, "{\"iter\":%d,\"K\":%d,\"sse\":%.9g,\"beta\":%.9g,\"seconds\":%.6f,"
+                   "\"iters_per_sec\":%.3f", h.hist_iter[r], h.hist_K[r], h.hist_sse[r],
+                   h.hist_beta[r], h.hist_seconds[r], ips);
+      for (int t = 0; t < 2; t++) {
+        const MoveCounts& c = t == 0 ? s.moves : s.tile_moves;
+        std::fprintf(f_, ",\"%s\":{", t == 0 ? "moves" : "tile_moves");
+        for (int m = 0; m < 4; m++)
+          std::fprintf(f_, "%s\"%s\":[%lld,%lld]", m ? "," : "", move_name(m),
+                       c.proposed[m], c.accepted[m]);
+        std::fprintf(f_, "}");
+      }
+      std::fprintf(f_, ",\"ns\":{");
+      for (int k = 0; k < N_TIMERS; k++)
+        std::fprintf(f_, "%s\"%s\":%lld", k ? "," : "", stat_timer_name(k), s.ns[k]);
+      n = std::fprintf(f_, "},\"mean_bbox_area\":%.3f}\n", area);
+    } else {
+      std::fprintf(f_, "%d,%d,%.9g,%.9g,%.6f,%.3f", h.hist_iter[r], h.hist_K[r], h.hist_sse[r],
+                   h.hist_beta[r], h.hist_seconds[r], ips);
+      for (int m = 0; m < 4; m++) std::fprintf(f_, ",%lld,%lld", s.moves.proposed[m], s.moves.accepted[m]);
+      for (int m = 0; m < 4; m++)
+        std::fprintf(f_, ",%lld,%lld", s.tile_moves.proposed[m], s.tile_moves.accepted[m]);
+      for (int k = 0; k < N_TIMERS; k++) std::fprintf(f_, ",%lld", s.ns[k]);
+      n = std::fprintf(f_, ",%.3f\n", area);
+    }
+    if (n < 0) failed_ = true;
+  }
+
+  void close() {
+    if (f_ == NULL) return;
+    if (std::fclose(f_) != 0) failed_ = true;
+    f_ = NULL;
+    if (failed_) Rcpp::warning("stats file incomplete: %s", path_.c_str());
+  }
+
+private:
+  std::string path_;
+  FILE* f_;
+  bool json_, failed_;
+};
+
+// R form: moves (data frame), time_ns, mean_bbox_area, iterations, seconds,
+// iters_per_sec and the history (data frame). iter is the last iteration;
+// the run started at the first history row (0 without a history).
+inline Rcpp::List stats_to_list(const SamplerStats& s, const SamplerStats& hist,
+                                int iter, double seconds) {
+  using namespace Rcpp;
+  const int iters = iter - (hist.hist_iter.empty() ? 0 : hist.hist_iter[0]);
+  CharacterVector move(4);
+  NumericVector prop(4), acc(4), rate(4), tprop(4), tacc(4), trate(4);
+  for (int m = 0; m < 4; m++) {
+    move[m] = move_name(m);
+    prop[m] = (double)s.moves.proposed[m];
+    acc[m] = (double)s.moves.accepted[m];
+    rate[m] = prop[m] > 0 ? acc[m] / prop[m] : NA_REAL;
+    tprop[m] = (double)s.tile_moves.proposed[m];
+    tacc[m] = (double)s.tile_moves.accepted[m];
+    trate[m] = tprop[m] > 0 ? tacc[m] / tprop[m] : NA_REAL;
+  }
+  NumericVector ns(N_TIMERS);
+  CharacterVector ns_names(N_TIMERS);
+  for (int k = 0; k < N_TIMERS; k++) {
+    ns[k] = (double)s.ns[k];
+    ns_names[k] = stat_timer_name(k);
+  }
+  ns.names() = ns_names;
+  return List::create(
+    Named("moves") = DataFrame::create(
+      Named("move") = move, Named("proposed") = prop, Named("accepted") = acc,
+      Named("acceptance") = rate, Named("tile_proposed") = tprop,
+      Named("tile_accepted") = tacc, Named("tile_acceptance") = trate,
+      Named("stringsAsFactors") = false),
+    Named("time_ns") = ns,
+    Named("mean_bbox_area") = s.area_n > 0 ? s.area / s.area_n : NA_REAL,
+    Named("iterations") = iters,
+    Named("seconds") = seconds,
+    Named("iters_per_sec") = seconds > 0 ? iters / seconds : NA_REAL,
+    Named("history") = DataFrame::create(
+      Named("iter") = hist.hist_iter, Named("K") = hist.hist_K,
+      Named("sse") = hist.hist_sse, Named("beta") = hist.hist_beta,
+      Named("seconds") = hist.hist_seconds)
+  );
+}
+
+#endif
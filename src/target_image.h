@@ -0,0 +1,270 @@
+// target_image.h
+// Read-only target image of a sampler, stored at a selectable precision:
+//   float32  the interleaved RGBA float Canvas (16 bytes per pixel)
+//   float16  packed RGB IEEE half floats (6 bytes per pixel)
+//   uint8    packed RGB bytes, v = k / 255 (3 bytes per pixel)
+// Packed rows are decoded into float RGBA chunks on the fly, so every SSE
+// kernel still accumulates in float / double on the canvas layout. The
+// working canvas stays float32: it is rewritten by every accepted move and
+// the alpha-over layers would compound a per-layer rounding.
+//
+// Error bound: every stored channel is within e = max_error() of the input
+// (uint8 <= 1/510, float16 <= 2^-12 on [0, 1]), and for pixel values in
+// [0, 1] an SSE over N pixels differs from the exact-target SSE by at most
+// 6 e N (|(t' - c)^2 - (t - c)^2| <= 2 e per channel).
+//
+// The target also carries the data of the configured loss (loss.h); the
+// bbox kernels below score a canvas with that loss, the SSE by default.
+#ifndef MCMCPAINTER_TARGET_IMAGE_H
+#define MCMCPAINTER_TARGET_IMAGE_H
+
+#include "canvas.h"
+#include "loss.h"
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+enum StoragePrecision { STORE_FLOAT32 = 0, STORE_FLOAT16, STORE_UINT8 };
+
+inline int parse_precision(const std::string& s) {
+  if (s == "float32") return STORE_FLOAT32;
+  if (s == "float16") return STORE_FLOAT16;
+  if (s == "uint8") return STORE_UINT8;
+  Rcpp::stop("precision must be \"float32\", \"float16\" or \"uint8\"");
+  return STORE_FLOAT32;
+}
+
+inline const char* precision_name(int p) {
+  static const char* names[3] = { "float32", "float16", "uint8" };
+  return names[p];
+}
+
+// IEEE binary16 conversions (round to nearest even); finite inputs
+inline uint16_t float_to_half(float f) {
+  uint32_t x;
+  std::memcpy(&x, &f, 4);
+  const uint16_t sign = (uint16_t)((x >> 16) & 0x8000);
+  x &= 0x7fffffff;
+  if (x >= 0x477ff000) return sign | 0x7c00;  // rounds past the largest half
+  if (x < 0x38800000) {                       // half subnormal or zero
+    float a;
+    std::memcpy(&a, &x, 4);
+    return sign | (uint16_t)std::lrint(a * 16777216.0f);
+  }
+  x += 0xc8000fffu + ((x >> 13) & 1);  // rebias the exponent, round the mantissa
+  return sign | (uint16_t)(x >> 13);
+}
+
+inline float half_to_float(uint16_t h) {
+  const uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+  const uint32_t em = h & 0x7fff;
+  if (em < 0x0400) {  // subnormal or zero
+    const float v = em * (1.0f / 16777216.0f);
+    return sign ? -v : v;
+  }
+  const uint32_t x = sign | (em >= 0x7c00 ? 0x7f800000 | ((em & 0x3ff) << 13)
+                                          : (em << 13) + 0x38000000);
+  float f;
+  std::memcpy(&f, &x, 4);
+  return f;
+}
+
+// Pixels decoded per span() call of a packed target; matches the
+// coverage chunk of the composite kernels
+enum { TARGET_CHUNK = 256 };
+
+class TargetImage {
+public:
+  TargetImage() : prec_(STORE_FLOAT32), H_(0), W_(0), err_(0.0) {}
+
+  // From the R planar layout [H, W, 3] (see idx3)
+  TargetImage(const double* a, int H, int W, int precision = STORE_FLOAT32,
+              const LossConfig& loss = LossConfig())
+    : prec_(precision), H_(H), W_(W), err_(0.0), loss_(a, H, W, loss) {
+    if (prec_ == STORE_FLOAT32) {
+      f32_ = canvas_from_planar(a, H, W);
+      for (int y = 1; y <= H; y++)
+        for (int x = 1; x <= W; x++)
+          for (int c = 0; c < 3; c++)
+            err_ = std::max(err_, std::fabs(f32_.px(y, x)[c] - a[idx3(y, x, c, H, W)]));
+      return;
+    }
+    const size_t n = (size_t)H * W * 3;
+    if (prec_ == STORE_FLOAT16) f16_.resize(n);
+    else u8_.resize(n);
+    for (int y = 1; y <= H; y++)
+      for (int x = 1; x <= W; x++)
+        for (int c = 0; c < 3; c++) {
+          const double v = a[idx3(y, x, c, H, W)];
+          const size_t i = ((size_t)(y - 1) * W + (x - 1)) * 3 + c;
+          double back;
+          if (prec_ == STORE_FLOAT16) {
+            f16_[i] = float_to_half((float)v);
+            back = half_to_float(f16_[i]);
+          } else {
+            u8_[i] = (uint8_t)std::lrint(clamp01(v) * 255.0);
+            back = u8_table()[u8_[i]];
+          }
+          err_ = std::max(err_, std::fabs(back - v));
+        }
+  }
+
+  int H() const { return H_; }
+  int W() const { return W_; }
+  int precision() const { return prec_; }
+  bool packed() const { return prec_ != STORE_FLOAT32; }
+  const LossTarget& loss() const { return loss_; }
+
+  // Largest |stored - input| over all channels
+  double max_error() const { return err_; }
+
+  size_t bytes() const {
+    if (prec_ == STORE_FLOAT32) return (size_t)H_ * f32_.stride() * sizeof(float);
+    return prec_ == STORE_FLOAT16 ? f16_.size() * sizeof(uint16_t) : u8_.size();
+  }
+
+  // RGBA floats of pixels x .. x+n-1 of row y: the stored row for float32,
+  // else decoded into buf (n <= TARGET_CHUNK, 16-byte aligned)
+  const float* span(int y, int x, int n, float* buf) const {
+    if (prec_ == STORE_FLOAT32) return f32_.px(y, x);
+    const size_t i0 = ((size_t)(y - 1) * W_ + (x - 1)) * 3;
+    if (prec_ == STORE_FLOAT16) {
+      const float* lut = f16_table();
+      const uint16_t* s = &f16_[i0];
+      for (int k = 0; k < n; k++, s += 3) {
+        float* p = buf + Canvas::CH * k;
+        p[0] = lut[s[0]]; p[1] = lut[s[1]]; p[2] = lut[s[2]];
+        p[3] = 1.0f;
+      }
+    } else {
+      const float* lut = u8_table();
+      const uint8_t* s = &u8_[i0];
+      for (int k = 0; k < n; k++, s += 3) {
+        float* p = buf + Canvas::CH * k;
+        p[0] = lut[s[0]]; p[1] = lut[s[1]]; p[2] = lut[s[2]];
+        p[3] = 1.0f;
+      }
+    }
+    return buf;
+  }
+
+  // RGB of one pixel into rgb[0..2]
+  void pixel(int y, int x, float* rgb) const {
+    float buf[Canvas::CH];
+    const float* p = span(y, x, 1, buf);
+    rgb[0] = p[0]; rgb[1] = p[1]; rgb[2] = p[2];
+  }
+
+private:
+  // Decoded values of every code; the halves of [0, 1] span the first 60 KB
+  static const float* f16_table() {
+    static const struct Table {
+      std::vector<float> v;
+      Table() : v(65536) { for (int h = 0; h < 65536; h++) v[h] = half_to_float((uint16_t)h); }
+    } table;
+    return table.v.data();
+  }
+
+  static const float* u8_table() {
+    static const struct Table {
+      float v[256];
+      Table() { for (int k = 0; k < 256; k++) v[k] = (float)(k / 255.0); }
+    } table;
+    return table.v;
+  }
+
+  int prec_;
+  int H_, W_;
+  double err_;
+  Canvas f32_;                   // float32 storage
+  std::vector<uint16_t> f16_;    // float16 storage, row-major RGB
+  std::vector<uint8_t> u8_;      // uint8 storage, row-major RGB
+  LossTarget loss_;
+};
+
+// Sum of f(t, x, n) over pixels x0 .. x0+n-1 of row y, with t the target's
+// RGBA floats from x: one call on float32 storage, one per decoded chunk
+// otherwise
+template <class F>
+inline double target_span_sum(const TargetImage& target, int y, int x0, int n, F f) {
+  if (!target.packed()) return f(target.span(y, x0, n, NULL), x0, n);
+  alignas(16) float buf[Canvas::CH * TARGET_CHUNK];
+  double acc = 0.0;
+  for (int x = x0; x < x0 + n; x += TARGET_CHUNK) {
+    const int m = std::min((int)TARGET_CHUNK, x0 + n - x);
+    acc += f(target.span(y, x, m, buf), x, m);
+  }
+  return acc;
+}
+
+// Loss L of canvas against target over b; multiscale cell terms over the
+// cells of region(b), which canvas must cover
+template <class L>
+inline double loss_bbox(const TargetImage& target, const Canvas& canvas, const BBox& b) {
+  const LossTarget& lt = target.loss();
+  double acc = 0.0;
+  const int n = b.xmax - b.xmin + 1;
+  if (n <= 0) return 0.0;
+  for (int y = b.ymin; y <= b.ymax; y++)
+    acc += target_span_sum(target, y, b.xmin, n, [&](const float* t, int x, int m) {
+      return L::span(lt, y, x, m, t, canvas.px(y, x));
+    });
+  if (L::CELLS) acc += CellDelta::scratch().total(lt, canvas, b);
+  return acc;
+}
+
+// loss(target, after) - loss(target, before) for a change over b; before
+// must cover region(b) for the multiscale cell terms
+template <class L>
+inline double loss_delta_bbox(const TargetImage& target, const Canvas& after,
+                              const Canvas& before, const BBox& b) {
+  const LossTarget& lt = target.loss();
+  CellDelta& cells = CellDelta::scratch();
+  double acc = 0.0;
+  const int n = b.xmax - b.xmin + 1;
+  if (n <= 0) return 0.0;
+  if (L::CELLS) cells.begin(lt, b);
+  for (int y = b.ymin; y <= b.ymax; y++)
+    acc += target_span_sum(target, y, b.xmin, n, [&](const float* t, int x, int m) {
+      if (L::CELLS) cells.add(y, x, m, after.px(y, x), before.px(y, x));
+      return L::delta(lt, y, x, m, t, after.px(y, x), before.px(y, x));
+    });
+  if (L::CELLS) acc += cells.finish(lt, before);
+  return acc;
+}
+
+// SSE (or the target's loss) of canvas against target over b, as sse_bbox()
+// in canvas.h
+inline double sse_bbox(const TargetImage& target, const Canvas& canvas, const BBox& b) {
+  switch (target.loss().kind()) {
+    case LOSS_WEIGHTED:   return loss_bbox<WeightedLoss>(target, canvas, b);
+    case LOSS_LAB:        return loss_bbox<LabLoss>(target, canvas, b);
+    case LOSS_MULTISCALE: return loss_bbox<MultiscaleLoss>(target, canvas, b);
+  }
+  return loss_bbox<SseLoss>(target, canvas, b);
+}
+
+// sse(target, after) - sse(target, before) over b (or the target's loss), as
+// sse_delta_bbox() in canvas.h
+inline double sse_delta_bbox(const TargetImage& target, const Canvas& after,
+                             const Canvas& before, const BBox& b) {
+  switch (target.loss().kind()) {
+    case LOSS_WEIGHTED:   return loss_delta_bbox<WeightedLoss>(target, after, before, b);
+    case LOSS_LAB:        return loss_delta_bbox<LabLoss>(target, after, before, b);
+    case LOSS_MULTISCALE: return loss_delta_bbox<MultiscaleLoss>(target, after, before, b);
+  }
+  return loss_delta_bbox<SseLoss>(target, after, before, b);
+}
+
+// R form: storage, target_bytes, max_error and sse_bound, the most a
+// full-canvas SSE can differ from the one against the exact target
+inline Rcpp::List precision_to_list(const TargetImage& t) {
+  return Rcpp::List::create(
+    Rcpp::Named("storage") = precision_name(t.precision()),
+    Rcpp::Named("target_bytes") = (double)t.bytes(),
+    Rcpp::Named("max_error") = t.max_error(),
+    Rcpp::Named("sse_bound") = 6.0 * t.max_error() * t.H() * t.W()
+  );
+}
+
+#endif
@@ -0,0 +1,213 @@
+// tempering.h
+// Parallel tempering over RJSampler replicas. Chain c runs at
+//   beta_c(t) = beta_at(t) * beta_ratio^c,  c = 0 .. n_chains-1,
+// so chain 0 follows the usual annealing schedule and the others are hotter
+// copies that cross SSE barriers more easily. Every swap_every iterations
+// neighbouring temperatures propose to exchange states, accepted with
+//   log alpha = (beta_c - beta_c+1) * (SSE_c - SSE_c+1)
+// (the priors cancel). Between swaps the chains are independent, each with
+// its own canvas, store and NativeRng stream, and run on std::thread workers.
+// Only the main thread touches R (snapshots, output, interrupts).
+#ifndef MCMCPAINTER_TEMPERING_H
+#define MCMCPAINTER_TEMPERING_H
+
+#include "painter_engine.h"
+#include "parallel.h"
+#include <memory>
+
+template <class P>
+class ParallelTempering {
+public:
+  typedef RJSampler<P, NativeRng> Chain;
+
+  // n_threads <= 0 uses one worker per core, at most one per chain. Chain c
+  // draws from stream c of seed, the swap decisions from stream n_chains.
+  ParallelTempering(const double* target, int H, int W, const SamplerConfig& cfg,
+                    int n_chains, double beta_ratio, int swap_every, int n_threads,
+                    uint64_t seed)
+    : cfg_(cfg), swap_every_(swap_every), pool_(n_threads, n_chains), swap_rng_(seed),
+      trace_(NULL), stats_log_(NULL), run_seconds_(0.0), swaps_proposed_(0), swaps_accepted_(0), rounds_(0) {
+    if (n_chains < 1) Rcpp::stop("n_chains must be >= 1");
+    if (!(beta_ratio > 0.0 && beta_ratio <= 1.0)) Rcpp::stop("beta_ratio must be in (0, 1]");
+    if (swap_every < 1) Rcpp::stop("swap_every must be >= 1");
+
+    SamplerConfig chain_cfg = cfg;
+    chain_cfg.verbose = false;
+    chain_cfg.n_threads = 1;  // the chains already occupy the workers
+    // One read-only target for all replicas
+    std::shared_ptr<const TargetImage> shared =
+      std::make_shared<const TargetImage>(target, H, W, cfg.precision, cfg.loss);
+    for (int c = 0; c < n_chains; c++) {
+      chains_.push_back(std::unique_ptr<Chain>(new Chain(shared, chain_cfg, swap_rng_)));
+      swap_rng_.jump();
+      slot_.push_back(c);
+      ladder_.push_back(std::pow(beta_ratio, c));
+    }
+  }
+
+  // Every chain starts from prims (see RJSampler::init)
+  void init(const std::vector<typename P::Params>& prims) {
+    for (int c = 0; c < n_chains(); c++) chains_[c]->init(prims);
+  }
+
+  // Trace the cold chain (see RJSampler::set_trace). When a swap hands the
+  // cold temperature to another replica, the trace switches to it with a
+  // full state dump, so replaying it follows the chain that is reported.
+  void set_trace(TraceWriter<P>* trace, bool dump = true) {
+    if (trace_ != NULL) chains_[slot_[0]]->set_trace(NULL);
+    trace_ = trace;
+    if (trace_ != NULL) chains_[slot_[0]]->set_trace(trace_, dump);
+  }
+
+  // on_snapshot(const Canvas&, iter, K, beta, sse) sees the coldest chain;
+  // on_checkpoint(iter, beta) every checkpoint_every iterations, with all
+  // chains at iter and that round's swaps done. A restored run continues
+  // after the checkpointed iteration.
+  template <class Snapshot>
+  void run(Snapshot on_snapshot) {
+    run(on_snapshot, [](int, double) {});
+  }
+
+  template <class Snapshot, class Checkpoint>
+  void run(Snapshot on_snapshot, Checkpoint on_checkpoint) {
+    int t = cold().iter();
+    if (cfg_.save_every > 0 && t == 0)
+      on_snapshot(cold().canvas(), 0, cold().K(), cfg_.beta_init, cold().sse());
+    const long long t0 = stat_now_ns();
+    if (cfg_.stats_every > 0) record_stats(t, 0.0);
+
+    while (t < cfg_.iters) {
+      // advance to the next swap, snapshot, checkpoint or final iteration
+      int t_end = std::min(cfg_.iters, (t / swap_every_ + 1) * swap_every_);
+      if (cfg_.save_every > 0) t_end = std::min(t_end, (t / cfg_.save_every + 1) * cfg_.save_every);
+      if (cfg_.checkpoint_every > 0)
+        t_end = std::min(t_end, (t / cfg_.checkpoint_every + 1) * cfg_.checkpoint_every);
+      if (cfg_.stats_every > 0)
+        t_end = std::min(t_end, (t / cfg_.stats_every + 1) * cfg_.stats_every);
+      advance(t + 1, t_end);
+      t = t_end;
+
+      if (t % swap_every_ == 0) swap_round(t);
+
+      if (cfg_.verbose && t % swap_every_ == 0 && (t / swap_every_) % 10 == 0)
+        Rcpp::Rcout << "t:  " << t << "  swaps: " << swaps_accepted_ << "/"
+                    << swaps_proposed_ << " \n";
+      Rcpp::checkUserInterrupt();
+
+      if (cfg_.save_every > 0 && t % cfg_.save_every == 0)
+        on_snapshot(cold().canvas(), t, cold().K(), chains_[0]->beta_at(t), cold().sse());
+      if (cfg_.stats_every > 0 && t % cfg_.stats_every == 0)
+        record_stats(t, 1e-9 * (stat_now_ns() - t0));
+      if (cfg_.checkpoint_every > 0 && t % cfg_.checkpoint_every == 0)
+        on_checkpoint(t, chains_[0]->beta_at(t));
+    }
+    run_seconds_ = 1e-9 * (stat_now_ns() - t0);
+  }
+
+  int n_chains() const { return (int)chains_.size(); }
+
+  // Chain currently at temperature 0 (beta_ratio^0)
+  const Chain& cold() const { return *chains_[slot_[0]]; }
+
+  // Replica holding the lowest SSE seen by any chain
+  const Chain& best() const {
+    int b = 0;
+    for (int c = 1; c < n_chains(); c++)
+      if (chains_[c]->best_sse() < chains_[b]->best_sse()) b = c;
+    return *chains_[b];
+  }
+
+  int swaps_proposed() const { return swaps_proposed_; }
+  int swaps_accepted() const { return swaps_accepted_; }
+
+  // Move counters and timers summed over the replicas; the history (K, SSE)
+  // follows the cold chain
+  SamplerStats counters() const {
+    SamplerStats s;
+    for (int c = 0; c < n_chains(); c++) s.add(chains_[c]->stats());
+    return s;
+  }
+  const SamplerStats& history() const { return hist_; }
+  double run_seconds() const { return run_seconds_; }
+  void set_stats_log(StatsLog* log) { stats_log_ = log; }
+
+  // Save or load every replica plus the ladder assignment and swap stream
+  // (see checkpoint.h)
+  template <class Ar>
+  void checkpoint(Ar& ar) {
+    swap_rng_.checkpoint(ar);
+    ar.vec(slot_);
+    ar.pod(swaps_proposed_);
+    ar.pod(swaps_accepted_);
+    ar.pod(rounds_);
+    for (int c = 0; c < n_chains(); c++) chains_[c]->checkpoint(ar);
+    bool ok = (int)slot_.size() == n_chains();
+    std::vector<int> seen(n_chains(), 0);
+    for (size_t k = 0; ok && k < slot_.size(); k++)
+      ok = slot_[k] >= 0 && slot_[k] < n_chains() && seen[slot_[k]]++ == 0;
+    if (!ok) Rcpp::stop("checkpoint is corrupt (tempering)");
+  }
+
+  void restore() {
+    for (int c = 0; c < n_chains(); c++) chains_[c]->restore();
+  }
+
+private:
+  void record_stats(int t, double seconds) {
+    hist_.record(t, cold().K(), cold().sse(), chains_[0]->beta_at(t), seconds);
+    if (stats_log_ != NULL) stats_log_->write(counters(), hist_);
+  }
+
+  // Iterations t0 .. t1 on every chain, chains split across the workers
+  void advance(int t0, int t1) {
+    std::vector<int> temp(n_chains());
+    for (int k = 0; k < n_chains(); k++) temp[slot_[k]] = k;
+    pool_.run(n_chains(), [&](int c) {
+      advance_chain(c, ladder_[temp[c]], t0, t1);
+    });
+  }
+
+  void advance_chain(int c, double scale, int t0, int t1) {
+    Chain& chain = *chains_[c];
+    for (int t = t0; t <= t1; t++) chain.step(t, chain.beta_at(t) * scale);
+  }
+
+  // Neighbour exchanges, alternating even and odd pairs between rounds
+  void swap_round(int t) {
+    const double beta = chains_[0]->beta_at(t);
+    const int cold0 = slot_[0];
+    for (int k = rounds_ % 2; k + 1 < n_chains(); k += 2) {
+      Chain& a = *chains_[slot_[k]];
+      Chain& b = *chains_[slot_[k + 1]];
+      const double log_acc = beta * (ladder_[k] - ladder_[k + 1]) * (a.sse() - b.sse());
+      swaps_proposed_++;
+      if (std::log(swap_rng_.unif()) < log_acc) {
+        std::swap(slot_[k], slot_[k + 1]);
+        swaps_accepted_++;
+      }
+    }
+    rounds_++;
+    if (trace_ != NULL && slot_[0] != cold0) {
+      chains_[cold0]->set_trace(NULL);
+      chains_[slot_[0]]->set_trace(trace_);
+    }
+  }
+
+  const SamplerConfig cfg_;
+  const int swap_every_;
+  ThreadPool pool_;             // chain workers, parked between rounds
+  NativeRng swap_rng_;
+
+  std::vector<std::unique_ptr<Chain> > chains_;
+  std::vector<int> slot_;       // slot_[k]: chain at temperature k
+  std::vector<double> ladder_;  // beta_ratio^k
+  TraceWriter<P>* trace_;       // follows the cold chain, not owned
+  SamplerStats hist_;           // history only (record_stats)
+  StatsLog* stats_log_;         // not owned
+  double run_seconds_;
+
+  int swaps_proposed_, swaps_accepted_;
+  int rounds_;
+};
+
+#endif
@@ -0,0 +1,325 @@
+// trace.h
+// Append-only binary trace of a run: every accepted change to the primitive
+// store as one fixed-size record, so the state at any iteration can be
+// rebuilt afterwards (replay_trace) and rendered at any resolution.
+//
+// Layout, native byte order (the header's byte-order mark tells):
+//   header, 32 bytes:  "MCPT" | u32 version | u32 kind | i32 H | i32 W |
+//                      u32 nfloats | u32 record_bytes | u32 0x01020304
+//   record, 24 + 4 * nfloats bytes:
+//                      i32 iter | u8 op | 3 pad | i32 slot | 4 pad |
+//                      u64 order | f32 params[nfloats]
+// params are the policy's NFIELDS scalar fields then r, g, b, exactly the
+// float values held by PrimitiveStore. The ops replay against a store:
+//   TRACE_ADD    push(params, order); slot is the slot it lands in
+//   TRACE_REMOVE swap_remove(slot)
+//   TRACE_SET    set(slot, params)
+//   TRACE_ORDER  set_order(slot, order)
+//   TRACE_CLEAR  clear(); a full state dump (TRACE_ADDs in slot order) follows
+//
+// A checkpoint stores the trace's record count (trace_mark); a resumed run
+// cuts the trace back to that count and appends (resume_trace), so the file
+// still records the run from its start, as if it had never stopped.
+#ifndef MCMCPAINTER_TRACE_H
+#define MCMCPAINTER_TRACE_H
+
+#include "primitive_store.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <unistd.h>
+#else
+#include <io.h>
+#endif
+
+enum TraceOp { TRACE_ADD = 0, TRACE_REMOVE = 1, TRACE_SET = 2, TRACE_ORDER = 3, TRACE_CLEAR = 4 };
+enum TraceKind { TRACE_LINES = 1, TRACE_DOTS = 2 };
+
+struct TraceHeader {
+  char magic[4];
+  uint32_t version, kind;
+  int32_t H, W;
+  uint32_t nfloats, record_bytes, bom;
+};
+
+static const uint32_t TRACE_VERSION = 1;
+static const uint32_t TRACE_BOM = 0x01020304;
+
+// Writes are buffered and never touch R, so the chain that owns the writer
+// may record from a worker thread; open / close errors are raised by the
+// caller on the main thread
+template <class P>
+class TraceWriter {
+public:
+  typedef typename P::Params Params;
+  enum { NFLOATS = P::NFIELDS + 3, RECORD_BYTES = 24 + 4 * NFLOATS, BUFFER = 1 << 16 };
+
+  TraceWriter(const std::string& path, uint32_t kind, int H, int W)
+    : path_(path), f_(std::fopen(path.c_str(), "wb")), failed_(f_ == NULL), n_(0) {
+    buf_.reserve(BUFFER);
+    TraceHeader h;
+    std::memcpy(h.magic, "MCPT", 4);
+    h.version = TRACE_VERSION;
+    h.kind = kind;
+    h.H = H;
+    h.W = W;
+    h.nfloats = NFLOATS;
+    h.record_bytes = RECORD_BYTES;
+    h.bom = TRACE_BOM;
+    append(&h, sizeof(h));
+  }
+
+  // Append to the trace at path, which already holds records records
+  // (see resume_trace)
+  TraceWriter(const std::string& path, long long records)
+    : path_(path), f_(std::fopen(path.c_str(), "ab")), failed_(f_ == NULL), n_(records) {
+    buf_.reserve(BUFFER);
+  }
+
+  ~TraceWriter() { close(); }
+
+  void add(int iter, int slot, unsigned long long order, const Params& p) {
+    record(iter, TRACE_ADD, slot, order, &p);
+  }
+  void remove(int iter, int slot) { record(iter, TRACE_REMOVE, slot, 0, NULL); }
+  void set(int iter, int slot, const Params& p) { record(iter, TRACE_SET, slot, 0, &p); }
+  void order(int iter, int slot, unsigned long long o) { record(iter, TRACE_ORDER, slot, o, NULL); }
+
+  // Full state: clear, then every slot in slot order
+  void dump(int iter, const PrimitiveStore<P>& store) {
+    record(iter, TRACE_CLEAR, -1, 0, NULL);
+    for (int i = 0; i < store.size(); i++) add(iter, i, store.order(i), store.get(i));
+  }
+
+  // Everything recorded so far to disk; false if any write failed
+  bool sync() {
+    flush();
+    if (f_ == NULL || std::fflush(f_) != 0) failed_ = true;
+#ifndef _WIN32
+    else if (::fsync(fileno(f_)) != 0) failed_ = true;
+#endif
+    return !failed_;
+  }
+
+  // Flush and close; false if any write failed (or the file never opened)
+  bool close() {
+    if (f_ != NULL) {
+      flush();
+      if (std::fclose(f_) != 0) failed_ = true;
+      f_ = NULL;
+    }
+    return !failed_;
+  }
+
+  bool is_open() const { return f_ != NULL; }
+  const std::string& path() const { return path_; }
+  long long records() const { return n_; }
+
+private:
+  void record(int iter, int op, int slot, unsigned long long order, const Params* p) {
+    unsigned char r[RECORD_BYTES];
+    std::memset(r, 0, sizeof(r));
+    const int32_t it = iter, sl = slot;
+    const uint64_t o = order;
+    std::memcpy(r, &it, 4);
+    r[4] = (unsigned char)op;
+    std::memcpy(r + 8, &sl, 4);
+    std::memcpy(r + 16, &o, 8);
+    if (p != NULL) {
+      double f[NFLOATS];
+      P::get_fields(*p, f);
+      for (int c = 0; c < 3; c++) f[P::NFIELDS + c] = p->col[c];
+      for (int k = 0; k < NFLOATS; k++) {
+        const float v = (float)f[k];
+        std::memcpy(r + 24 + 4 * k, &v, 4);
+      }
+    }
+    append(r, RECORD_BYTES);
+    n_++;
+  }
+
+  void append(const void* data, size_t n) {
+    const unsigned char* d = (const unsigned char*)data;
+    buf_.insert(buf_.end(), d, d + n);
+    if (buf_.size() >= BUFFER) flush();
+  }
+
+  void flush() {
+    if (f_ != NULL && !buf_.empty() &&
+        std::fwrite(&buf_[0], 1, buf_.size(), f_) != buf_.size()) failed_ = true;
+    buf_.clear();
+  }
+
+  std::string path_;
+  FILE* f_;
+  bool failed_;
+  long long n_;
+  std::vector<unsigned char> buf_;
+};
+
+// Header of path; Rcpp::stop if it is not a trace
+inline TraceHeader read_trace_header(FILE* f, const std::string& path) {
+  TraceHeader h;
+  if (std::fread(&h, sizeof(h), 1, f) != 1 || std::memcmp(h.magic, "MCPT", 4) != 0)
+    Rcpp::stop("not a primitive trace: " + path);
+  if (h.bom != TRACE_BOM) Rcpp::stop("trace written with a different byte order: " + path);
+  if (h.version != TRACE_VERSION) Rcpp::stop("unsupported trace version: " + path);
+  return h;
+}
+
+struct TraceInfo {
+  TraceHeader header;
+  long long records;
+  int last_iter;
+};
+
+// Header, record count and last iteration of path, without replaying it
+inline TraceInfo trace_info(const std::string& path) {
+  FILE* f = std::fopen(path.c_str(), "rb");
+  if (f == NULL) Rcpp::stop("cannot open trace: " + path);
+  std::unique_ptr<FILE, int (*)(FILE*)> guard(f, std::fclose);
+  TraceInfo info;
+  info.header = read_trace_header(f, path);
+  info.last_iter = 0;
+  std::fseek(f, 0, SEEK_END);
+  const long long bytes = (long long)std::ftell(f) - (long long)sizeof(TraceHeader);
+  info.records = bytes / info.header.record_bytes;  // a torn last record is ignored
+  if (info.records > 0) {
+    int32_t iter;
+    std::fseek(f, (long)(sizeof(TraceHeader) + (info.records - 1) * info.header.record_bytes), SEEK_SET);
+    if (std::fread(&iter, 4, 1, f) == 1) info.last_iter = iter;
+  }
+  return info;
+}
+
+// Open path for the driver, or Rcpp::stop; main thread only
+template <class P>
+inline TraceWriter<P>* open_trace(const std::string& path, uint32_t kind, int H, int W) {
+  std::unique_ptr<TraceWriter<P> > w(new TraceWriter<P>(path, kind, H, W));
+  if (!w->is_open()) Rcpp::stop("cannot open trace file: " + path);
+  return w.release();
+}
+
+// Sync w (if any) for a checkpoint taken now and return the record count
+// the checkpoint stores: 0 without a trace or after a failed write, so such
+// a checkpoint resumes with a fresh trace (see resume_trace)
+template <class P>
+inline uint64_t trace_mark(TraceWriter<P>* w) {
+  return w != NULL && w->sync() ? (uint64_t)w->records() : 0;
+}
+
+// Open path for a run resumed from a checkpoint that stored records
+// (trace_mark). With records > 0 the trace is cut back to that many records
+// and continued, so it covers the whole run; Rcpp::stop if it holds another
+// run's primitives or fewer records. With records == 0 the checkpointed run
+// kept no complete trace and a fresh one is started, but an existing
+// non-empty file is refused rather than overwritten. Main thread only.
+template <class P>
+inline TraceWriter<P>* resume_trace(const std::string& path, uint32_t kind, int H, int W,
+                                    uint64_t records) {
+  if (records == 0) {
+    FILE* f = std::fopen(path.c_str(), "rb");
+    if (f != NULL) {
+      const bool empty = std::fgetc(f) == EOF;
+      std::fclose(f);
+      if (!empty)
+        Rcpp::stop("the checkpoint kept no trace of this run; use a new trace_file instead of " + path);
+    }
+    return open_trace<P>(path, kind, H, W);
+  }
+  const TraceInfo info = trace_info(path);
+  const TraceHeader& h = info.header;
+  if (h.kind != kind || h.nfloats != (uint32_t)TraceWriter<P>::NFLOATS ||
+      h.record_bytes != (uint32_t)TraceWriter<P>::RECORD_BYTES)
+    Rcpp::stop("trace holds a different primitive type: " + path);
+  if (h.H != H || h.W != W) Rcpp::stop("trace was written at a different image size: " + path);
+  if ((uint64_t)info.records < records)
+    Rcpp::stop("trace is shorter than the checkpoint it resumes from: " + path);
+  const long long bytes = (long long)sizeof(TraceHeader) + (long long)records * h.record_bytes;
+#ifndef _WIN32
+  const bool cut = ::truncate(path.c_str(), (off_t)bytes) == 0;
+#else
+  bool cut = false;
+  FILE* f = std::fopen(path.c_str(), "r+b");
+  if (f != NULL) {
+    cut = _chsize_s(_fileno(f), bytes) == 0;
+    std::fclose(f);
+  }
+#endif
+  if (!cut) Rcpp::stop("cannot cut trace back to the checkpoint: " + path);
+  std::unique_ptr<TraceWriter<P> > w(new TraceWriter<P>(path, (long long)records));
+  if (!w->is_open()) Rcpp::stop("cannot open trace file: " + path);
+  return w.release();
+}
+
+// Flush and close w (if any), warning when writes were lost; main thread only
+template <class P>
+inline void finish_trace(TraceWriter<P>* w) {
+  if (w != NULL && !w->close()) Rcpp::warning("trace file incomplete: %s", w->path().c_str());
+}
+
+// Stream the records of path into a store. For each of iters (ascending),
+// on_frame(const PrimitiveStore<P>&, iter) sees the state after every record
+// of iterations <= iter. Returns the last iteration in the trace.
+template <class P, class Frame>
+inline int replay_trace(const std::string& path, uint32_t kind,
+                        const std::vector<int>& iters, Frame on_frame) {
+  typedef typename P::Params Params;
+  enum { NFLOATS = TraceWriter<P>::NFLOATS, RECORD_BYTES = TraceWriter<P>::RECORD_BYTES };
+
+  FILE* f = std::fopen(path.c_str(), "rb");
+  if (f == NULL) Rcpp::stop("cannot open trace: " + path);
+  std::unique_ptr<FILE, int (*)(FILE*)> guard(f, std::fclose);
+  const TraceHeader h = read_trace_header(f, path);
+  if (h.kind != kind || h.nfloats != (uint32_t)NFLOATS || h.record_bytes != (uint32_t)RECORD_BYTES)
+    Rcpp::stop("trace holds a different primitive type: " + path);
+
+  PrimitiveStore<P> store;
+  size_t next = 0;
+  int last = 0;
+  unsigned char r[RECORD_BYTES];
+  while (std::fread(r, RECORD_BYTES, 1, f) == 1) {
+    int32_t iter, slot;
+    uint64_t order;
+    std::memcpy(&iter, r, 4);
+    std::memcpy(&slot, r + 8, 4);
+    std::memcpy(&order, r + 16, 8);
+    for (; next < iters.size() && iters[next] < iter; next++) on_frame(store, iters[next]);
+    last = iter;
+
+    const int op = r[4];
+    if (op == TRACE_CLEAR) {
+      store.clear();
+      continue;
+    }
+    if (op != TRACE_ADD && (slot < 0 || slot >= store.size()))
+      Rcpp::stop("corrupt trace (slot out of range): " + path);
+    Params p;
+    if (op == TRACE_ADD || op == TRACE_SET) {
+      double v[NFLOATS];
+      for (int k = 0; k < NFLOATS; k++) {
+        float x;
+        std::memcpy(&x, r + 24 + 4 * k, 4);
+        v[k] = x;
+      }
+      P::set_fields(p, v);
+      for (int c = 0; c < 3; c++) p.col[c] = v[P::NFIELDS + c];
+    }
+    switch (op) {
+      case TRACE_ADD:    store.push(p, order); break;
+      case TRACE_REMOVE: store.swap_remove(slot); break;
+      case TRACE_SET:    store.set(slot, p); break;
+      case TRACE_ORDER:  store.set_order(slot, order); break;
+      default: Rcpp::stop("corrupt trace (unknown record): " + path);
+    }
+  }
+  for (; next < iters.size(); next++) on_frame(store, iters[next]);
+  return last;
+}
+
+#endif